@@ -0,0 +1,129 @@
+#ifndef _FususBufferPool_
+#define _FususBufferPool_
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace FususMatrix{
+
+	template<typename T>
+	class BufferPool;
+
+	// Scratch memory borrowed from a BufferPool, given back when destroyed.
+	// The elements are left uninitialized.
+	template<typename T>
+	class ScratchBuffer{
+	private:
+		BufferPool<T>* Pool;
+		std::unique_ptr<T[]> Data;
+		std::size_t Capacity;
+	public:
+		// An empty buffer, belonging to no pool.
+		ScratchBuffer()
+			: Pool(nullptr), Data(), Capacity(0){
+		};
+
+		ScratchBuffer(BufferPool<T>& pool, std::unique_ptr<T[]> data, std::size_t capacity)
+			: Pool(&pool), Data(std::move(data)), Capacity(capacity){
+		};
+
+		ScratchBuffer(ScratchBuffer&& other)
+			: Pool(other.Pool), Data(std::move(other.Data)), Capacity(other.Capacity){
+			other.Capacity = 0;
+		};
+
+		ScratchBuffer(const ScratchBuffer&) = delete;
+		ScratchBuffer& operator=(const ScratchBuffer&) = delete;
+
+		~ScratchBuffer(){
+			if (Data){
+				Pool->Release(std::move(Data), Capacity);
+			};
+		};
+
+		T* data() const {
+			return Data.get();
+		};
+
+		std::size_t size() const {
+			return Capacity;
+		};
+	};
+
+	//
+	//                      The BufferPool Class.
+	// Keeps the scratch buffers of recursive algorithms (e.g. the temporaries of Strassen's multiplication)
+	// once they are released, so that repeated operations of similar sizes stop allocating.
+	// A request is served by the smallest kept buffer that is large enough. Thread safe.
+	template<typename T>
+	class BufferPool{
+	private:
+		struct Buffer{
+			std::unique_ptr<T[]> Data;
+			std::size_t Capacity;
+		};
+
+		std::mutex Mutex;
+		std::vector<Buffer> Free;
+		std::size_t AllocationCount;
+
+		friend class ScratchBuffer<T>;
+
+		void Release(std::unique_ptr<T[]> data, std::size_t capacity){
+			std::lock_guard<std::mutex> lock(Mutex);
+			Free.push_back(Buffer{ std::move(data), capacity });
+		};
+	public:
+		BufferPool()
+			: AllocationCount(0){
+		};
+
+		BufferPool(const BufferPool&) = delete;
+		BufferPool& operator=(const BufferPool&) = delete;
+
+		// A buffer of at least n elements.
+		ScratchBuffer<T> Acquire(std::size_t n){
+			{
+				std::lock_guard<std::mutex> lock(Mutex);
+				std::size_t best{ Free.size() };
+				for (std::size_t i = 0; i < Free.size(); ++i){
+					if (Free[i].Capacity >= n && (best == Free.size() || Free[i].Capacity < Free[best].Capacity)){
+						best = i;
+					};
+				};
+				if (best != Free.size()){
+					Buffer buffer{ std::move(Free[best].Data), Free[best].Capacity };
+					Free[best] = std::move(Free.back());
+					Free.pop_back();
+					return ScratchBuffer<T>(*this, std::move(buffer.Data), buffer.Capacity);
+				};
+				++AllocationCount;
+			};
+			return ScratchBuffer<T>(*this, std::unique_ptr<T[]>(new T[n > 0 ? n : 1]), n);
+		};
+
+		// Frees the buffers currently kept.
+		void clear(){
+			std::lock_guard<std::mutex> lock(Mutex);
+			Free.clear();
+		};
+
+		// Number of buffers allocated since the pool was created.
+		std::size_t Allocations(){
+			std::lock_guard<std::mutex> lock(Mutex);
+			return AllocationCount;
+		};
+
+		// The pool shared by the whole library, one per element type.
+		static BufferPool& Global(){
+			static BufferPool pool;
+			return pool;
+		};
+	};// END BufferPool class
+	//
+}// END namespace FususMatrix
+
+#endif
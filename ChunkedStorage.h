@@ -0,0 +1,653 @@
+#ifndef _FususChunkedStorage_
+#define _FususChunkedStorage_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+
+namespace FususMatrix{
+
+	// Chunked, compressed storage of N-D Matrices on disk.
+	// The elements are cut in tiles of fixed sizes, each compressed on its own, and the file keeps an index of
+	// the tiles, so a sub-block is read by decompressing only the tiles it touches. Tiles are compressed and
+	// decompressed in parallel, in batches that bound the memory used.
+	// The codec has no dependencies: each element is predicted from the previous ones along the tile (delta
+	// coding), the bytes of the residuals are shuffled so that the k-th bytes of all the elements are together,
+	// and the result is compressed with an LZ77 coder in the format of LZ4 blocks. On smooth fields the
+	// residuals are small, so their high bytes form long runs of zeros.
+	// File layout, integers little-endian, elements as in memory:
+	//   "FUSUSCHK", version, element size, dimension, codec (4 bytes each), index offset (8 bytes),
+	//   sizes and tile sizes (8 bytes each per dimension), the tiles in the row-major order of the grid of tiles,
+	//   and the index: offset and length of each tile (8 bytes each).
+	// Each tile starts with a byte telling whether it is coded (1) or raw (0), when coding doesn't make it smaller.
+
+	// DeltaShuffle: residuals of a linear prediction from the two previous elements (for integer and floating
+	// point elements of 1, 2, 4 or 8 bytes; other sizes are xor-ed with the previous element), shuffled, LZ.
+	// Shuffle: shuffled and LZ, for data that isn't smooth. None: the tiles raw.
+	enum class Codec : std::uint32_t { None, Shuffle, DeltaShuffle };
+
+	const char ChunkedMagic[8]{ 'F', 'U', 'S', 'U', 'S', 'C', 'H', 'K' };
+	const std::uint32_t ChunkedVersion{ 1 };
+	// Raw bytes of the tiles (de)compressed per batch.
+	const std::size_t ChunkedBatchBytes{ std::size_t{ 1 } << 26 };
+	// Positions kept by the match finder of the LZ coder (a power of two).
+	const std::size_t LZHashBits{ 14 };
+
+	// Little-endian integers.
+	inline void PutUnsigned(std::ostream& os, std::uint64_t value, std::size_t bytes){
+		for (std::size_t b = 0; b < bytes; ++b){
+			os.put(static_cast<char>((value >> (8 * b)) & 0xFF));
+		};
+	};
+	inline std::uint64_t GetUnsigned(std::istream& is, std::size_t bytes){
+		std::uint64_t value{ 0 };
+		for (std::size_t b = 0; b < bytes; ++b){
+			int const c{ is.get() };
+			if (c == std::char_traits<char>::eof()){
+				throw std::runtime_error("Chunked file: unexpected end of file.");
+			};
+			value |= static_cast<std::uint64_t>(c) << (8 * b);
+		};
+		return value;
+	};
+
+	// Residuals of the prediction 2 x[i-1] - x[i-2] (x[i-1] for the first element), in place, on the elements
+	// seen as unsigned integers. Zigzag coded, so that small negative residuals also have zero high bytes.
+	template<typename U>
+	void PredictForward(unsigned char* bytes, std::size_t count){
+		U previous{ 0 };
+		U before{ 0 };
+		for (std::size_t i = 0; i < count; ++i){
+			U x;
+			std::memcpy(&x, bytes + i * sizeof(U), sizeof(U));
+			U const d{ static_cast<U>(x - (i > 1 ? static_cast<U>(2 * previous - before) : previous)) };
+			U const z{ static_cast<U>((d << 1) ^ (0 - (d >> (8 * sizeof(U) - 1)))) };
+			std::memcpy(bytes + i * sizeof(U), &z, sizeof(U));
+			before = previous;
+			previous = x;
+		};
+	};
+	template<typename U>
+	void PredictBackward(unsigned char* bytes, std::size_t count){
+		U previous{ 0 };
+		U before{ 0 };
+		for (std::size_t i = 0; i < count; ++i){
+			U z;
+			std::memcpy(&z, bytes + i * sizeof(U), sizeof(U));
+			U const d{ static_cast<U>((z >> 1) ^ (0 - (z & 1))) };
+			U const x{ static_cast<U>(d + (i > 1 ? static_cast<U>(2 * previous - before) : previous)) };
+			std::memcpy(bytes + i * sizeof(U), &x, sizeof(U));
+			before = previous;
+			previous = x;
+		};
+	};
+	inline void DeltaEncode(unsigned char* bytes, std::size_t count, std::size_t size){
+		switch (size){
+		case 1: PredictForward<std::uint8_t>(bytes, count); break;
+		case 2: PredictForward<std::uint16_t>(bytes, count); break;
+		case 4: PredictForward<std::uint32_t>(bytes, count); break;
+		case 8: PredictForward<std::uint64_t>(bytes, count); break;
+		default:
+			for (std::size_t i = count * size; i > size; --i){
+				bytes[i - 1] ^= bytes[i - 1 - size];
+			};
+		};
+	};
+	inline void DeltaDecode(unsigned char* bytes, std::size_t count, std::size_t size){
+		switch (size){
+		case 1: PredictBackward<std::uint8_t>(bytes, count); break;
+		case 2: PredictBackward<std::uint16_t>(bytes, count); break;
+		case 4: PredictBackward<std::uint32_t>(bytes, count); break;
+		case 8: PredictBackward<std::uint64_t>(bytes, count); break;
+		default:
+			for (std::size_t i = size; i < count * size; ++i){
+				bytes[i] ^= bytes[i - size];
+			};
+		};
+	};
+
+	// Byte b of element i goes to position b * count + i, and back.
+	inline void ShuffleBytes(unsigned char const* from, unsigned char* to, std::size_t count, std::size_t size){
+		for (std::size_t i = 0; i < count; ++i){
+			for (std::size_t b = 0; b < size; ++b){
+				to[b * count + i] = from[i * size + b];
+			};
+		};
+	};
+	inline void UnshuffleBytes(unsigned char const* from, unsigned char* to, std::size_t count, std::size_t size){
+		for (std::size_t b = 0; b < size; ++b){
+			for (std::size_t i = 0; i < count; ++i){
+				to[i * size + b] = from[b * count + i];
+			};
+		};
+	};
+
+	// LZ77 in the format of LZ4 blocks: sequences of a token (4 bits of literal length, 4 bits of match
+	// length - 4, longer lengths continued in bytes of 255), the literals, and the offset of the match (2 bytes);
+	// the last sequence has only literals. Matches are found through a hash of 4 bytes, and the coder skips
+	// faster through data without matches.
+	inline void PutLength(std::vector<unsigned char>& out, std::size_t length){
+		for (; length >= 255; length -= 255){
+			out.push_back(255);
+		};
+		out.push_back(static_cast<unsigned char>(length));
+	};
+	inline void CompressLZ(unsigned char const* in, std::size_t n, std::vector<unsigned char>& out){
+		std::vector<std::uint32_t> table(std::size_t{ 1 } << LZHashBits, 0);
+		auto load = [in](std::size_t i){
+			std::uint32_t v;
+			std::memcpy(&v, in + i, 4);
+			return v;
+		};
+		auto sequence = [&out, in](std::size_t anchor, std::size_t literals, std::size_t offset, std::size_t match){
+			std::size_t const m{ match >= 4 ? match - 4 : 0 };
+			out.push_back(static_cast<unsigned char>((std::min<std::size_t>(literals, 15) << 4) | std::min<std::size_t>(m, 15)));
+			if (literals >= 15){
+				PutLength(out, literals - 15);
+			};
+			out.insert(out.end(), in + anchor, in + anchor + literals);
+			if (match == 0){
+				return;
+			};
+			out.push_back(static_cast<unsigned char>(offset & 0xFF));
+			out.push_back(static_cast<unsigned char>(offset >> 8));
+			if (m >= 15){
+				PutLength(out, m - 15);
+			};
+		};
+		std::size_t anchor{ 0 };
+		std::size_t i{ 0 };
+		std::size_t misses{ 0 };
+		while (i + 4 <= n){
+			std::uint32_t const v{ load(i) };
+			std::size_t const h{ (v * 2654435761u) >> (32 - LZHashBits) };
+			std::size_t const candidate{ table[h] };
+			table[h] = static_cast<std::uint32_t>(i);
+			if (candidate < i && i - candidate <= 65535 && load(candidate) == v){
+				std::size_t length{ 4 };
+				while (i + length < n && in[candidate + length] == in[i + length]){
+					++length;
+				};
+				sequence(anchor, i - anchor, i - candidate, length);
+				i += length;
+				anchor = i;
+				misses = 0;
+			}
+			else{
+				i += 1 + (misses++ >> 6);
+			};
+		};
+		sequence(anchor, n - anchor, 0, 0);
+	};
+	// Decompresses exactly n bytes, throwing if the data is not a valid block for them.
+	inline void DecompressLZ(unsigned char const* in, std::size_t size, unsigned char* out, std::size_t n){
+		std::size_t p{ 0 };
+		std::size_t o{ 0 };
+		auto length = [in, size, &p](std::size_t value){
+			if (value == 15){
+				unsigned char c;
+				do{
+					if (p >= size){
+						throw std::runtime_error("Chunked file: corrupt tile.");
+					};
+					c = in[p++];
+					value += c;
+				} while (c == 255);
+			};
+			return value;
+		};
+		while (p < size){
+			unsigned char const token{ in[p++] };
+			std::size_t const literals{ length(token >> 4) };
+			if (literals > size - p || literals > n - o){
+				throw std::runtime_error("Chunked file: corrupt tile.");
+			};
+			std::memcpy(out + o, in + p, literals);
+			p += literals;
+			o += literals;
+			if (p == size){
+				break;
+			};
+			if (p + 2 > size){
+				throw std::runtime_error("Chunked file: corrupt tile.");
+			};
+			std::size_t const offset{ static_cast<std::size_t>(in[p]) | (static_cast<std::size_t>(in[p + 1]) << 8) };
+			p += 2;
+			std::size_t const match{ length(token & 15) + 4 };
+			if (offset == 0 || offset > o || match > n - o){
+				throw std::runtime_error("Chunked file: corrupt tile.");
+			};
+			// A match may overlap what it writes: runs of one byte are filled, other overlaps copied byte by byte.
+			if (offset >= match){
+				std::memcpy(out + o, out + o - offset, match);
+			}
+			else if (offset == 1){
+				std::memset(out + o, out[o - 1], match);
+			}
+			else{
+				for (std::size_t k = 0; k < match; ++k){
+					out[o + k] = out[o + k - offset];
+				};
+			};
+			o += match;
+		};
+		if (o != n){
+			throw std::runtime_error("Chunked file: corrupt tile.");
+		};
+	};
+
+	// A tile of count elements of the given size as stored (raw bytes in, method byte and data out), and back.
+	// scratch is working memory, reused between the tiles of a task.
+	inline void EncodeTile(unsigned char* raw, std::size_t count, std::size_t size, Codec codec,
+		std::vector<unsigned char>& scratch, std::vector<unsigned char>& out){
+		std::size_t const bytes{ count * size };
+		out.clear();
+		if (codec != Codec::None){
+			if (codec == Codec::DeltaShuffle){
+				DeltaEncode(raw, count, size);
+			};
+			scratch.resize(bytes);
+			ShuffleBytes(raw, scratch.data(), count, size);
+			out.push_back(1);
+			CompressLZ(scratch.data(), bytes, out);
+			if (out.size() < 1 + bytes){
+				return;
+			};
+			out.clear();
+			if (codec == Codec::DeltaShuffle){
+				DeltaDecode(raw, count, size);
+			};
+		};
+		out.push_back(0);
+		out.insert(out.end(), raw, raw + bytes);
+	};
+	inline void DecodeTile(unsigned char const* stored, std::size_t length, std::size_t count, std::size_t size, Codec codec,
+		std::vector<unsigned char>& scratch, unsigned char* raw){
+		std::size_t const bytes{ count * size };
+		if (length == 0 || stored[0] > 1 || (stored[0] == 1 && codec == Codec::None)){
+			throw std::runtime_error("Chunked file: corrupt tile.");
+		};
+		if (stored[0] == 0){
+			if (length != 1 + bytes){
+				throw std::runtime_error("Chunked file: corrupt tile.");
+			};
+			std::memcpy(raw, stored + 1, bytes);
+			return;
+		};
+		scratch.resize(bytes);
+		DecompressLZ(stored + 1, length - 1, scratch.data(), bytes);
+		UnshuffleBytes(scratch.data(), raw, count, size);
+		if (codec == Codec::DeltaShuffle){
+			DeltaDecode(raw, count, size);
+		};
+	};
+
+	// Copies a box of the given extent between two arrays of elements with the given strides.
+	template<typename T>
+	void CopyBox(T const* from, std::vector<std::size_t> const& fromStrides, T* to, std::vector<std::size_t> const& toStrides,
+		std::vector<std::size_t> const& extent){
+		std::size_t const d{ extent.size() };
+		for (auto e : extent){
+			if (e == 0){
+				return;
+			};
+		};
+		std::vector<std::size_t> c(d, 0);
+		std::size_t const inner{ d - 1 };
+		while (true){
+			std::size_t a{ 0 };
+			std::size_t b{ 0 };
+			for (std::size_t k = 0; k < inner; ++k){
+				a += c[k] * fromStrides[k];
+				b += c[k] * toStrides[k];
+			};
+			for (std::size_t i = 0; i < extent[inner]; ++i){
+				to[b + i * toStrides[inner]] = from[a + i * fromStrides[inner]];
+			};
+			std::size_t k{ inner };
+			while (k > 0){
+				--k;
+				if (++c[k] < extent[k]){
+					break;
+				};
+				c[k] = 0;
+			};
+			if (k == 0 && c[0] == 0){
+				return;
+			};
+		};
+	};
+
+	// Row-major strides of an array with the given sizes.
+	inline std::vector<std::size_t> RowMajorStrides(std::vector<std::size_t> const& sizes){
+		std::vector<std::size_t> strides(sizes.size(), 1);
+		for (std::size_t k = sizes.size(); k > 1; --k){
+			strides[k - 2] = strides[k - 1] * sizes[k - 1];
+		};
+		return strides;
+	};
+
+	// The grid of tiles of an array: tile t has origin and extent along each axis (those on the edges are cut).
+	struct TileGrid{
+		std::vector<std::size_t> Sizes;
+		std::vector<std::size_t> TileSizes;
+		std::vector<std::size_t> Tiles; // Per axis.
+
+		TileGrid(std::vector<std::size_t> const& sizes, std::vector<std::size_t> const& tileSizes)
+			: Sizes(sizes), TileSizes(tileSizes), Tiles(sizes.size()){
+			assert(sizes.size() == tileSizes.size());
+			for (std::size_t k = 0; k < sizes.size(); ++k){
+				assert(tileSizes[k] > 0);
+				Tiles[k] = (sizes[k] + tileSizes[k] - 1) / tileSizes[k];
+			};
+		};
+
+		std::size_t count() const {
+			std::size_t n{ 1 };
+			for (auto t : Tiles){
+				n *= t;
+			};
+			return n;
+		};
+		std::size_t elementsPerTile() const {
+			std::size_t n{ 1 };
+			for (auto t : TileSizes){
+				n *= t;
+			};
+			return n;
+		};
+
+		// Origin and extent of tile t, tiles numbered in row-major order.
+		void box(std::size_t t, std::vector<std::size_t>& origin, std::vector<std::size_t>& extent) const {
+			origin.resize(Sizes.size());
+			extent.resize(Sizes.size());
+			for (std::size_t k = Sizes.size(); k > 0; --k){
+				origin[k - 1] = t % Tiles[k - 1] * TileSizes[k - 1];
+				extent[k - 1] = std::min(TileSizes[k - 1], Sizes[k - 1] - origin[k - 1]);
+				t /= Tiles[k - 1];
+			};
+		};
+	};
+
+	// Runs body(first, last) over the tiles [0, count) in parallel, one tile at a time per task.
+	template<typename Body>
+	void ForTiles(std::size_t count, Body const& body){
+		ThreadPool& pool{ ThreadPool::Global() };
+		if (count > 1 && pool.size() > 1){
+			pool.ParallelFor(0, count, 1, body);
+		}
+		else{
+			body(0, count);
+		};
+	};
+
+	// Writes a Matrix to a chunked file, in tiles of the given sizes (e.g. 64 x 64 x 64 for a 3-D field;
+	// a tile should hold some hundreds of KB, so that it compresses well and reads are not dominated by seeks).
+	// Throws std::runtime_error if the file can't be written.
+	template<typename T, std::size_t Dimension>
+	void WriteChunked(std::string const& path, Matrix<T, Dimension> const& a, std::vector<std::size_t> const& tileSizes,
+		Codec codec = Codec::DeltaShuffle){
+		static_assert(std::is_trivially_copyable<T>::value && !std::is_same<T, bool>::value, "Chunked files store elements as raw bytes.");
+		static_assert(Dimension > 0, "Chunked files store arrays.");
+		TileGrid const grid(a.getSizesAlongEachDimension(), tileSizes);
+		std::vector<std::size_t> const& strides{ a.rep().getStrides() };
+		T const* data{ a.rep().data() };
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file){
+			throw std::runtime_error("Chunked file: can't open " + path + " for writing.");
+		};
+		file.write(ChunkedMagic, sizeof(ChunkedMagic));
+		PutUnsigned(file, ChunkedVersion, 4);
+		PutUnsigned(file, sizeof(T), 4);
+		PutUnsigned(file, Dimension, 4);
+		PutUnsigned(file, static_cast<std::uint32_t>(codec), 4);
+		std::streamoff const indexField{ file.tellp() };
+		PutUnsigned(file, 0, 8);
+		for (auto s : grid.Sizes){
+			PutUnsigned(file, s, 8);
+		};
+		for (auto s : grid.TileSizes){
+			PutUnsigned(file, s, 8);
+		};
+		std::size_t const tiles{ grid.count() };
+		std::size_t const batch{ std::max<std::size_t>(1, ChunkedBatchBytes / (grid.elementsPerTile() * sizeof(T))) };
+		std::vector<std::uint64_t> offsets(tiles);
+		std::vector<std::uint64_t> lengths(tiles);
+		std::uint64_t offset{ static_cast<std::uint64_t>(file.tellp()) };
+		std::vector<std::vector<unsigned char> > stored(std::min(batch, tiles));
+		for (std::size_t t0 = 0; t0 < tiles; t0 += batch){
+			std::size_t const t1{ std::min(tiles, t0 + batch) };
+			ForTiles(t1 - t0, [&](std::size_t first, std::size_t last){
+				std::vector<T> tile;
+				std::vector<unsigned char> scratch;
+				std::vector<std::size_t> origin;
+				std::vector<std::size_t> extent;
+				for (std::size_t t = t0 + first; t < t0 + last; ++t){
+					grid.box(t, origin, extent);
+					std::size_t count{ 1 };
+					std::size_t position{ 0 };
+					for (std::size_t k = 0; k < Dimension; ++k){
+						count *= extent[k];
+						position += origin[k] * strides[k];
+					};
+					tile.resize(count);
+					CopyBox(data + position, strides, tile.data(), RowMajorStrides(extent), extent);
+					EncodeTile(reinterpret_cast<unsigned char*>(tile.data()), count, sizeof(T), codec, scratch, stored[t - t0]);
+				};
+			});
+			for (std::size_t t = t0; t < t1; ++t){
+				std::vector<unsigned char> const& s{ stored[t - t0] };
+				file.write(reinterpret_cast<char const*>(s.data()), static_cast<std::streamsize>(s.size()));
+				offsets[t] = offset;
+				lengths[t] = s.size();
+				offset += s.size();
+			};
+		};
+		for (std::size_t t = 0; t < tiles; ++t){
+			PutUnsigned(file, offsets[t], 8);
+			PutUnsigned(file, lengths[t], 8);
+		};
+		file.seekp(indexField);
+		PutUnsigned(file, offset, 8);
+		file.flush();
+		if (!file){
+			throw std::runtime_error("Chunked file: error writing " + path + ".");
+		};
+	};
+
+	//
+	//                      The ChunkedReader Class.
+	// Reads whole Matrices or sub-blocks from a chunked file. The header and index are read once, by the
+	// constructor; each read opens the file again, so reads from different threads don't interfere.
+	template<typename T = double, std::size_t Dimension = 2>
+	class ChunkedReader{
+	private:
+		std::string Path;
+		Codec MyCodec;
+		TileGrid Grid;
+		std::vector<std::uint64_t> Offsets;
+		std::vector<std::uint64_t> Lengths;
+
+		static TileGrid ReadHeader(std::string const& path, Codec& codec, std::uint64_t& index){
+			std::ifstream file(path, std::ios::binary);
+			if (!file){
+				throw std::runtime_error("Chunked file: can't open " + path + ".");
+			};
+			char magic[sizeof(ChunkedMagic)];
+			file.read(magic, sizeof(magic));
+			if (!file || !std::equal(magic, magic + sizeof(magic), ChunkedMagic)){
+				throw std::runtime_error("Chunked file: " + path + " is not a chunked file.");
+			};
+			if (GetUnsigned(file, 4) != ChunkedVersion){
+				throw std::runtime_error("Chunked file: unknown version.");
+			};
+			if (GetUnsigned(file, 4) != sizeof(T) || GetUnsigned(file, 4) != Dimension){
+				throw std::runtime_error("Chunked file: the elements or the dimension are not those of the Matrix.");
+			};
+			std::uint64_t const c{ GetUnsigned(file, 4) };
+			if (c > static_cast<std::uint32_t>(Codec::DeltaShuffle)){
+				throw std::runtime_error("Chunked file: unknown codec.");
+			};
+			codec = static_cast<Codec>(c);
+			index = GetUnsigned(file, 8);
+			std::vector<std::size_t> sizes(Dimension);
+			std::vector<std::size_t> tileSizes(Dimension);
+			for (auto& s : sizes){
+				s = GetUnsigned(file, 8);
+			};
+			for (auto& s : tileSizes){
+				s = GetUnsigned(file, 8);
+				if (s == 0){
+					throw std::runtime_error("Chunked file: corrupt header.");
+				};
+			};
+			return TileGrid(sizes, tileSizes);
+		};
+	public:
+		// Reads the header and the index. Throws std::runtime_error if the file can't be read or isn't a chunked
+		// file of elements of the size of T and of this dimension.
+		explicit ChunkedReader(std::string const& path)
+			: Path(path), MyCodec(Codec::None), Grid(std::vector<std::size_t>(Dimension, 0), std::vector<std::size_t>(Dimension, 1)){
+			static_assert(std::is_trivially_copyable<T>::value && !std::is_same<T, bool>::value, "Chunked files store elements as raw bytes.");
+			std::uint64_t index{ 0 };
+			Grid = ReadHeader(path, MyCodec, index);
+			std::ifstream file(path, std::ios::binary);
+			file.seekg(static_cast<std::streamoff>(index));
+			std::size_t const tiles{ Grid.count() };
+			Offsets.resize(tiles);
+			Lengths.resize(tiles);
+			for (std::size_t t = 0; t < tiles; ++t){
+				Offsets[t] = GetUnsigned(file, 8);
+				Lengths[t] = GetUnsigned(file, 8);
+			};
+		};
+
+		std::vector<std::size_t> const& sizes() const {
+			return Grid.Sizes;
+		};
+		std::vector<std::size_t> const& tileSizes() const {
+			return Grid.TileSizes;
+		};
+		Codec codec() const {
+			return MyCodec;
+		};
+		// Bytes of the stored tiles.
+		std::uint64_t storedBytes() const {
+			std::uint64_t n{ 0 };
+			for (auto l : Lengths){
+				n += l;
+			};
+			return n;
+		};
+
+		// The whole Matrix.
+		Matrix<T, Dimension> read() const {
+			return read(std::vector<std::size_t>(Dimension, 0), Grid.Sizes);
+		};
+
+		// The block of the given sizes starting at first. Only the tiles it touches are read and decompressed,
+		// in batches, in parallel.
+		Matrix<T, Dimension> read(std::vector<std::size_t> const& first, std::vector<std::size_t> const& sizes) const {
+			assert(first.size() == Dimension && sizes.size() == Dimension);
+			Matrix<T, Dimension> result;
+			result.rep().resize(sizes);
+			std::vector<std::size_t> const resultStrides{ RowMajorStrides(sizes) };
+			T* out{ result.rep().data() };
+			// The touched tiles, in the order of the file.
+			std::vector<std::size_t> low(Dimension);
+			std::vector<std::size_t> high(Dimension);
+			for (std::size_t k = 0; k < Dimension; ++k){
+				assert(first[k] + sizes[k] <= Grid.Sizes[k]);
+				if (sizes[k] == 0){
+					return result;
+				};
+				low[k] = first[k] / Grid.TileSizes[k];
+				high[k] = (first[k] + sizes[k] - 1) / Grid.TileSizes[k] + 1;
+			};
+			std::vector<std::size_t> touched;
+			std::vector<std::size_t> c(low);
+			while (true){
+				std::size_t t{ 0 };
+				for (std::size_t k = 0; k < Dimension; ++k){
+					t = t * Grid.Tiles[k] + c[k];
+				};
+				touched.push_back(t);
+				std::size_t k{ Dimension };
+				while (k > 0){
+					--k;
+					if (++c[k] < high[k]){
+						break;
+					};
+					c[k] = low[k];
+				};
+				if (k == 0 && c[0] == low[0]){
+					break;
+				};
+			};
+			std::ifstream file(Path, std::ios::binary);
+			if (!file){
+				throw std::runtime_error("Chunked file: can't open " + Path + ".");
+			};
+			std::size_t const batch{ std::max<std::size_t>(1, ChunkedBatchBytes / (Grid.elementsPerTile() * sizeof(T))) };
+			std::vector<unsigned char> buffer;
+			std::vector<std::size_t> starts;
+			for (std::size_t b0 = 0; b0 < touched.size(); b0 += batch){
+				std::size_t const b1{ std::min(touched.size(), b0 + batch) };
+				buffer.clear();
+				starts.assign(1, 0);
+				for (std::size_t b = b0; b < b1; ++b){
+					std::size_t const t{ touched[b] };
+					buffer.resize(buffer.size() + Lengths[t]);
+					file.seekg(static_cast<std::streamoff>(Offsets[t]));
+					file.read(reinterpret_cast<char*>(buffer.data() + starts.back()), static_cast<std::streamsize>(Lengths[t]));
+					if (!file){
+						throw std::runtime_error("Chunked file: unexpected end of file.");
+					};
+					starts.push_back(buffer.size());
+				};
+				ForTiles(b1 - b0, [&](std::size_t firstTile, std::size_t lastTile){
+					std::vector<T> tile;
+					std::vector<unsigned char> scratch;
+					std::vector<std::size_t> origin;
+					std::vector<std::size_t> extent;
+					std::vector<std::size_t> part(Dimension);
+					for (std::size_t b = b0 + firstTile; b < b0 + lastTile; ++b){
+						Grid.box(touched[b], origin, extent);
+						std::size_t count{ 1 };
+						for (auto e : extent){
+							count *= e;
+						};
+						tile.resize(count);
+						DecodeTile(buffer.data() + starts[b - b0], starts[b - b0 + 1] - starts[b - b0], count, sizeof(T), MyCodec,
+							scratch, reinterpret_cast<unsigned char*>(tile.data()));
+						// The part of the tile inside the block.
+						std::vector<std::size_t> const tileStrides{ RowMajorStrides(extent) };
+						std::size_t from{ 0 };
+						std::size_t to{ 0 };
+						for (std::size_t k = 0; k < Dimension; ++k){
+							std::size_t const lo{ std::max(origin[k], first[k]) };
+							std::size_t const hi{ std::min(origin[k] + extent[k], first[k] + sizes[k]) };
+							part[k] = hi - lo;
+							from += (lo - origin[k]) * tileStrides[k];
+							to += (lo - first[k]) * resultStrides[k];
+						};
+						CopyBox(tile.data() + from, tileStrides, out + to, resultStrides, part);
+					};
+				});
+			};
+			return result;
+		};
+	};// END ChunkedReader class
+	//
+}// END namespace FususMatrix
+
+#endif
@@ -0,0 +1,882 @@
+#ifndef _FususDenseFactorizations_
+#define _FususDenseFactorizations_
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include "BufferPool.h"
+#include "Matrix.h"
+#include "MatrixVectorProducts.h"
+#include "RecursiveMultiply.h"
+#include "StructuredMatrix.h"
+
+namespace FususMatrix{
+
+	// Factorizations of dense matrices kept for solving repeatedly, and updated when the matrix changes a little:
+	//   LUFactorization        P A = L U; rank-k changes A + U V^T through the Sherman-Morrison-Woodbury formula
+	//   CholeskyFactorization  A = R^T R; rank-k updates and downdates, rows and columns added and removed
+	//   QRFactorization        A = Q R (least squares); rank-k changes, rows and columns added and removed
+	// A change of rank k costs O(k n^2) instead of the O(n^3) of factoring again, and a solve stays O(n^2).
+	// The factorizations are blocked: panels of FactorizationBlock columns are factored one column at a time and the
+	// rest of the matrix is updated with the products of RecursiveMultiply.h, which hold most of the work.
+	// The updates are sequences of plane rotations, applied to whole rows of row-major factors, so they vectorize.
+
+	// Columns of the panels of FactorLU and FactorCholesky.
+	const std::size_t FactorizationBlock{ 64 };
+	// Default rank of the changes LUFactorization keeps as Woodbury corrections; past it, it factors again.
+	// Each solve costs O(rank n) more, and each change O(rank^3) for the small capacitance matrix.
+	const std::size_t WoodburyMaximumRank{ 64 };
+
+	// A row-major copy of a dense matrix, whatever its strides.
+	template<typename T>
+	Matrix<T, 2> RowMajorCopy(Matrix<T, 2> const& a){
+		std::size_t const m{ a.rows() };
+		std::size_t const n{ a.columns() };
+		Matrix<T, 2> c(m, n);
+		std::vector<std::size_t> const& strides{ a.rep().getStrides() };
+		T const* from{ a.rep().data() };
+		T* to{ c.rep().data() };
+		for (std::size_t i = 0; i < m; ++i){
+			for (std::size_t j = 0; j < n; ++j){
+				to[i * n + j] = from[i * strides[0] + j * strides[1]];
+			};
+		};
+		return c;
+	};
+
+	// Column j of a dense matrix, into out.
+	template<typename T>
+	void CopyColumn(Matrix<T, 2> const& a, std::size_t j, T* out){
+		std::vector<std::size_t> const& strides{ a.rep().getStrides() };
+		T const* from{ a.rep().data() + j * strides[1] };
+		for (std::size_t i = 0; i < a.rows(); ++i){
+			out[i] = from[i * strides[0]];
+		};
+	};
+
+	// The elements of a vector (an n x 1 or 1 x n Matrix, contiguous either way), into out.
+	template<typename T>
+	void CopyVector(Matrix<T, 2> const& a, T* out){
+		std::copy(a.rep().data(), a.rep().data() + a.size(), out);
+	};
+
+	// The view of a row-major matrix, for writing (which detaches it from the Matrices it shares its elements with).
+	template<typename T>
+	MatrixView<T> RowMajorView(Matrix<T, 2>& a){
+		return MatrixView<T>{ a.rep().data(), a.rows(), a.columns(), a.columns(), 1 };
+	};
+
+	// C -= A B, through a negated copy of A in a buffer of BufferPool<T>::Global().
+	template<typename T>
+	void SubtractProduct(MatrixView<T> const& A, MatrixView<T> const& B, MatrixView<T> const& C){
+		if (A.Rows == 0 || A.Columns == 0 || B.Columns == 0){
+			return;
+		};
+		ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(A.Rows * A.Columns) };
+		MatrixView<T> const negated{ buffer.data(), A.Rows, A.Columns, A.Columns, 1 };
+		for (std::size_t i = 0; i < A.Rows; ++i){
+			for (std::size_t j = 0; j < A.Columns; ++j){
+				negated(i, j) = -A(i, j);
+			};
+		};
+		RecursiveMultiplyAdd(negated, B, C);
+	};
+
+	// Plane rotation taking (a, b) to (r, 0): c a + s b = r, c b - s a = 0.
+	template<typename T>
+	void Givens(T a, T b, T& c, T& s){
+		if (b == T{ 0 }){
+			c = T{ 1 };
+			s = T{ 0 };
+			return;
+		};
+		T const r{ std::sqrt(a * a + b * b) };
+		c = a / r;
+		s = b / r;
+	};
+
+	// The rotation applied to the n elements of two rows: x = c x + s y, y = c y - s x.
+	template<typename T>
+	void RotateRows(T* x, T* y, std::size_t n, T c, T s){
+		for (std::size_t j = 0; j < n; ++j){
+			T const a{ x[j] };
+			T const b{ y[j] };
+			x[j] = c * a + s * b;
+			y[j] = c * b - s * a;
+		};
+	};
+
+	// P A = L U in place, for a square row-major view (L below the diagonal, its unit diagonal not stored),
+	// with partial pivoting: row k was swapped with row pivots[k]. Returns false if A is singular.
+	template<typename T>
+	bool FactorLU(MatrixView<T> const& A, std::size_t* pivots){
+		assert(A.Rows == A.Columns && A.ColumnStride == 1);
+		std::size_t const n{ A.Rows };
+		bool regular{ true };
+		for (std::size_t k0 = 0; k0 < n; k0 += FactorizationBlock){
+			std::size_t const k1{ std::min(n, k0 + FactorizationBlock) };
+			// The panel of columns [k0, k1), swapping whole rows.
+			for (std::size_t k = k0; k < k1; ++k){
+				std::size_t p{ k };
+				for (std::size_t i = k + 1; i < n; ++i){
+					if (std::abs(A(i, k)) > std::abs(A(p, k))){
+						p = i;
+					};
+				};
+				pivots[k] = p;
+				if (p != k){
+					std::swap_ranges(&A(k, 0), &A(k, 0) + n, &A(p, 0));
+				};
+				if (A(k, k) == T{ 0 }){
+					regular = false;
+					continue;
+				};
+				T const inverse{ T{ 1 } / A(k, k) };
+				T const* rk{ &A(k, 0) };
+				for (std::size_t i = k + 1; i < n; ++i){
+					T* ri{ &A(i, 0) };
+					T const l{ ri[k] *= inverse };
+					for (std::size_t j = k + 1; j < k1; ++j){
+						ri[j] -= l * rk[j];
+					};
+				};
+			};
+			if (k1 < n){
+				// U12 = L11^-1 A12, by rows, then A22 -= L21 U12.
+				for (std::size_t k = k0; k < k1; ++k){
+					T const* rk{ &A(k, 0) };
+					for (std::size_t i = k + 1; i < k1; ++i){
+						T* ri{ &A(i, 0) };
+						T const l{ ri[k] };
+						for (std::size_t j = k1; j < n; ++j){
+							ri[j] -= l * rk[j];
+						};
+					};
+				};
+				SubtractProduct(A.block(k1, k0, n - k1, k1 - k0), A.block(k0, k1, k1 - k0, n - k1), A.block(k1, k1, n - k1, n - k1));
+			};
+		};
+		return regular;
+	};
+
+	// x = A^-1 x, with the factors and pivots of FactorLU.
+	template<typename T>
+	void SolveLU(MatrixView<T> const& factors, std::size_t const* pivots, T* x){
+		for (std::size_t k = 0; k < factors.Rows; ++k){
+			std::swap(x[k], x[pivots[k]]);
+		};
+		TriangularSolveVector(factors, Triangle::Lower, x, true);
+		TriangularSolveVector(factors, Triangle::Upper, x);
+	};
+
+	// A = R^T R in place, for a symmetric positive definite square row-major view of which the upper triangle
+	// is read; R is left in the upper triangle, and the lower is set to zero. Returns false if A isn't positive definite.
+	template<typename T>
+	bool FactorCholesky(MatrixView<T> const& A){
+		assert(A.Rows == A.Columns && A.ColumnStride == 1);
+		std::size_t const n{ A.Rows };
+		for (std::size_t k0 = 0; k0 < n; k0 += FactorizationBlock){
+			std::size_t const k1{ std::min(n, k0 + FactorizationBlock) };
+			// The rows [k0, k1): R11 and R12 = R11^-T A12.
+			for (std::size_t k = k0; k < k1; ++k){
+				T* rk{ &A(k, 0) };
+				if (!(rk[k] > T{ 0 })){
+					return false;
+				};
+				T const r{ std::sqrt(rk[k]) };
+				T const inverse{ T{ 1 } / r };
+				rk[k] = r;
+				for (std::size_t j = k + 1; j < n; ++j){
+					rk[j] *= inverse;
+				};
+				for (std::size_t i = k + 1; i < k1; ++i){
+					T* ri{ &A(i, 0) };
+					T const c{ rk[i] };
+					for (std::size_t j = i; j < n; ++j){
+						ri[j] -= c * rk[j];
+					};
+				};
+			};
+			// A22 -= R12^T R12, only its upper triangle, in strips of rows.
+			MatrixView<T> const R12{ A.block(k0, k1, k1 - k0, n - k1) };
+			for (std::size_t r0 = k1; r0 < n; r0 += FactorizationBlock){
+				std::size_t const r1{ std::min(n, r0 + FactorizationBlock) };
+				SubtractProduct(R12.block(0, r0 - k1, k1 - k0, r1 - r0).transposed(), R12.block(0, r0 - k1, k1 - k0, n - r0),
+					A.block(r0, r0, r1 - r0, n - r0));
+			};
+		};
+		for (std::size_t i = 1; i < n; ++i){
+			std::fill(&A(i, 0), &A(i, 0) + i, T{ 0 });
+		};
+		return true;
+	};
+
+	// R^T R + x x^T, in place, for the upper triangular row-major R of a Cholesky factorization; x is overwritten.
+	template<typename T>
+	void CholeskyUpdate(MatrixView<T> const& R, T* x){
+		std::size_t const n{ R.Rows };
+		for (std::size_t k = 0; k < n; ++k){
+			T* rk{ &R(k, 0) };
+			T const a{ rk[k] };
+			T const r{ std::sqrt(a * a + x[k] * x[k]) };
+			T const c{ r / a };
+			T const s{ x[k] / a };
+			T const inverse{ a / r };
+			rk[k] = r;
+			for (std::size_t j = k + 1; j < n; ++j){
+				rk[j] = (rk[j] + s * x[j]) * inverse;
+				x[j] = c * x[j] - s * rk[j];
+			};
+		};
+	};
+
+	// R^T R - x x^T, in place, as LINPACK's dchdd: the rotations taking (sqrt(1 - |p|^2), p), p = R^-T x, to (1, 0)
+	// take R to the new factor. Returns false, leaving R unchanged, if the result isn't positive definite.
+	template<typename T>
+	bool CholeskyDowndate(MatrixView<T> const& R, T const* x){
+		std::size_t const n{ R.Rows };
+		ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(4 * n) };
+		T* p{ buffer.data() };
+		T* c{ p + n };
+		T* s{ c + n };
+		T* carry{ s + n };
+		std::copy(x, x + n, p);
+		TriangularSolveVector(R.transposed(), Triangle::Lower, p);
+		T const rest{ T{ 1 } - Dot(p, p, n) };
+		if (!(rest > T{ 0 })){
+			return false;
+		};
+		T alpha{ std::sqrt(rest) };
+		for (std::size_t i = n; i > 0; --i){
+			T const scale{ alpha + std::abs(p[i - 1]) };
+			T const a{ alpha / scale };
+			T const b{ p[i - 1] / scale };
+			T const norm{ std::sqrt(a * a + b * b) };
+			c[i - 1] = a / norm;
+			s[i - 1] = b / norm;
+			alpha = scale * norm;
+		};
+		std::fill(carry, carry + n, T{ 0 });
+		for (std::size_t i = n; i > 0; --i){
+			T* ri{ &R(i - 1, 0) };
+			T const ci{ c[i - 1] };
+			T const si{ s[i - 1] };
+			for (std::size_t j = i - 1; j < n; ++j){
+				T const t{ ci * carry[j] + si * ri[j] };
+				ri[j] = ci * ri[j] - si * carry[j];
+				carry[j] = t;
+			};
+			// Keeps the diagonal positive, which doesn't change R^T R.
+			if (ri[i - 1] < T{ 0 }){
+				for (std::size_t j = i - 1; j < n; ++j){
+					ri[j] = -ri[j];
+				};
+			};
+		};
+		return true;
+	};
+
+	//
+	//                      The LUFactorization Class.
+	// P A = L U of a square matrix, for solving repeatedly. Changes A + U V^T are kept as Woodbury corrections:
+	// with Z = A0^-1 U, A0 the matrix factored, the solution of A x = b is A0^-1 b - Z (I + V^T Z)^-1 V^T A0^-1 b.
+	// Past a maximum rank of the corrections (or if they make the capacitance I + V^T Z singular), the changes are
+	// added to A0 with one product of rank the maximum, and it is factored again.
+	template<typename T = double>
+	class LUFactorization{
+	private:
+		Matrix<T, 2> Factored;
+		Matrix<T, 2> Factors;
+		std::vector<std::size_t> Pivots;
+		bool Regular;
+		std::size_t MaximumRank;
+		// Corrections of rank Rank: U, V and Z by columns, the capacitance I + V^T Z (rows of MaximumRank elements,
+		// so it grows in place), and its factors.
+		std::size_t Rank;
+		std::vector<T> U;
+		std::vector<T> V;
+		std::vector<T> Z;
+		std::vector<T> Capacitance;
+		std::vector<T> CapacitanceFactors;
+		std::vector<std::size_t> CapacitancePivots;
+
+		// Adds the changes to the matrix and factors it.
+		void Factor(){
+			std::size_t const n{ rows() };
+			std::size_t const k{ U.size() / n };
+			if (k > 0){
+				RecursiveMultiplyAdd(MatrixView<T>{ U.data(), n, k, 1, n }, MatrixView<T>{ V.data(), k, n, n, 1 }, RowMajorView(Factored));
+			};
+			Factors = Factored;
+			Regular = FactorLU(RowMajorView(Factors), Pivots.data());
+			Rank = 0;
+			U.clear();
+			V.clear();
+			Z.clear();
+		};
+
+		// A += U V^T for the k columns of u and v, of n elements each.
+		void Update(T const* u, T const* v, std::size_t k){
+			std::size_t const n{ rows() };
+			U.insert(U.end(), u, u + k * n);
+			V.insert(V.end(), v, v + k * n);
+			if (!Regular || Rank + k > MaximumRank){
+				Factor();
+				return;
+			};
+			MatrixView<T> const factors{ Factors.rep().data(), n, n, n, 1 };
+			Z.insert(Z.end(), u, u + k * n);
+			for (std::size_t c = Rank; c < Rank + k; ++c){
+				SolveLU(factors, Pivots.data(), Z.data() + c * n);
+			};
+			// The new rows and columns of I + V^T Z.
+			std::size_t const r{ Rank + k };
+			for (std::size_t i = 0; i < r; ++i){
+				for (std::size_t j = (i < Rank ? Rank : 0); j < r; ++j){
+					Capacitance[i * MaximumRank + j] = (i == j ? T{ 1 } : T{ 0 }) + Dot(V.data() + i * n, Z.data() + j * n, n);
+				};
+			};
+			Rank = r;
+			CapacitanceFactors.resize(Rank * Rank);
+			for (std::size_t i = 0; i < Rank; ++i){
+				std::copy(&Capacitance[i * MaximumRank], &Capacitance[i * MaximumRank] + Rank, &CapacitanceFactors[i * Rank]);
+			};
+			if (!FactorLU(MatrixView<T>{ CapacitanceFactors.data(), Rank, Rank, Rank, 1 }, CapacitancePivots.data())){
+				Factor();
+			};
+		};
+	public:
+		// Factors the square matrix a. maximumRank is the rank of the changes kept as corrections.
+		explicit LUFactorization(Matrix<T, 2> const& a, std::size_t maximumRank = WoodburyMaximumRank)
+			: Factored(RowMajorCopy(a)), Factors(Factored), Pivots(a.rows()), Regular(false), MaximumRank(maximumRank),
+			Rank(0), Capacitance(maximumRank * maximumRank), CapacitancePivots(maximumRank){
+			assert(a.rows() == a.columns());
+			Factor();
+		};
+
+		std::size_t rows() const {
+			return Factored.rows();
+		};
+
+		// False if the matrix is singular (its factors are then not usable).
+		bool regular() const {
+			return Regular;
+		};
+
+		// Rank of the changes kept as corrections since the matrix was last factored.
+		std::size_t correctionRank() const {
+			return Rank;
+		};
+
+		// The matrix, with the changes applied. O(rank n^2).
+		Matrix<T, 2> matrix() const {
+			std::size_t const n{ rows() };
+			Matrix<T, 2> a{ RowMajorCopy(Factored) };
+			RecursiveMultiplyAdd(MatrixView<T>{ const_cast<T*>(U.data()), n, Rank, 1, n },
+				MatrixView<T>{ const_cast<T*>(V.data()), Rank, n, n, 1 }, RowMajorView(a));
+			return a;
+		};
+
+		// A += U V^T, for n x k matrices U and V. O(k n^2).
+		void update(Matrix<T, 2> const& u, Matrix<T, 2> const& v){
+			std::size_t const n{ rows() };
+			std::size_t const k{ u.columns() };
+			assert(u.rows() == n && v.rows() == n && v.columns() == k);
+			ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(2 * k * n) };
+			for (std::size_t c = 0; c < k; ++c){
+				CopyColumn(u, c, buffer.data() + c * n);
+				CopyColumn(v, c, buffer.data() + (k + c) * n);
+			};
+			Update(buffer.data(), buffer.data() + k * n, k);
+		};
+
+		// Replaces row i, or column j, of A by the n elements of a vector. O(n^2).
+		void replaceRow(std::size_t i, Matrix<T, 2> const& row){
+			std::size_t const n{ rows() };
+			assert(i < n && row.size() == n);
+			ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(2 * n) };
+			T* u{ buffer.data() };
+			T* v{ u + n };
+			std::fill(u, u + n, T{ 0 });
+			u[i] = T{ 1 };
+			CopyVector(row, v);
+			// Minus the row as it is now: that of A0 and those of the corrections.
+			T const* current{ Factored.rep().data() + i * n };
+			for (std::size_t j = 0; j < n; ++j){
+				v[j] -= current[j];
+			};
+			for (std::size_t c = 0; c < Rank; ++c){
+				T const uc{ U[c * n + i] };
+				T const* vc{ V.data() + c * n };
+				for (std::size_t j = 0; j < n; ++j){
+					v[j] -= uc * vc[j];
+				};
+			};
+			Update(u, v, 1);
+		};
+		void replaceColumn(std::size_t j, Matrix<T, 2> const& column){
+			std::size_t const n{ rows() };
+			assert(j < n && column.size() == n);
+			ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(2 * n) };
+			T* u{ buffer.data() };
+			T* v{ u + n };
+			CopyVector(column, u);
+			T const* current{ Factored.rep().data() };
+			for (std::size_t i = 0; i < n; ++i){
+				u[i] -= current[i * n + j];
+			};
+			for (std::size_t c = 0; c < Rank; ++c){
+				T const vc{ V[c * n + j] };
+				T const* uc{ U.data() + c * n };
+				for (std::size_t i = 0; i < n; ++i){
+					u[i] -= vc * uc[i];
+				};
+			};
+			std::fill(v, v + n, T{ 0 });
+			v[j] = T{ 1 };
+			Update(u, v, 1);
+		};
+
+		// x = A^-1 x, for a vector of n elements. O(n^2 + rank n).
+		void solve(T* x) const {
+			std::size_t const n{ rows() };
+			SolveLU(MatrixView<T>{ const_cast<T*>(Factors.rep().data()), n, n, n, 1 }, Pivots.data(), x);
+			if (Rank == 0){
+				return;
+			};
+			ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(Rank) };
+			T* w{ buffer.data() };
+			for (std::size_t c = 0; c < Rank; ++c){
+				w[c] = Dot(V.data() + c * n, x, n);
+			};
+			SolveLU(MatrixView<T>{ const_cast<T*>(CapacitanceFactors.data()), Rank, Rank, Rank, 1 }, CapacitancePivots.data(), w);
+			for (std::size_t c = 0; c < Rank; ++c){
+				T const* z{ Z.data() + c * n };
+				T const wc{ w[c] };
+				for (std::size_t i = 0; i < n; ++i){
+					x[i] -= wc * z[i];
+				};
+			};
+		};
+
+		// Solution of A x = b, for each column of b, written into x (resized only if needed).
+		Matrix<T, 2>& span(Matrix<T, 2> const& b, Matrix<T, 2>& x) const {
+			assert(Regular && b.rows() == rows());
+			ForEachColumn(b, x, [this](T const* in, T* out){
+				std::copy(in, in + rows(), out);
+				solve(out);
+			});
+			return x;
+		};
+		Matrix<T, 2> span(Matrix<T, 2> const& b) const {
+			Matrix<T, 2> x(b.rows(), b.columns());
+			return span(b, x);
+		};
+	};// END LUFactorization class
+
+	//
+	//                      The CholeskyFactorization Class.
+	// A = R^T R of a symmetric positive definite matrix (its upper triangle is read), R upper triangular.
+	// The changes are applied to R directly: rank-one updates and downdates by rotations, O(n^2) each; a row and
+	// column added at the end by one triangular solve; row and column k removed by an update of the rows below k.
+	template<typename T = double>
+	class CholeskyFactorization{
+	private:
+		Matrix<T, 2> R;
+		bool PositiveDefinite;
+	public:
+		explicit CholeskyFactorization(Matrix<T, 2> const& a)
+			: R(RowMajorCopy(a)), PositiveDefinite(false){
+			assert(a.rows() == a.columns());
+			PositiveDefinite = FactorCholesky(RowMajorView(R));
+		};
+
+		std::size_t rows() const {
+			return R.rows();
+		};
+
+		// False if the matrix wasn't positive definite (the factor is then not usable).
+		bool positiveDefinite() const {
+			return PositiveDefinite;
+		};
+
+		// The factor R.
+		Matrix<T, 2> const& factor() const {
+			return R;
+		};
+
+		// A += X X^T, for an n x k matrix X. O(k n^2).
+		void update(Matrix<T, 2> const& x){
+			std::size_t const n{ rows() };
+			assert(PositiveDefinite && x.rows() == n);
+			ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(n) };
+			MatrixView<T> const r{ RowMajorView(R) };
+			for (std::size_t c = 0; c < x.columns(); ++c){
+				CopyColumn(x, c, buffer.data());
+				CholeskyUpdate(r, buffer.data());
+			};
+		};
+
+		// A -= X X^T, for an n x k matrix X. O(k n^2).
+		// Returns false, leaving the factor unchanged, if the result wouldn't be positive definite.
+		bool downdate(Matrix<T, 2> const& x){
+			std::size_t const n{ rows() };
+			assert(PositiveDefinite && x.rows() == n);
+			Matrix<T, 2> const before{ R };
+			ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(n) };
+			MatrixView<T> const r{ RowMajorView(R) };
+			for (std::size_t c = 0; c < x.columns(); ++c){
+				CopyColumn(x, c, buffer.data());
+				if (!CholeskyDowndate(r, buffer.data())){
+					R = before;
+					return false;
+				};
+			};
+			return true;
+		};
+
+		// Adds a last row and column to A, given as the n + 1 elements of the new last column. O(n^2).
+		// Returns false, leaving the factor unchanged, if the result wouldn't be positive definite.
+		bool append(Matrix<T, 2> const& column){
+			std::size_t const n{ rows() };
+			assert(PositiveDefinite && column.size() == n + 1);
+			Matrix<T, 2> larger(n + 1, n + 1);
+			T* l{ larger.rep().data() };
+			T const* r{ R.rep().data() };
+			ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(n + 1) };
+			T* a{ buffer.data() };
+			CopyVector(column, a);
+			TriangularSolveVector(MatrixView<T>{ const_cast<T*>(r), n, n, 1, n }, Triangle::Lower, a);
+			T const rest{ a[n] - Dot(a, a, n) };
+			if (!(rest > T{ 0 })){
+				return false;
+			};
+			for (std::size_t i = 0; i < n; ++i){
+				std::copy(r + i * n, r + i * n + n, l + i * (n + 1));
+				l[i * (n + 1) + n] = a[i];
+			};
+			std::fill(l + n * (n + 1), l + n * (n + 1) + n, T{ 0 });
+			l[n * (n + 1) + n] = std::sqrt(rest);
+			R.rep() = std::move(larger.rep());
+			return true;
+		};
+
+		// Removes row and column k of A. O((n - k)^2), plus O(n^2) to copy the factor.
+		void remove(std::size_t k){
+			std::size_t const n{ rows() };
+			assert(PositiveDefinite && k < n && n > 1);
+			Matrix<T, 2> smaller(n - 1, n - 1);
+			T* l{ smaller.rep().data() };
+			T const* r{ R.rep().data() };
+			for (std::size_t i = 0; i < n; ++i){
+				if (i == k){
+					continue;
+				};
+				T* row{ l + (i < k ? i : i - 1) * (n - 1) };
+				std::copy(r + i * n, r + i * n + k, row);
+				std::copy(r + i * n + k + 1, r + i * n + n, row + k);
+			};
+			// The rows below k lost row k of R: R33^T R33 + r^T r, r the rest of row k.
+			ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(n) };
+			std::copy(r + k * n + k + 1, r + k * n + n, buffer.data());
+			CholeskyUpdate(MatrixView<T>{ l + k * (n - 1) + k, n - 1 - k, n - 1 - k, n - 1, 1 }, buffer.data());
+			R.rep() = std::move(smaller.rep());
+		};
+
+		// x = A^-1 x, for a vector of n elements. O(n^2).
+		void solve(T* x) const {
+			std::size_t const n{ rows() };
+			MatrixView<T> const r{ const_cast<T*>(R.rep().data()), n, n, n, 1 };
+			TriangularSolveVector(r.transposed(), Triangle::Lower, x);
+			TriangularSolveVector(r, Triangle::Upper, x);
+		};
+
+		// Solution of A x = b, for each column of b, written into x (resized only if needed).
+		Matrix<T, 2>& span(Matrix<T, 2> const& b, Matrix<T, 2>& x) const {
+			assert(PositiveDefinite && b.rows() == rows());
+			ForEachColumn(b, x, [this](T const* in, T* out){
+				std::copy(in, in + rows(), out);
+				solve(out);
+			});
+			return x;
+		};
+		Matrix<T, 2> span(Matrix<T, 2> const& b) const {
+			Matrix<T, 2> x(b.rows(), b.columns());
+			return span(b, x);
+		};
+	};// END CholeskyFactorization class
+
+	//
+	//                      The QRFactorization Class.
+	// A = Q R of an m x n matrix, m >= n, by Householder reflections, with Q kept whole (as Q^T, so that the rotations
+	// act on its rows) for the updates of Golub and Van Loan, 12.5: A + u v^T, rows and columns added and removed,
+	// each by two sweeps of rotations, O(m^2) (the rows added or removed are observations of a least squares problem).
+	template<typename T = double>
+	class QRFactorization{
+	private:
+		Matrix<T, 2> Qt;
+		Matrix<T, 2> R;
+
+		// Rotation of rows k and l of Q^T and of R, the latter from column j.
+		void Rotate(std::size_t k, std::size_t l, std::size_t j, T c, T s){
+			std::size_t const m{ rows() };
+			std::size_t const n{ columns() };
+			T* qt{ Qt.rep().data() };
+			RotateRows(qt + k * m, qt + l * m, m, c, s);
+			if (j < n){
+				T* r{ R.rep().data() };
+				RotateRows(r + k * n + j, r + l * n + j, n - j, c, s);
+			};
+		};
+
+		// Zeroes the subdiagonal of an upper Hessenberg R from column j.
+		void Triangularize(std::size_t j){
+			std::size_t const m{ rows() };
+			std::size_t const n{ columns() };
+			T* r{ R.rep().data() };
+			for (std::size_t k = j; k < n && k + 1 < m; ++k){
+				T c;
+				T s;
+				Givens(r[k * n + k], r[(k + 1) * n + k], c, s);
+				Rotate(k, k + 1, k, c, s);
+				r[(k + 1) * n + k] = T{ 0 };
+			};
+		};
+	public:
+		explicit QRFactorization(Matrix<T, 2> const& a)
+			: Qt(a.rows(), a.rows()), R(RowMajorCopy(a)){
+			std::size_t const m{ a.rows() };
+			std::size_t const n{ a.columns() };
+			assert(m >= n);
+			T* qt{ Qt.rep().data() };
+			std::fill(qt, qt + m * m, T{ 0 });
+			for (std::size_t i = 0; i < m; ++i){
+				qt[i * m + i] = T{ 1 };
+			};
+			MatrixView<T> const r{ RowMajorView(R) };
+			MatrixView<T> const q{ RowMajorView(Qt) };
+			ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(2 * m) };
+			T* v{ buffer.data() };
+			T* w{ v + m };
+			for (std::size_t k = 0; k < n && k + 1 < m; ++k){
+				// The reflection I - tau v v^T taking column k, from row k, to (alpha, 0, ...).
+				for (std::size_t i = k; i < m; ++i){
+					v[i - k] = r(i, k);
+				};
+				T const norm{ std::sqrt(Dot(v, v, m - k)) };
+				if (norm == T{ 0 }){
+					continue;
+				};
+				T const alpha{ v[0] > T{ 0 } ? -norm : norm };
+				v[0] -= alpha;
+				T const tau{ T{ 2 } / Dot(v, v, m - k) };
+				MatrixView<T> const rb{ r.block(k, k, m - k, n - k) };
+				MultiplyVector(rb.transposed(), v, w);
+				RankOneUpdate(rb, -tau, v, w);
+				r(k, k) = alpha;
+				for (std::size_t i = k + 1; i < m; ++i){
+					r(i, k) = T{ 0 };
+				};
+				MatrixView<T> const qb{ q.block(k, 0, m - k, m) };
+				MultiplyVector(qb.transposed(), v, w);
+				RankOneUpdate(qb, -tau, v, w);
+			};
+		};
+
+		std::size_t rows() const {
+			return R.rows();
+		};
+		std::size_t columns() const {
+			return R.columns();
+		};
+
+		// Q^T and R.
+		Matrix<T, 2> const& transposedQ() const {
+			return Qt;
+		};
+		Matrix<T, 2> const& factor() const {
+			return R;
+		};
+
+		// A += U V^T, for an m x k U and an n x k V. O(k m^2).
+		void update(Matrix<T, 2> const& u, Matrix<T, 2> const& v){
+			std::size_t const m{ rows() };
+			std::size_t const n{ columns() };
+			assert(u.rows() == m && v.rows() == n && u.columns() == v.columns());
+			ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(2 * m + n) };
+			T* x{ buffer.data() };
+			T* w{ x + m };
+			T* y{ w + m };
+			for (std::size_t c = 0; c < u.columns(); ++c){
+				CopyColumn(u, c, x);
+				CopyColumn(v, c, y);
+				// w = Q^T u, taken to a multiple of e_0 by rotations from the bottom, which leave R upper Hessenberg.
+				MultiplyVector(MatrixView<T>{ Qt.rep().data(), m, m, m, 1 }, x, w);
+				for (std::size_t k = m - 1; k > 0; --k){
+					T cosine;
+					T sine;
+					Givens(w[k - 1], w[k], cosine, sine);
+					Rotate(k - 1, k, k - 1, cosine, sine);
+					w[k - 1] = cosine * w[k - 1] + sine * w[k];
+					w[k] = T{ 0 };
+				};
+				T* r0{ R.rep().data() };
+				for (std::size_t j = 0; j < n; ++j){
+					r0[j] += w[0] * y[j];
+				};
+				Triangularize(0);
+			};
+		};
+
+		// Adds a last row to A, given as a vector of n elements. O(m^2), to copy Q.
+		void appendRow(Matrix<T, 2> const& row){
+			std::size_t const m{ rows() };
+			std::size_t const n{ columns() };
+			assert(row.size() == n);
+			Matrix<T, 2> qt(m + 1, m + 1);
+			Matrix<T, 2> r(m + 1, n);
+			T* q{ qt.rep().data() };
+			T const* q0{ Qt.rep().data() };
+			for (std::size_t i = 0; i < m; ++i){
+				std::copy(q0 + i * m, q0 + i * m + m, q + i * (m + 1));
+				q[i * (m + 1) + m] = T{ 0 };
+			};
+			std::fill(q + m * (m + 1), q + m * (m + 1) + m, T{ 0 });
+			q[m * (m + 1) + m] = T{ 1 };
+			std::copy(R.rep().data(), R.rep().data() + m * n, r.rep().data());
+			CopyVector(row, r.rep().data() + m * n);
+			Qt.rep() = std::move(qt.rep());
+			R.rep() = std::move(r.rep());
+			// The new row is rotated into each row of R.
+			T* rr{ R.rep().data() };
+			for (std::size_t k = 0; k < n; ++k){
+				T c;
+				T s;
+				Givens(rr[k * n + k], rr[m * n + k], c, s);
+				Rotate(k, m, k, c, s);
+				rr[m * n + k] = T{ 0 };
+			};
+		};
+
+		// Removes row i of A. O(m^2).
+		void removeRow(std::size_t i){
+			std::size_t const m{ rows() };
+			std::size_t const n{ columns() };
+			assert(i < m && m > n);
+			// Row i of Q, taken to a multiple of e_0 by rotations from the bottom: then the first row of Q^T is
+			// (a multiple of) e_i, and the first row of R is row i of A.
+			ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(m) };
+			T* w{ buffer.data() };
+			T const* q0{ Qt.rep().data() };
+			for (std::size_t k = 0; k < m; ++k){
+				w[k] = q0[k * m + i];
+			};
+			for (std::size_t k = m - 1; k > 0; --k){
+				T c;
+				T s;
+				Givens(w[k - 1], w[k], c, s);
+				Rotate(k - 1, k, k - 1, c, s);
+				w[k - 1] = c * w[k - 1] + s * w[k];
+				w[k] = T{ 0 };
+			};
+			Matrix<T, 2> qt(m - 1, m - 1);
+			Matrix<T, 2> r(m - 1, n);
+			T* q{ qt.rep().data() };
+			q0 = Qt.rep().data();
+			for (std::size_t k = 1; k < m; ++k){
+				std::copy(q0 + k * m, q0 + k * m + i, q + (k - 1) * (m - 1));
+				std::copy(q0 + k * m + i + 1, q0 + k * m + m, q + (k - 1) * (m - 1) + i);
+			};
+			std::copy(R.rep().data() + n, R.rep().data() + m * n, r.rep().data());
+			Qt.rep() = std::move(qt.rep());
+			R.rep() = std::move(r.rep());
+		};
+
+		// Adds a last column to A, given as a vector of m elements. O(m^2), to copy R.
+		void appendColumn(Matrix<T, 2> const& column){
+			std::size_t const m{ rows() };
+			std::size_t const n{ columns() };
+			assert(column.size() == m && n < m);
+			ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(2 * m) };
+			T* a{ buffer.data() };
+			T* w{ a + m };
+			CopyVector(column, a);
+			MultiplyVector(MatrixView<T>{ Qt.rep().data(), m, m, m, 1 }, a, w);
+			// Q^T a below row n is rotated into row n; the rows of R there are zero.
+			for (std::size_t k = m - 1; k > n; --k){
+				T c;
+				T s;
+				Givens(w[k - 1], w[k], c, s);
+				Rotate(k - 1, k, n, c, s);
+				w[k - 1] = c * w[k - 1] + s * w[k];
+				w[k] = T{ 0 };
+			};
+			Matrix<T, 2> r(m, n + 1);
+			T* rr{ r.rep().data() };
+			T const* r0{ R.rep().data() };
+			for (std::size_t k = 0; k < m; ++k){
+				std::copy(r0 + k * n, r0 + k * n + n, rr + k * (n + 1));
+				rr[k * (n + 1) + n] = w[k];
+			};
+			R.rep() = std::move(r.rep());
+		};
+
+		// Removes column j of A. O(m (n - j)), plus O(m n) to copy R.
+		void removeColumn(std::size_t j){
+			std::size_t const m{ rows() };
+			std::size_t const n{ columns() };
+			assert(j < n && n > 1);
+			Matrix<T, 2> r(m, n - 1);
+			T* rr{ r.rep().data() };
+			T const* r0{ R.rep().data() };
+			for (std::size_t k = 0; k < m; ++k){
+				std::copy(r0 + k * n, r0 + k * n + j, rr + k * (n - 1));
+				std::copy(r0 + k * n + j + 1, r0 + k * n + n, rr + k * (n - 1) + j);
+			};
+			R.rep() = std::move(r.rep());
+			Triangularize(j);
+		};
+
+		// Least squares solution x (n elements) of A x = b (m elements); A must have full column rank. O(m n).
+		void solve(T const* b, T* x) const {
+			std::size_t const m{ rows() };
+			std::size_t const n{ columns() };
+			MultiplyVector(MatrixView<T>{ const_cast<T*>(Qt.rep().data()), n, m, m, 1 }, b, x);
+			TriangularSolveVector(MatrixView<T>{ const_cast<T*>(R.rep().data()), n, n, n, 1 }, Triangle::Upper, x);
+		};
+
+		// Least squares solutions for each column of the m x k b, into the n x k x (resized only if needed).
+		Matrix<T, 2>& span(Matrix<T, 2> const& b, Matrix<T, 2>& x) const {
+			std::size_t const m{ rows() };
+			std::size_t const n{ columns() };
+			std::size_t const k{ b.columns() };
+			assert(b.rows() == m);
+			if (x.rows() != n || x.columns() != k){
+				x.rep().resize({ n, k });
+			};
+			ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(m + n) };
+			T* in{ buffer.data() };
+			T* out{ in + m };
+			T* elements{ x.rep().data() };
+			std::size_t const rowStride{ x.rep().getStrides()[0] };
+			std::size_t const columnStride{ x.rep().getStrides()[1] };
+			for (std::size_t c = 0; c < k; ++c){
+				CopyColumn(b, c, in);
+				solve(in, out);
+				for (std::size_t i = 0; i < n; ++i){
+					elements[i * rowStride + c * columnStride] = out[i];
+				};
+			};
+			return x;
+		};
+		Matrix<T, 2> span(Matrix<T, 2> const& b) const {
+			Matrix<T, 2> x(columns(), b.columns());
+			return span(b, x);
+		};
+	};// END QRFactorization class
+	//
+}// END namespace FususMatrix
+
+#endif
@@ -1,28 +1,274 @@
 #ifndef _FususDenseMatrixContainer_
 #define _FususDenseMatrixContainer_
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <numeric>
 #include <deque>
+#include <functional>
+#include <utility>
 #include <type_traits>
 
+#include "Layout.h"
+#include "MatrixVectorProducts.h"
+#include "RecursiveMultiply.h"
+#include "ThreadPool.h"
+
 namespace FususMatrix{
 
+	// Allocator that leaves default constructed elements of trivial types unwritten.
+	// The pages of a new buffer are then first written by DenseMatrixContainer::FirstTouch,
+	// from the threads that will later use them, and land on their NUMA nodes.
+	template<typename T>
+	class FirstTouchAllocator : public std::allocator<T>{
+	public:
+		template<typename U>
+		struct rebind{
+			typedef FirstTouchAllocator<U> other;
+		};
+
+		FirstTouchAllocator(){
+		};
+		template<typename U>
+		FirstTouchAllocator(const FirstTouchAllocator<U>&){
+		};
+
+		// Default initialization instead of value initialization.
+		template<typename U>
+		void construct(U* p){
+			::new(static_cast<void*>(p)) U;
+		};
+		template<typename U, typename... Arguments>
+		void construct(U* p, Arguments&&... arguments){
+			::new(static_cast<void*>(p)) U(std::forward<Arguments>(arguments)...);
+		};
+	};
+	template<typename T, typename U>
+	bool operator==(const FirstTouchAllocator<T>&, const FirstTouchAllocator<U>&){
+		return true;
+	};
+	template<typename T, typename U>
+	bool operator!=(const FirstTouchAllocator<T>&, const FirstTouchAllocator<U>&){
+		return false;
+	};
+
+	// Elements copied per leaf of the cache-oblivious rearrangements of DenseMatrixContainer (16 KB of doubles
+	// read and written, within L1).
+	const std::size_t CopyLeafElements{ 1024 };
+
 	template <typename T>
 	using MyContainerType = typename std::conditional<
 		std::is_same<T, bool>::value,
 		std::deque<T>,
-		std::vector<T>
+		std::vector<T, FirstTouchAllocator<T> >
 	>::type;
 	//    Dense Matrix Container. 
 	//////////////////////////////////////////////////
 	template<typename T = double, std::size_t Dimension = 2>
 	class DenseMatrixContainer{		
+		template<typename, std::size_t>
+		friend class DenseMatrixContainer;
 	private:
-		MyContainerType<T> MyData; // Data of the Matrix
-		bool Transposed; // Transposed or not.
+		std::shared_ptr<MyContainerType<T> > MyData; // Data of the Matrix, shared by copies until one of them writes.
+		bool Transposed; // Transposed or not. The sizes and strides are those of the transposed matrix.
 		std::size_t MyDimension; // Dimension.
 		std::vector<std::size_t> SizesAlongEachDimension; // Sizes along each dimension.
-		std::vector<std::size_t> Strides; // Used to locate the elements of the matrix inside the 1-D vector container.
+		std::vector<std::size_t> Strides; // Used to locate the elements of the matrix inside the 1-D vector container, per (logical) coordinate.
+
+		// Writes zeros into the elements of a new buffer.
+		// Large buffers are written by the workers of ThreadPool::Global(), block k by worker k. Matrix evaluates
+		// expressions over the same blocks, so each page lies on the NUMA node of the thread that uses it.
+		template<typename Container>
+		static void FirstTouch(Container& data){
+			std::size_t const n{ data.size() };
+			ThreadPool& pool{ ThreadPool::Global() };
+			if (n >= ParallelElementThreshold && pool.size() > 1){
+				pool.ParallelForStatic(0, n, [&data](std::size_t first, std::size_t last){
+					std::fill(data.begin() + first, data.begin() + last, T{});
+				});
+			}
+			else{
+				std::fill(data.begin(), data.end(), T{});
+			};
+		};
+		// std::deque<bool> already value-initializes.
+		static void FirstTouch(std::deque<T>&){
+		};
+
+		// A copy of the elements in a new buffer, written over the same blocks as FirstTouch.
+		template<typename Container>
+		static std::shared_ptr<Container> Duplicate(Container const& data){
+			std::size_t const n{ data.size() };
+			std::shared_ptr<Container> copy{ std::make_shared<Container>(n) };
+			ThreadPool& pool{ ThreadPool::Global() };
+			if (n >= ParallelElementThreshold && pool.size() > 1){
+				pool.ParallelForStatic(0, n, [&data, &copy](std::size_t first, std::size_t last){
+					std::copy(data.begin() + first, data.begin() + last, copy->begin() + first);
+				});
+			}
+			else{
+				std::copy(data.begin(), data.end(), copy->begin());
+			};
+			return copy;
+		};
+		static std::shared_ptr<std::deque<T> > Duplicate(std::deque<T> const& data){
+			return std::make_shared<std::deque<T> >(data);
+		};
+
+		// Copy-on-write.
+		// Copies of a container share its buffer, so that copying and taking snapshots is O(1). The use count is
+		// atomic: copies can be taken and dropped from any thread. Before writing, a container whose buffer is
+		// still shared gives itself a copy of its own, so the other holders never see the change.
+		// The acquire fence orders the writes after the reads of holders that have just dropped the buffer.
+		MyContainerType<T>& Own(){
+			if (MyData.use_count() > 1){
+				MyData = Duplicate(*MyData);
+			};
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return *MyData;
+		};
+
+		// Strides of the row-major order for the current sizes.
+		void InitializeStrides(){
+			for (std::size_t i = 0; i < Strides.size(); ++i){
+				Strides[i] = 1;
+			};
+			for (std::size_t i = 1; i < SizesAlongEachDimension.size(); ++i){
+				for (std::size_t j = 0; j < i; ++j){
+					Strides[j] *= SizesAlongEachDimension[i];
+				};
+			};
+		};
+
+		// Whether the elements are in one block of memory (not for std::deque<bool>).
+		template<typename Container>
+		static bool Contiguous(Container const&){
+			return true;
+		};
+		static bool Contiguous(std::deque<T> const&){
+			return false;
+		};
+		template<typename Container>
+		static T* DataOf(Container& data){
+			return data.data();
+		};
+		static T* DataOf(std::deque<T>&){
+			return nullptr;
+		};
+
+		// Layout of elements with the given sizes and strides, see layout().
+		static Layout LayoutOf(std::vector<std::size_t> const& sizes, std::vector<std::size_t> const& strides){
+			bool RowMajor{ true };
+			bool ColumnMajor{ true };
+			std::size_t expected{ 1 };
+			for (std::size_t i = sizes.size(); i > 0; --i){
+				if (sizes[i - 1] > 1 && strides[i - 1] != expected){
+					RowMajor = false;
+				};
+				expected *= sizes[i - 1];
+			};
+			expected = 1;
+			for (std::size_t i = 0; i < sizes.size(); ++i){
+				if (sizes[i] > 1 && strides[i] != expected){
+					ColumnMajor = false;
+				};
+				expected *= sizes[i];
+			};
+			return RowMajor ? Layout::RowMajor : (ColumnMajor ? Layout::ColumnMajor : Layout::Strided);
+		};
+
+		// Container over an existing buffer, in row-major order (see reshaped()).
+		DenseMatrixContainer(std::shared_ptr<MyContainerType<T> > data, std::vector<std::size_t> const& sizes)
+			: MyData(std::move(data)), Transposed(false), MyDimension(Dimension), SizesAlongEachDimension(sizes), Strides(Dimension, 1){
+			assert(sizes.size() == Dimension);
+			InitializeStrides();
+		};
+
+		// Copy of the box [first, last) of the coordinates of a row-major target from a source read with the
+		// given strides. Cache-oblivious like transposeRecursion: the box is halved along its longest side until
+		// it fits in L1, the halves of large boxes copied in parallel. In the leaves the target is written in order.
+		typedef std::array<std::size_t, Dimension> Coordinates;
+		static void CopyRecursion(MyContainerType<T> const& source, Coordinates const& sourceStrides, MyContainerType<T>& target,
+			Coordinates const& targetStrides, Coordinates first, Coordinates last){
+			std::size_t volume{ 1 };
+			std::size_t longest{ 0 };
+			for (std::size_t k = 0; k < Dimension; ++k){
+				volume *= last[k] - first[k];
+				if (last[k] - first[k] > last[longest] - first[longest]){
+					longest = k;
+				};
+			};
+			if (volume == 0){
+				return;
+			};
+			if (volume > CopyLeafElements && last[longest] - first[longest] > 1){
+				std::size_t const middle{ first[longest] + (last[longest] - first[longest]) / 2 };
+				Coordinates lower{ last };
+				Coordinates upper{ first };
+				lower[longest] = middle;
+				upper[longest] = middle;
+				ThreadPool& pool{ ThreadPool::Global() };
+				if (volume >= ParallelElementThreshold && pool.size() > 1){
+					pool.Invoke([&]{ CopyRecursion(source, sourceStrides, target, targetStrides, first, lower); },
+						[&]{ CopyRecursion(source, sourceStrides, target, targetStrides, upper, last); });
+				}
+				else{
+					CopyRecursion(source, sourceStrides, target, targetStrides, first, lower);
+					CopyRecursion(source, sourceStrides, target, targetStrides, upper, last);
+				};
+				return;
+			};
+			// Odometer over the outer coordinates, the last one (contiguous in the target) innermost.
+			std::size_t const inner{ Dimension - 1 };
+			Coordinates c{ first };
+			while (true){
+				std::size_t from{ 0 };
+				std::size_t to{ 0 };
+				for (std::size_t k = 0; k < inner; ++k){
+					from += c[k] * sourceStrides[k];
+					to += c[k] * targetStrides[k];
+				};
+				for (std::size_t i = first[inner]; i < last[inner]; ++i){
+					target[to + i] = source[from + i * sourceStrides[inner]];
+				};
+				std::size_t k{ inner };
+				while (k > 0){
+					--k;
+					if (++c[k] < last[k]){
+						break;
+					};
+					c[k] = first[k];
+				};
+				if (k == 0 && c[0] == first[0]){
+					return;
+				};
+			};
+		};
+
+		// Rearranges the elements into a new buffer in the row-major order of the given sizes, reading them with
+		// the given strides.
+		void Rearrange(std::vector<std::size_t> const& sizes, std::vector<std::size_t> const& strides){
+			DenseMatrixContainer temp(std::make_shared<MyContainerType<T> >(MyData->size()), sizes);
+			Coordinates sourceStrides{};
+			Coordinates targetStrides{};
+			Coordinates first{};
+			Coordinates last{};
+			for (std::size_t k = 0; k < Dimension; ++k){
+				sourceStrides[k] = strides[k];
+				targetStrides[k] = temp.Strides[k];
+				last[k] = sizes[k];
+			};
+			CopyRecursion(*MyData, sourceStrides, *temp.MyData, targetStrides, first, last);
+			swap(temp);
+		};
+
+		// View of the elements of a 2-D container, for the multiplication kernels.
+		// The kernels never write through the views of their factors, hence the const_cast.
+		MatrixView<T> view() const {
+			return MatrixView<T>{ DataOf(*MyData), SizesAlongEachDimension[0], SizesAlongEachDimension[1], Strides[0], Strides[1] };
+		};
 	public:
 		// Constructor from the sizes along each dimension.
 		template<typename... Sizes>
@@ -32,7 +278,7 @@ namespace FususMatrix{
 				for (std::size_t i = 0; i < dimension; ++i){
 					SizesAlongEachDimension[i] = 0;
 				};
-				MyData = MyContainerType<T>(1);// Such that size zero are only the scalars.
+				MyData = std::make_shared<MyContainerType<T> >(1);// Such that size zero are only the scalars.
 			}
 			else{
 				SizesAlongEachDimension = { static_cast<std::size_t>(sizes)... };
@@ -40,53 +286,123 @@ namespace FususMatrix{
 				for (auto i : SizesAlongEachDimension){
 					temp *= i;
 				};
-				MyData = MyContainerType<T>(temp);
+				MyData = std::make_shared<MyContainerType<T> >(temp);
 			};
-			assert(MyData.size() > 0 || dimension == 0);
+			FirstTouch(*MyData);
+			assert(MyData->size() > 0 || dimension == 0);
 			// Such that a matrix of dimension zero can be used as a Scalar.
 			// Not sure yet what is the best idea to treat the degenerate cases.
 			if (Dimension == 0){
-				MyData = MyContainerType<T>(1);
-			};
-			// Initializing the strides
-			for (std::size_t i = 1; i < SizesAlongEachDimension.size(); ++i){
-				for (std::size_t j = 0; j < i; ++j){
-					Strides[j] *= SizesAlongEachDimension[i];
-				};
+				MyData = std::make_shared<MyContainerType<T> >(1);
+				FirstTouch(*MyData);
 			};
+			InitializeStrides();
 		};
 
 		// Move constructor.
-		DenseMatrixContainer(DenseMatrixContainer&& other){
-			MyData.swap(other.MyData);
-			Transposed = other.Transposed;
-			MyDimension = other.MyDimension;
-			SizesAlongEachDimension.swap(other.SizesAlongEachDimension);
-			Strides.swap(other.Strides);
+		// Every member is initialized from other, which is left empty.
+		DenseMatrixContainer(DenseMatrixContainer&& other)
+			: MyData(std::move(other.MyData)), Transposed(other.Transposed), MyDimension(other.MyDimension),
+			  SizesAlongEachDimension(std::move(other.SizesAlongEachDimension)), Strides(std::move(other.Strides)){
 		};
 
-		// Copy constructor
+		// Copy constructor. O(1), the buffer is shared until one of the two writes.
 		DenseMatrixContainer(const DenseMatrixContainer& other) 
 			: MyData(other.MyData),	Transposed(other.Transposed), MyDimension(other.MyDimension), 
 			  SizesAlongEachDimension(other.SizesAlongEachDimension), Strides(other.Strides){
 		};
 
+		// Copy assignment. O(1) like the copy constructor, see assign() to copy the elements into the own buffer.
+		DenseMatrixContainer& operator=(const DenseMatrixContainer& other){
+			MyData = other.MyData;
+			Transposed = other.Transposed;
+			MyDimension = other.MyDimension;
+			SizesAlongEachDimension = other.SizesAlongEachDimension;
+			Strides = other.Strides;
+			return *this;
+		};
+
+		// Move assignment.
+		DenseMatrixContainer& operator=(DenseMatrixContainer&& other){
+			swap(other);
+			return *this;
+		};
+
+		// Copy of the elements of other into the own buffer, which is reused if it is not shared and has the size
+		// of other's, so copying repeatedly between containers of the same sizes does not allocate.
+		void assign(const DenseMatrixContainer& other){
+			if (this == &other){
+				return;
+			};
+			if (MyData.use_count() != 1 || MyData->size() != other.MyData->size()){
+				MyData = Duplicate(*other.MyData);
+			}
+			else{
+				std::atomic_thread_fence(std::memory_order_acquire);
+				std::copy(other.MyData->begin(), other.MyData->end(), MyData->begin());
+			};
+			Transposed = other.Transposed;
+			MyDimension = other.MyDimension;
+			SizesAlongEachDimension = other.SizesAlongEachDimension;
+			Strides = other.Strides;
+		};
+
+		// Snapshot of the current elements: an O(1) copy that later writes to 'this' don't change.
+		// E.g. a writer publishing new versions of a matrix while readers keep working on the old ones.
+		DenseMatrixContainer snapshot() const {
+			return *this;
+		};
+
+		// Whether the buffer is shared with other containers (copies or snapshots).
+		bool shared() const {
+			return MyData.use_count() > 1;
+		};
+
+		// Gives the container a buffer of its own now, rather than at its first write.
+		// Writers that hand out raw pointers (data(), views) call it first, and so do the kernels writing from
+		// several threads, before they start: the workers then write through data(), never through the element accesses.
+		void detach(){
+			Own();
+		};
+
 		// Swap.
 		void swap(DenseMatrixContainer& other){
 			MyData.swap(other.MyData);
-			Transposed = other.Transposed;
-			MyDimension = other.MyDimension;
+			std::swap(Transposed, other.Transposed);
+			std::swap(MyDimension, other.MyDimension);
 			SizesAlongEachDimension.swap(other.SizesAlongEachDimension);
 			Strides.swap(other.Strides);
 		};
 
+		// Changes the sizes along each dimension. The elements are left unspecified.
+		// Only allocates when the number of elements grows beyond what is already held, or the buffer is shared.
+		void resize(const std::vector<std::size_t>& sizes){
+			assert(sizes.size() == MyDimension);
+			std::size_t temp{ 1 };
+			for (auto i : sizes){
+				temp *= i;
+			};
+			// A moved-from container has no buffer, a shared one keeps its elements for the other holders.
+			if (!MyData || MyData.use_count() > 1){
+				MyData = std::make_shared<MyContainerType<T> >(temp);
+			}
+			else{
+				MyData->resize(temp);
+			};
+			SizesAlongEachDimension = sizes;
+			Strides.resize(sizes.size());
+			Transposed = false;
+			InitializeStrides();
+		};
+
 		// Size is size of represented data.
+		// Zero for a moved-from container.
 		std::size_t size() const {
-			return MyData.size();
+			return MyData ? MyData->size() : 0;
 		};
 
 		//Getter for all SizesAlongEachDimension
-		const std::vector<std::size_t> getSizesAlongEachDimension() const {
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
 			return SizesAlongEachDimension;
 		};
 
@@ -95,6 +411,11 @@ namespace FususMatrix{
 			return SizesAlongEachDimension[dim];
 		};
 
+		// Getter for the strides, in elements, per (logical) coordinate.
+		std::vector<std::size_t> const& getStrides() const {
+			return Strides;
+		};
+
 		// Number of rows.
 		std::size_t rows() const {
 			if (Dimension > 0){
@@ -124,65 +445,104 @@ namespace FususMatrix{
 		// Accesses the elements according to the linear order in the 1-D vector container.
 		T operator[](std::size_t index) const {
 			assert(index < size());
-			return MyData[index];
+			return (*MyData)[index];
 		};
 		T& operator[](std::size_t index) {
 			assert(index < size());
-			return MyData[index];
+			return Own()[index];
+		};
+
+		// The elements, in the linear order of operator[]. Null for Matrix<bool>, which isn't stored contiguously.
+		// The non-constant pointer is to a buffer of the container's own (see detach()).
+		T* data(){
+			return DataOf(Own());
+		};
+		T const* data() const {
+			return DataOf(*MyData);
+		};
+
+		// Layout of the elements in the 1-D vector container.
+		// Dimensions of size one don't count, so e.g. a weakly transposed vector is still row-major.
+		Layout layout() const {
+			return LayoutOf(SizesAlongEachDimension, Strides);
+		};
+
+		// Element in row i and column j of a 2-D container, honouring the weak transposition.
+		// Cheaper than operator(), used by the tiled evaluation of expressions.
+		T at(std::size_t i, std::size_t j) const {
+			return (*MyData)[i * Strides[0] + j * Strides[1]];
+		};
+		T& at(std::size_t i, std::size_t j){
+			return Own()[i * Strides[0] + j * Strides[1]];
 		};
 
 		// Unitary operators.
 		// Additive inverse of each element.
 		DenseMatrixContainer& operator-(){
-			for (std::size_t i = 0; i < MyData.size(); ++i){
-				MyData[i] = -MyData[i];
+			MyContainerType<T>& data{ Own() };
+			for (std::size_t i = 0; i < data.size(); ++i){
+				data[i] = -data[i];
 			};
 			return *this;
 		};
 		// Multiplicative inverse of each element.
 		DenseMatrixContainer& reciprocals(){
-			for (std::size_t i = 0; i < MyData.size(); ++i){
-				MyData[i] = 1 / MyData[i];
+			MyContainerType<T>& data{ Own() };
+			for (std::size_t i = 0; i < data.size(); ++i){
+				data[i] = 1 / data[i];
 			};
 			return *this;
 		};
 
 		// Compound assignment operators.
+		// They combine the elements in storage order, so both containers must have the same layout.
 		DenseMatrixContainer& operator+=(const DenseMatrixContainer& X){
-			for (std::size_t i = 0; i < MyData.size(); ++i){
-				MyData[i] += X.MyData[i];
+			MyContainerType<T> const& x{ *X.MyData };
+			MyContainerType<T>& data{ Own() };
+			for (std::size_t i = 0; i < data.size(); ++i){
+				data[i] += x[i];
 			};
 			return *this;
 		};
 		DenseMatrixContainer& operator-=(const DenseMatrixContainer& X){
-			for (std::size_t i = 0; i < MyData.size(); ++i){
-				MyData[i] -= X.MyData[i];
+			MyContainerType<T> const& x{ *X.MyData };
+			MyContainerType<T>& data{ Own() };
+			for (std::size_t i = 0; i < data.size(); ++i){
+				data[i] -= x[i];
 			};
 			return *this;
 		};
 		DenseMatrixContainer& operator*=(const DenseMatrixContainer& X){
-			for (std::size_t i = 0; i < MyData.size(); ++i){
-				MyData[i] *= X.MyData[i];
+			MyContainerType<T> const& x{ *X.MyData };
+			MyContainerType<T>& data{ Own() };
+			for (std::size_t i = 0; i < data.size(); ++i){
+				data[i] *= x[i];
 			};
 			return *this;
 		};
 		DenseMatrixContainer& operator*=(const T& s){
-			for (std::size_t i = 0; i < MyData.size(); ++i){
-				MyData[i] += s;
+			MyContainerType<T>& data{ Own() };
+			for (std::size_t i = 0; i < data.size(); ++i){
+				data[i] *= s;
 			};
 			return *this;
 		};
 		DenseMatrixContainer& operator/=(const DenseMatrixContainer& X){
-			for (std::size_t i = 0; i < MyData.size(); ++i){
-				MyData[i] /= X.MyData[i];
+			MyContainerType<T> const& x{ *X.MyData };
+			MyContainerType<T>& data{ Own() };
+			for (std::size_t i = 0; i < data.size(); ++i){
+				data[i] /= x[i];
 			};
 			return *this;
 		};
 
 		// Weak transpose.
+		// Only the sizes and strides of the two coordinates get exchanged, the data stays in place.
 		void transpose(){
 			assert(Dimension == 2);
 			Transposed = !Transposed;
+			std::swap(SizesAlongEachDimension[0], SizesAlongEachDimension[1]);
+			std::swap(Strides[0], Strides[1]);
 		};
 
 		// Transposing a contiguous minor of a source matrix to the minor of target matrix.
@@ -206,12 +566,12 @@ namespace FususMatrix{
 			else{
 				// The matrix is divided along its largest dimension and the pieces get recursively transposed
 				if (width >= hight){
-					std::size_t halfwidth{ width / 2 };
+					std::size_t halfwidth{ firstrow + width / 2 - 1 };
 					transposeRecursion(source, target, firstrow, halfwidth, firstcolumn, lastcolumn);
 					transposeRecursion(source, target, halfwidth + 1, lastrow, firstcolumn, lastcolumn);
 				}
 				else{
-					std::size_t halfhight{ hight / 2 };
+					std::size_t halfhight{ firstcolumn + hight / 2 - 1 };
 					transposeRecursion(source, target, firstrow, lastrow, firstcolumn, halfhight);
 					transposeRecursion(source, target, firstrow, lastrow, halfhight + 1, lastcolumn);
 				};
@@ -224,106 +584,180 @@ namespace FususMatrix{
 		// Strong transposition. It actually changes the position of the entries of the matrix.
 		void strongTranspose(){
 			assert(Dimension == 2);
-			DenseMatrixContainer<T, 2> temp(Dimension, SizesAlongEachDimension[0], SizesAlongEachDimension[1]);
+			DenseMatrixContainer<T, 2> temp(Dimension, SizesAlongEachDimension[1], SizesAlongEachDimension[0]);
 			transposeRecursion(*this, temp, 0, SizesAlongEachDimension[0] - 1, 0, SizesAlongEachDimension[1] - 1);
-			temp.Transposed = false;
 			swap(temp);
 		};
 
+		// Permutation of the axes: axis k of the result is axis axes[k] of 'this'.
+		// Like the weak transpose, only the sizes and strides change when the result is still in a layout the
+		// expressions handle (any for 2-D, row-major otherwise, e.g. when only axes of size one move).
+		// Otherwise the elements are rearranged in row-major order with a cache-blocked N-D transpose.
+		void permute(std::vector<std::size_t> const& axes){
+			assert(axes.size() == Dimension);
+			std::vector<std::size_t> sizes(Dimension);
+			std::vector<std::size_t> strides(Dimension);
+			std::vector<bool> seen(Dimension, false);
+			for (std::size_t k = 0; k < Dimension; ++k){
+				assert(axes[k] < Dimension && !seen[axes[k]]);
+				seen[axes[k]] = true;
+				sizes[k] = SizesAlongEachDimension[axes[k]];
+				strides[k] = Strides[axes[k]];
+			};
+			if (Dimension == 2 || LayoutOf(sizes, strides) == Layout::RowMajor){
+				if (Dimension == 2 && axes[0] == 1){
+					Transposed = !Transposed;
+				};
+				SizesAlongEachDimension = sizes;
+				Strides = strides;
+				return;
+			};
+			Rearrange(sizes, strides);
+		};
+
+		// The same elements with other sizes (the same number of them), in row-major order.
+		// Shares the buffer (copy-on-write) when the elements are already in row-major order, otherwise they are
+		// first rearranged, e.g. for a weakly transposed matrix.
+		template<std::size_t Dimension2>
+		DenseMatrixContainer<T, Dimension2> reshaped(std::vector<std::size_t> const& sizes) const {
+			assert(sizes.size() == Dimension2);
+			assert(std::accumulate(sizes.begin(), sizes.end(), std::size_t{ 1 }, std::multiplies<std::size_t>()) == size());
+			if (layout() == Layout::RowMajor){
+				return DenseMatrixContainer<T, Dimension2>(MyData, sizes);
+			};
+			DenseMatrixContainer copy(*this);
+			copy.Rearrange(SizesAlongEachDimension, Strides);
+			return DenseMatrixContainer<T, Dimension2>(copy.MyData, sizes);
+		};
+
 		// Accessing elements  
 		// This computes the position of the components of the matrix within the 1-D vector container.
+		// The coordinates are kept on the stack, so that element access never allocates.
 		template<typename... Coordinates>
 		inline std::size_t ComputePosition(Coordinates... coordinates) const {
-			std::vector<std::size_t> coord({ static_cast<std::size_t>(coordinates)... });
-			return std::inner_product(coord.begin(), coord.end(), Strides.begin(), 0);
+			std::array<std::size_t, sizeof...(Coordinates)> coord{ { static_cast<std::size_t>(coordinates)... } };
+			return std::inner_product(coord.begin(), coord.end(), Strides.begin(), std::size_t{ 0 });
 		};
 		// Constant access.
 		template<typename FirstCoordinate, typename... RemainingCoordinates>
 		const T& operator()(FirstCoordinate i, RemainingCoordinates... coordinates) const {
-			if (Transposed){
-				return MyData[ComputePosition(coordinates..., i)];
-			}
-			else{
-				return MyData[ComputePosition(i, coordinates...)];
-			};
+			return (*MyData)[ComputePosition(i, coordinates...)];
 		};
 		// Non-constant access.
 		template<typename FirstCoordinate, typename... RemainingCoordinates>
 		T& operator()(FirstCoordinate i, RemainingCoordinates... coordinates){
-			if (Transposed){
-				return MyData[ComputePosition(coordinates..., i)];
-			}
-			else{
-				return MyData[ComputePosition(i, coordinates...)];
-			};
+			return Own()[ComputePosition(i, coordinates...)];
 		};
 
+		// Product of A and B written into 'this', which must have the right sizes and be neither A nor B.
+		// Uses the cache-oblivious (optionally Strassen-Winograd) multiplication of RecursiveMultiply.h,
+		// through views honouring the strides, so weakly transposed operands are read in place.
+		// Over another semiring (Semiring.h) the + and * are those of S, with the same blocking and threading
+		// (Strassen-Winograd needs subtraction, so only the ordinary product uses it).
+		// Products with a vector, A x or x^T B, use the matrix-vector kernels of MatrixVectorProducts.h.
+		template<typename S = PlusTimes<T> >
 		void Multiply(DenseMatrixContainer<T> const& A, DenseMatrixContainer<T> const& B){
-			T ComponentOfProduct{ 0 };
+			assert(this != &A && this != &B);
+			assert(A.columns() == B.rows() && rows() == A.rows() && columns() == B.columns());
+			detach();
+			if (Contiguous(*MyData)){
+				if (std::is_same<S, PlusTimes<T> >::value && (B.columns() == 1 || A.rows() == 1)){
+					// The elements of vectors are contiguous in any layout.
+					if (B.columns() == 1){
+						MultiplyVector(A.view(), B.data(), data());
+					}
+					else{
+						MultiplyVector(B.view().transposed(), A.data(), data());
+					};
+					return;
+				};
+				if (std::is_same<S, PlusTimes<T> >::value){
+					MultiplyBlocks(A.view(), B.view(), view());
+				}
+				else{
+					RecursiveMultiply<T, S>(A.view(), B.view(), view());
+				};
+				return;
+			};
 			for (std::size_t i = 0; i < A.rows(); ++i){
 				for (std::size_t j = 0; j < B.columns(); ++j){
+					T ComponentOfProduct{ S::Zero() };
 					for (std::size_t k = 0; k < A.columns(); ++k){
-						ComponentOfProduct += A(i, k) * B(k, j);
+						ComponentOfProduct = S::Add(ComponentOfProduct, S::Multiply(A(i, k), B(k, j)));
 					};
 					(*this)(i, j) = ComponentOfProduct;
-					ComponentOfProduct = 0;
 				};
 			};
 		};
 
 		// Checking if 'this' is a lower triangular matrix (container).
-		bool IsLowerTriangular(){
+		// Rows are scanned without branches, so that the scan vectorizes, and left at the first non-zero found.
+		bool IsLowerTriangular() const {
 			assert(Dimension == 2);
 			for (std::size_t i = 0; i < SizesAlongEachDimension[0]; ++i){
-				for (std::size_t j = i + 1; j<SizesAlongEachDimension[1]; ++j){
-					if (this->operator()(i, j) != 0){
-						return false;
-					};
+				bool NonZero{ false };
+				for (std::size_t j = i + 1; j < SizesAlongEachDimension[1]; ++j){
+					NonZero |= at(i, j) != T{ 0 };
+				};
+				if (NonZero){
+					return false;
 				};
 			};
 			return true;
 		};
 
 		// Checking if 'this' is an upper triangular matrix (container).
-		bool IsUpperTriangular(){
+		bool IsUpperTriangular() const {
 			assert(Dimension == 2);
 			for (std::size_t i = 1; i < SizesAlongEachDimension[0]; ++i){
-				for (std::size_t j = 0; j < i; ++j){
-					if (this->operator()(i, j) != 0){
-						return false;
-					};
+				bool NonZero{ false };
+				for (std::size_t j = 0; j < i && j < SizesAlongEachDimension[1]; ++j){
+					NonZero |= at(i, j) != T{ 0 };
+				};
+				if (NonZero){
+					return false;
 				};
 			};
 			return true;
 		};
 
-		DenseMatrixContainer span(const DenseMatrixContainer& b){
+		// A += alpha x y^T (BLAS GER), for vectors x and y with as many elements as rows and columns.
+		void RankOneUpdate(T alpha, DenseMatrixContainer<T> const& x, DenseMatrixContainer<T> const& y){
+			assert(Dimension == 2 && x.size() == rows() && y.size() == columns());
+			detach();
+			FususMatrix::RankOneUpdate(view(), alpha, x.data(), y.data());
+		};
+
+		// y = the lower or upper triangle of 'this' times x (BLAS TRMV). y is resized only if needed.
+		void TriangularMultiply(Triangle part, DenseMatrixContainer const& x, DenseMatrixContainer& y) const {
+			assert(rows() == columns() && x.size() == columns());
+			y.assign(x);
+			TriangularMultiplyVector(view(), part, y.data());
+		};
+
+		// Solution of the system 'this' * y = b, written into y, for triangular 'this' (BLAS TRSV).
+		// y is resized only if it doesn't have the sizes of b, so solving repeatedly into the same y doesn't allocate.
+		void span(const DenseMatrixContainer& b, DenseMatrixContainer& y) const {
 			assert(b.size() == SizesAlongEachDimension[1]);
 			bool WeCanSolveIt{false};
-			DenseMatrixContainer y(b);
+			y.assign(b);
 			if (IsLowerTriangular()){
-				for (std::size_t i = 0; i < y.size(); ++i){
-					for (std::size_t j = 0; j < i; ++j)
-					{
-						y[i] -= (*this)(i, j) * y[j];
-					}
-					y[i] /= (*this)(i, i);
-				};
-				return y;
+				TriangularSolveVector(view(), Triangle::Lower, y.data());
+				return;
 			};
 			if (IsUpperTriangular()){
-				for (std::size_t i = y.size() - 1; i > -1 ; --i){
-					for (std::size_t j = y.size(); j > i; --j)
-					{
-						y[i] -= (*this)(i, j) * y[j];
-					}
-					y[i] /= (*this)(i, i);
-				};
-				return y;
+				TriangularSolveVector(view(), Triangle::Upper, y.data());
+				return;
 			};
 			assert(WeCanSolveIt);
 		};
 
+		DenseMatrixContainer span(const DenseMatrixContainer& b) const {
+			DenseMatrixContainer y(b);
+			span(b, y);
+			return y;
+		};
+
 		//
 	};// END DenseMatrixContainer class
 
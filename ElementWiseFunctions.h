@@ -0,0 +1,207 @@
+#ifndef _FususElementWiseFunctions_
+#define _FususElementWiseFunctions_
+
+#include <cmath>
+
+#include "VectorizedMath.h"
+
+namespace FususMatrix{
+
+	// Function objects used by the element-wise nodes.
+	// For double (and float, computed in double) the transcendental ones use the branch-free
+	// polynomials of VectorizedMath.h. Other types fall back to the standard library.
+	struct ExpFunction{
+		double operator()(double x) const { return ExpPolynomial(x); };
+		float operator()(float x) const { return static_cast<float>(ExpPolynomial(x)); };
+		template<typename T>
+		T operator()(T x) const { return static_cast<T>(std::exp(x)); };
+	};
+
+	struct LogFunction{
+		double operator()(double x) const { return LogPolynomial(x); };
+		float operator()(float x) const { return static_cast<float>(LogPolynomial(x)); };
+		template<typename T>
+		T operator()(T x) const { return static_cast<T>(std::log(x)); };
+	};
+
+	struct TanhFunction{
+		double operator()(double x) const { return TanhPolynomial(x); };
+		float operator()(float x) const { return static_cast<float>(TanhPolynomial(x)); };
+		template<typename T>
+		T operator()(T x) const { return static_cast<T>(std::tanh(x)); };
+	};
+
+	// Vectorizes as a single instruction when errno is not required (-fno-math-errno).
+	struct SqrtFunction{
+		template<typename T>
+		T operator()(T x) const { return static_cast<T>(std::sqrt(x)); };
+	};
+
+	struct AbsFunction{
+		template<typename T>
+		T operator()(T x) const { return x < T{ 0 } ? -x : x; };
+	};
+
+	struct PowFunction{
+		template<typename T>
+		T operator()(T x, T y) const { return static_cast<T>(std::pow(x, y)); };
+	};
+
+	struct MinFunction{
+		template<typename T>
+		T operator()(T x, T y) const { return y < x ? y : x; };
+	};
+
+	struct MaxFunction{
+		template<typename T>
+		T operator()(T x, T y) const { return x < y ? y : x; };
+	};
+
+	// Stores the bounds of the interval.
+	template<typename T>
+	struct ClampFunction{
+		T lower;
+		T upper;
+		T operator()(T x) const {
+			T y{ x < lower ? lower : x };
+			return upper < y ? upper : y;
+		};
+	};
+
+	// Element-wise functions.
+	// Each returns a Matrix which container is a UnaryFunction, BinaryFunction, Selection or Map object, an expression.
+	// They are evaluated, fused with the rest of the expression, when it is assigned.
+
+	// e^x of each element.
+	template<typename T, std::size_t Dimension = 2, typename R>
+	inline Matrix<T, Dimension, UnaryFunction<T, ExpFunction, R> >
+		exp(Matrix<T, Dimension, R> const& a){
+		return Matrix<T, Dimension, UnaryFunction<T, ExpFunction, R> >(UnaryFunction<T, ExpFunction, R>(a.rep(), ExpFunction()));
+	};
+
+	// Natural logarithm of each element.
+	template<typename T, std::size_t Dimension = 2, typename R>
+	inline Matrix<T, Dimension, UnaryFunction<T, LogFunction, R> >
+		log(Matrix<T, Dimension, R> const& a){
+		return Matrix<T, Dimension, UnaryFunction<T, LogFunction, R> >(UnaryFunction<T, LogFunction, R>(a.rep(), LogFunction()));
+	};
+
+	// Square root of each element.
+	template<typename T, std::size_t Dimension = 2, typename R>
+	inline Matrix<T, Dimension, UnaryFunction<T, SqrtFunction, R> >
+		sqrt(Matrix<T, Dimension, R> const& a){
+		return Matrix<T, Dimension, UnaryFunction<T, SqrtFunction, R> >(UnaryFunction<T, SqrtFunction, R>(a.rep(), SqrtFunction()));
+	};
+
+	// Absolute value of each element.
+	template<typename T, std::size_t Dimension = 2, typename R>
+	inline Matrix<T, Dimension, UnaryFunction<T, AbsFunction, R> >
+		abs(Matrix<T, Dimension, R> const& a){
+		return Matrix<T, Dimension, UnaryFunction<T, AbsFunction, R> >(UnaryFunction<T, AbsFunction, R>(a.rep(), AbsFunction()));
+	};
+
+	// Hyperbolic tangent of each element.
+	template<typename T, std::size_t Dimension = 2, typename R>
+	inline Matrix<T, Dimension, UnaryFunction<T, TanhFunction, R> >
+		tanh(Matrix<T, Dimension, R> const& a){
+		return Matrix<T, Dimension, UnaryFunction<T, TanhFunction, R> >(UnaryFunction<T, TanhFunction, R>(a.rep(), TanhFunction()));
+	};
+
+	// Each element restricted to the interval [lower, upper].
+	template<typename T, std::size_t Dimension = 2, typename R>
+	inline Matrix<T, Dimension, UnaryFunction<T, ClampFunction<T>, R> >
+		clamp(Matrix<T, Dimension, R> const& a, T const& lower, T const& upper){
+		return Matrix<T, Dimension, UnaryFunction<T, ClampFunction<T>, R> >(UnaryFunction<T, ClampFunction<T>, R>(a.rep(), ClampFunction<T>{ lower, upper }));
+	};
+
+	// Elements of a raised to the elements of b.
+	template<typename T, std::size_t Dimension = 2, typename R1, typename R2>
+	inline Matrix<T, Dimension, BinaryFunction<T, PowFunction, R1, R2> >
+		pow(Matrix<T, Dimension, R1> const& a, Matrix<T, Dimension, R2> const& b){
+		return Matrix<T, Dimension, BinaryFunction<T, PowFunction, R1, R2> >(BinaryFunction<T, PowFunction, R1, R2>(a.rep(), b.rep(), PowFunction()));
+	};
+
+	// Elements of a raised to a scalar.
+	template<typename T, std::size_t Dimension = 2, typename R1>
+	inline Matrix<T, Dimension, BinaryFunction<T, PowFunction, R1, Scalar<T> > >
+		pow(Matrix<T, Dimension, R1> const& a, T const& s){
+		return Matrix<T, Dimension, BinaryFunction<T, PowFunction, R1, Scalar<T> > >(BinaryFunction<T, PowFunction, R1, Scalar<T> >(a.rep(), Scalar<T>(s), PowFunction()));
+	};
+
+	// Element-wise minimum of two Matrices.
+	// The overload for equal types is more specialized than std::min, so both can be visible.
+	template<typename T, std::size_t Dimension = 2, typename R1, typename R2>
+	inline Matrix<T, Dimension, BinaryFunction<T, MinFunction, R1, R2> >
+		min(Matrix<T, Dimension, R1> const& a, Matrix<T, Dimension, R2> const& b){
+		return Matrix<T, Dimension, BinaryFunction<T, MinFunction, R1, R2> >(BinaryFunction<T, MinFunction, R1, R2>(a.rep(), b.rep(), MinFunction()));
+	};
+	template<typename T, std::size_t Dimension = 2, typename R>
+	inline Matrix<T, Dimension, BinaryFunction<T, MinFunction, R, R> >
+		min(Matrix<T, Dimension, R> const& a, Matrix<T, Dimension, R> const& b){
+		return Matrix<T, Dimension, BinaryFunction<T, MinFunction, R, R> >(BinaryFunction<T, MinFunction, R, R>(a.rep(), b.rep(), MinFunction()));
+	};
+
+	// Element-wise minimum of a Matrix and a scalar.
+	template<typename T, std::size_t Dimension = 2, typename R1>
+	inline Matrix<T, Dimension, BinaryFunction<T, MinFunction, R1, Scalar<T> > >
+		min(Matrix<T, Dimension, R1> const& a, T const& s){
+		return Matrix<T, Dimension, BinaryFunction<T, MinFunction, R1, Scalar<T> > >(BinaryFunction<T, MinFunction, R1, Scalar<T> >(a.rep(), Scalar<T>(s), MinFunction()));
+	};
+	template<typename T, std::size_t Dimension = 2, typename R2>
+	inline Matrix<T, Dimension, BinaryFunction<T, MinFunction, Scalar<T>, R2> >
+		min(T const& s, Matrix<T, Dimension, R2> const& b){
+		return Matrix<T, Dimension, BinaryFunction<T, MinFunction, Scalar<T>, R2> >(BinaryFunction<T, MinFunction, Scalar<T>, R2>(Scalar<T>(s), b.rep(), MinFunction()));
+	};
+
+	// Element-wise maximum of two Matrices.
+	template<typename T, std::size_t Dimension = 2, typename R1, typename R2>
+	inline Matrix<T, Dimension, BinaryFunction<T, MaxFunction, R1, R2> >
+		max(Matrix<T, Dimension, R1> const& a, Matrix<T, Dimension, R2> const& b){
+		return Matrix<T, Dimension, BinaryFunction<T, MaxFunction, R1, R2> >(BinaryFunction<T, MaxFunction, R1, R2>(a.rep(), b.rep(), MaxFunction()));
+	};
+	template<typename T, std::size_t Dimension = 2, typename R>
+	inline Matrix<T, Dimension, BinaryFunction<T, MaxFunction, R, R> >
+		max(Matrix<T, Dimension, R> const& a, Matrix<T, Dimension, R> const& b){
+		return Matrix<T, Dimension, BinaryFunction<T, MaxFunction, R, R> >(BinaryFunction<T, MaxFunction, R, R>(a.rep(), b.rep(), MaxFunction()));
+	};
+
+	// Element-wise maximum of a Matrix and a scalar.
+	template<typename T, std::size_t Dimension = 2, typename R1>
+	inline Matrix<T, Dimension, BinaryFunction<T, MaxFunction, R1, Scalar<T> > >
+		max(Matrix<T, Dimension, R1> const& a, T const& s){
+		return Matrix<T, Dimension, BinaryFunction<T, MaxFunction, R1, Scalar<T> > >(BinaryFunction<T, MaxFunction, R1, Scalar<T> >(a.rep(), Scalar<T>(s), MaxFunction()));
+	};
+	template<typename T, std::size_t Dimension = 2, typename R2>
+	inline Matrix<T, Dimension, BinaryFunction<T, MaxFunction, Scalar<T>, R2> >
+		max(T const& s, Matrix<T, Dimension, R2> const& b){
+		return Matrix<T, Dimension, BinaryFunction<T, MaxFunction, Scalar<T>, R2> >(BinaryFunction<T, MaxFunction, Scalar<T>, R2>(Scalar<T>(s), b.rep(), MaxFunction()));
+	};
+
+	// Elements of a where mask is true and of b elsewhere.
+	template<typename T, std::size_t Dimension = 2, typename RM, typename R1, typename R2>
+	inline Matrix<T, Dimension, Selection<T, RM, R1, R2> >
+		select(Matrix<bool, Dimension, RM> const& mask, Matrix<T, Dimension, R1> const& a, Matrix<T, Dimension, R2> const& b){
+		return Matrix<T, Dimension, Selection<T, RM, R1, R2> >(Selection<T, RM, R1, R2>(mask.rep(), a.rep(), b.rep()));
+	};
+	template<typename T, std::size_t Dimension = 2, typename RM, typename R1>
+	inline Matrix<T, Dimension, Selection<T, RM, R1, Scalar<T> > >
+		select(Matrix<bool, Dimension, RM> const& mask, Matrix<T, Dimension, R1> const& a, T const& s){
+		return Matrix<T, Dimension, Selection<T, RM, R1, Scalar<T> > >(Selection<T, RM, R1, Scalar<T> >(mask.rep(), a.rep(), Scalar<T>(s)));
+	};
+	template<typename T, std::size_t Dimension = 2, typename RM, typename R2>
+	inline Matrix<T, Dimension, Selection<T, RM, Scalar<T>, R2> >
+		select(Matrix<bool, Dimension, RM> const& mask, T const& s, Matrix<T, Dimension, R2> const& b){
+		return Matrix<T, Dimension, Selection<T, RM, Scalar<T>, R2> >(Selection<T, RM, Scalar<T>, R2>(mask.rep(), Scalar<T>(s), b.rep()));
+	};
+
+	// A user function applied element by element to any number of Matrices of the same sizes.
+	// For example map([](double x, double y){ return x > y ? x - y : 0.0; }, A, B).
+	template<typename Function, typename T, std::size_t Dimension, typename R1, typename... Rs>
+	inline Matrix<T, Dimension, Map<T, Function, R1, Rs...> >
+		map(Function const& function, Matrix<T, Dimension, R1> const& a, Matrix<T, Dimension, Rs> const&... others){
+		return Matrix<T, Dimension, Map<T, Function, R1, Rs...> >(Map<T, Function, R1, Rs...>(function, a.rep(), others.rep()...));
+	};
+
+}// END namespace
+
+#endif
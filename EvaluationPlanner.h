@@ -0,0 +1,688 @@
+#ifndef _FususEvaluationPlanner_
+#define _FususEvaluationPlanner_
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "BufferPool.h"
+#include "DenseMatrixContainer.h"
+#include "ExpressionSimplification.h"
+#include "LazyEvaluationExpressionTemplates.h"
+#include "ThreadPool.h"
+
+namespace FususMatrix{
+
+	// Planning of the evaluation of an expression into a Matrix, done by Matrix::operator=.
+	// Before the element by element loop the tree is looked at as a whole:
+	//  1. With FUSUS_FAST_MATH defined, sums of scaled Matrices where the same Matrix appears several times
+	//     are collapsed, e.g. (K + K) + (K + (K + K)) is evaluated as 5 * K, reading K once per element.
+	//     This may change the results: c1 * A + c2 * A and (c1 + c2) * A round differently, and (A + A) - A
+	//     is NaN where A is infinite or A + A overflows, while 1 * A isn't.
+	//  2. Expensive nodes (functions) used more than once, e.g. e in R = e + e * B with e = exp(A),
+	//     are evaluated once into a pooled temporary, when the cost model says recomputing costs more.
+	//  3. The tree is simplified (ExpressionSimplification.h).
+	// Besides, if an operand shares memory with the destination but is read at other positions (other layout,
+	// or overlapping storage), Matrix::operator= evaluates into a temporary first, so no element is overwritten
+	// before being read. The same Matrix read at the same positions is safe in place, e.g. A = A + B.
+	// Matrix::noalias() skips all this, for expressions known to be free of these cases.
+	// The plan depends on values (which Matrices repeat, which nodes are shared), but the type of the planned
+	// tree depends only on the type of the expression: the choices are kept as values in the nodes
+	// (LinearCombination, SharedExpression). A choice made by calling the next stage with one type or another
+	// would compile the rest of the plan once per alternative, growing exponentially with the expression.
+
+	// Per-element cost of an expression, in units of about one load or one arithmetic operation.
+	// A node that doesn't compute element by element (e.g. a product) should declare the cost of one element.
+	template<typename Expression>
+	struct ExpressionCost : std::integral_constant<std::size_t, 1>{ // Leaves: one load.
+	};
+	template<typename T>
+	struct ExpressionCost<Scalar<T> > : std::integral_constant<std::size_t, 0>{
+	};
+	template<typename T, typename X, typename Y>
+	struct ExpressionCost<Addition<T, X, Y> > : std::integral_constant<std::size_t, 1 + ExpressionCost<X>::value + ExpressionCost<Y>::value>{
+	};
+	template<typename T, typename X, typename Y>
+	struct ExpressionCost<Subtraction<T, X, Y> > : std::integral_constant<std::size_t, 1 + ExpressionCost<X>::value + ExpressionCost<Y>::value>{
+	};
+	template<typename T, typename X, typename Y>
+	struct ExpressionCost<Multiplication<T, X, Y> > : std::integral_constant<std::size_t, 1 + ExpressionCost<X>::value + ExpressionCost<Y>::value>{
+	};
+	template<typename T, typename X, typename Y>
+	struct ExpressionCost<Division<T, X, Y> > : std::integral_constant<std::size_t, 8 + ExpressionCost<X>::value + ExpressionCost<Y>::value>{
+	};
+	template<typename T, typename F, typename X>
+	struct ExpressionCost<UnaryFunction<T, F, X> > : std::integral_constant<std::size_t, 16 + ExpressionCost<X>::value>{
+	};
+	template<typename T, typename F, typename X, typename Y>
+	struct ExpressionCost<BinaryFunction<T, F, X, Y> > : std::integral_constant<std::size_t, 16 + ExpressionCost<X>::value + ExpressionCost<Y>::value>{
+	};
+	template<typename T, typename M, typename X, typename Y>
+	struct ExpressionCost<Selection<T, M, X, Y> > : std::integral_constant<std::size_t, 1 + ExpressionCost<M>::value + ExpressionCost<X>::value + ExpressionCost<Y>::value>{
+	};
+	template<typename... Operands>
+	struct OperandsCost : std::integral_constant<std::size_t, 0>{
+	};
+	template<typename X, typename... Operands>
+	struct OperandsCost<X, Operands...> : std::integral_constant<std::size_t, ExpressionCost<X>::value + OperandsCost<Operands...>::value>{
+	};
+	template<typename T, typename F, typename... Operands>
+	struct ExpressionCost<Map<T, F, Operands...> > : std::integral_constant<std::size_t, 16 + OperandsCost<Operands...>::value>{
+	};
+
+	// Cost of a temporary per element: writing it, reading it back, and the extra pass over memory.
+	std::size_t const MaterializationCost{ 8 };
+
+	// Nodes that may be evaluated once into a temporary when they are used more than once:
+	// those whose own operation costs more than the temporary (arithmetic is cheaper to recompute).
+	template<typename Expression>
+	struct Materializable : std::false_type{
+	};
+	template<typename T, typename F, typename X>
+	struct Materializable<UnaryFunction<T, F, X> > : std::integral_constant<bool, (ExpressionCost<UnaryFunction<T, F, X> >::value > MaterializationCost)>{
+	};
+	template<typename T, typename F, typename X, typename Y>
+	struct Materializable<BinaryFunction<T, F, X, Y> > : std::integral_constant<bool, (ExpressionCost<BinaryFunction<T, F, X, Y> >::value > MaterializationCost)>{
+	};
+	template<typename T, typename F, typename... Operands>
+	struct Materializable<Map<T, F, Operands...> > : std::integral_constant<bool, (ExpressionCost<Map<T, F, Operands...> >::value > MaterializationCost)>{
+	};
+
+	// Whether a tree has materializable nodes below its root, through the nodes that can be rebuilt.
+	template<typename Expression>
+	struct HasMaterializable : std::false_type{
+	};
+	template<typename X, typename Y>
+	struct EitherMaterializable : std::integral_constant<bool, Materializable<X>::value || HasMaterializable<X>::value
+		|| Materializable<Y>::value || HasMaterializable<Y>::value>{
+	};
+	template<typename T, typename X, typename Y>
+	struct HasMaterializable<Addition<T, X, Y> > : EitherMaterializable<X, Y>{
+	};
+	template<typename T, typename X, typename Y>
+	struct HasMaterializable<Subtraction<T, X, Y> > : EitherMaterializable<X, Y>{
+	};
+	template<typename T, typename X, typename Y>
+	struct HasMaterializable<Multiplication<T, X, Y> > : EitherMaterializable<X, Y>{
+	};
+	template<typename T, typename X, typename Y>
+	struct HasMaterializable<Division<T, X, Y> > : EitherMaterializable<X, Y>{
+	};
+	template<typename T, typename F, typename X>
+	struct HasMaterializable<UnaryFunction<T, F, X> > : EitherMaterializable<X, Scalar<T> >{
+	};
+	template<typename T, typename F, typename X, typename Y>
+	struct HasMaterializable<BinaryFunction<T, F, X, Y> > : EitherMaterializable<X, Y>{
+	};
+
+	// Calls f on each operand of a node. Leaves have none.
+	template<typename Expression, typename F>
+	void ForEachOperand(Expression const&, F const&){
+	};
+	template<typename T, typename X, typename Y, typename F>
+	void ForEachOperand(Addition<T, X, Y> const& e, F const& f){
+		f(e.left());
+		f(e.right());
+	};
+	template<typename T, typename X, typename Y, typename F>
+	void ForEachOperand(Subtraction<T, X, Y> const& e, F const& f){
+		f(e.left());
+		f(e.right());
+	};
+	template<typename T, typename X, typename Y, typename F>
+	void ForEachOperand(Multiplication<T, X, Y> const& e, F const& f){
+		f(e.left());
+		f(e.right());
+	};
+	template<typename T, typename X, typename Y, typename F>
+	void ForEachOperand(Division<T, X, Y> const& e, F const& f){
+		f(e.left());
+		f(e.right());
+	};
+	template<typename T, typename X, typename Y, typename Z, typename F>
+	void ForEachOperand(MultiplyAdd<T, X, Y, Z> const& e, F const& f){
+		f(e.left());
+		f(e.right());
+		f(e.addend());
+	};
+	template<typename T, typename Function, typename X, typename F>
+	void ForEachOperand(UnaryFunction<T, Function, X> const& e, F const& f){
+		f(e.inner());
+	};
+	template<typename T, typename Function, typename X, typename Y, typename F>
+	void ForEachOperand(BinaryFunction<T, Function, X, Y> const& e, F const& f){
+		f(e.left());
+		f(e.right());
+	};
+	template<typename T, typename M, typename X, typename Y, typename F>
+	void ForEachOperand(Selection<T, M, X, Y> const& e, F const& f){
+		f(e.condition());
+		f(e.left());
+		f(e.right());
+	};
+	template<typename Tuple, typename F, std::size_t... I>
+	void ForEachElement(Tuple const& operands, F const& f, std::index_sequence<I...>){
+		int dummy[]{ 0, (f(std::get<I>(operands)), 0)... };
+		(void)dummy;
+	};
+	template<typename T, typename Function, typename... Operands, typename F>
+	void ForEachOperand(Map<T, Function, Operands...> const& e, F const& f){
+		ForEachElement(e.arguments(), f, std::index_sequence_for<Operands...>{});
+	};
+
+	// Calls f on every node of the tree, root first.
+	template<typename Expression, typename F>
+	void ForEachNode(Expression const& e, F const& f){
+		f(e);
+		ForEachOperand(e, [&f](auto const& operand){
+			ForEachNode(operand, f);
+		});
+	};
+
+	//
+	//                      The MaterializedExpression Class.
+	// An expression evaluated into a buffer of BufferPool<T>::Global(), given back when destroyed.
+	// Used as a leaf of the planned tree. 2-D expressions are stored with the requested layout
+	// (row or column-major), others in the storage order of their operands.
+	// Constructed with evaluate false it is empty, and takes no buffer.
+	template<typename T>
+	class MaterializedExpression{
+	private:
+		ScratchBuffer<T> Buffer;
+		std::vector<std::size_t> Sizes;
+		std::size_t Elements;
+		Layout MyLayout;
+		std::size_t RowStride;
+		std::size_t ColumnStride;
+
+		template<typename Expression>
+		void FillRange(Expression const& e, std::size_t first, std::size_t last){
+			T* data{ Buffer.data() };
+			for (std::size_t index = first; index < last; ++index){
+				data[index] = e[index];
+			};
+		};
+	public:
+		template<typename Expression>
+		MaterializedExpression(Expression const& e, Layout layout, bool evaluate = true)
+			: Buffer(evaluate ? BufferPool<T>::Global().Acquire(e.size()) : ScratchBuffer<T>()), Sizes(), Elements(0),
+			MyLayout(layout == Layout::ColumnMajor ? Layout::ColumnMajor : Layout::RowMajor), RowStride(0), ColumnStride(0){
+			if (!evaluate){
+				return;
+			};
+			Sizes = e.getSizesAlongEachDimension();
+			Elements = e.size();
+			Layout const source{ e.layout() };
+			if (Sizes.size() == 2){
+				RowStride = MyLayout == Layout::RowMajor ? Sizes[1] : 1;
+				ColumnStride = MyLayout == Layout::RowMajor ? 1 : Sizes[0];
+			}
+			else{
+				MyLayout = source;
+			};
+			if (Sizes.size() != 2 || source == Layout::Any || source == MyLayout){
+				ThreadPool& pool{ ThreadPool::Global() };
+				if (Elements >= ParallelElementThreshold && pool.size() > 1){
+					pool.ParallelForStatic(0, Elements, [this, &e](std::size_t first, std::size_t last){
+						FillRange(e, first, last);
+					});
+				}
+				else{
+					FillRange(e, 0, Elements);
+				};
+				return;
+			};
+			// Different layouts: square tiles, as in Matrix::Evaluate.
+			std::size_t const tile{ TileSize<T>() };
+			T* data{ Buffer.data() };
+			for (std::size_t ii = 0; ii < Sizes[0]; ii += tile){
+				std::size_t const iend{ ii + tile < Sizes[0] ? ii + tile : Sizes[0] };
+				for (std::size_t jj = 0; jj < Sizes[1]; jj += tile){
+					std::size_t const jend{ jj + tile < Sizes[1] ? jj + tile : Sizes[1] };
+					for (std::size_t i = ii; i < iend; ++i){
+						for (std::size_t j = jj; j < jend; ++j){
+							data[i * RowStride + j * ColumnStride] = e.at(i, j);
+						};
+					};
+				};
+			};
+		};
+
+		T operator[](std::size_t index) const {
+			return Buffer.data()[index];
+		};
+		T at(std::size_t i, std::size_t j) const {
+			return Buffer.data()[i * RowStride + j * ColumnStride];
+		};
+
+		Layout layout() const {
+			return MyLayout;
+		};
+		std::size_t size() const {
+			return Elements;
+		};
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			return Sizes;
+		};
+	};// END MaterializedExpression class
+
+	// 1. Collapse of repeated Matrices in sums of scaled Matrices, with FUSUS_FAST_MATH defined.
+
+	// Whether the tree is a sum of scaled dense Matrices and scalars (not of Matrix<bool>, which has no data()).
+	template<typename Expression>
+	struct IsLinearCombination : std::false_type{
+	};
+	template<typename T, std::size_t Dimension>
+	struct IsLinearCombination<DenseMatrixContainer<T, Dimension> > : std::integral_constant<bool, !std::is_same<T, bool>::value>{
+	};
+	template<typename T>
+	struct IsLinearCombination<Scalar<T> > : std::true_type{
+	};
+	template<typename T, typename X, typename Y>
+	struct IsLinearCombination<Addition<T, X, Y> > : std::integral_constant<bool, IsLinearCombination<X>::value && IsLinearCombination<Y>::value>{
+	};
+	template<typename T, typename X, typename Y>
+	struct IsLinearCombination<Subtraction<T, X, Y> > : std::integral_constant<bool, IsLinearCombination<X>::value && IsLinearCombination<Y>::value>{
+	};
+	template<typename T, typename X>
+	struct IsLinearCombination<Multiplication<T, Scalar<T>, X> > : IsLinearCombination<X>{
+	};
+	template<typename T, typename X>
+	struct IsLinearCombination<Multiplication<T, X, Scalar<T> > > : IsLinearCombination<X>{
+	};
+	template<typename T>
+	struct IsLinearCombination<Multiplication<T, Scalar<T>, Scalar<T> > > : std::true_type{
+	};
+
+	// Number of Matrices in a linear combination, repeated ones included.
+	template<typename Expression>
+	struct LeafCount : std::integral_constant<std::size_t, 0>{
+	};
+	template<typename T, std::size_t Dimension>
+	struct LeafCount<DenseMatrixContainer<T, Dimension> > : std::integral_constant<std::size_t, 1>{
+	};
+	template<typename T, typename X, typename Y>
+	struct LeafCount<Addition<T, X, Y> > : std::integral_constant<std::size_t, LeafCount<X>::value + LeafCount<Y>::value>{
+	};
+	template<typename T, typename X, typename Y>
+	struct LeafCount<Subtraction<T, X, Y> > : LeafCount<Addition<T, X, Y> >{
+	};
+	template<typename T, typename X, typename Y>
+	struct LeafCount<Multiplication<T, X, Y> > : LeafCount<Addition<T, X, Y> >{
+	};
+
+	//
+	//                      The LinearCombination Class.
+	// c1 * A1 + ... + cn * An + c0, the distinct Matrices of a linear combination of N Matrices with their
+	// coefficients added up. The coefficients and how many Matrices are distinct are values, so any linear
+	// combination of the same type becomes this one type, with or without repeated Matrices.
+	template<typename T, std::size_t Dimension, std::size_t N>
+	class LinearCombination{
+	private:
+		DenseMatrixContainer<T, Dimension> const* Terms[N];
+		T const* Elements[N]; // Their data(), read by operator[].
+		T Coefficients[N];
+		std::size_t Count;
+		T Constant;
+
+		void add(DenseMatrixContainer<T, Dimension> const& m, T const& coefficient){
+			for (std::size_t i = 0; i < Count; ++i){
+				if (Terms[i] == &m){
+					Coefficients[i] += coefficient;
+					return;
+				};
+			};
+			Terms[Count] = &m;
+			Elements[Count] = m.data();
+			Coefficients[Count] = coefficient;
+			++Count;
+		};
+
+		void collect(DenseMatrixContainer<T, Dimension> const& m, T const& scale){
+			add(m, scale);
+		};
+		void collect(Scalar<T> const& s, T const& scale){
+			Constant += scale * s.value();
+		};
+		template<typename X, typename Y>
+		void collect(Addition<T, X, Y> const& e, T const& scale){
+			collect(e.left(), scale);
+			collect(e.right(), scale);
+		};
+		template<typename X, typename Y>
+		void collect(Subtraction<T, X, Y> const& e, T const& scale){
+			collect(e.left(), scale);
+			collect(e.right(), -scale);
+		};
+		template<typename X>
+		void collect(Multiplication<T, Scalar<T>, X> const& e, T const& scale){
+			collect(e.right(), scale * e.left().value());
+		};
+		template<typename X>
+		void collect(Multiplication<T, X, Scalar<T> > const& e, T const& scale){
+			collect(e.left(), scale * e.right().value());
+		};
+		void collect(Multiplication<T, Scalar<T>, Scalar<T> > const& e, T const& scale){
+			Constant += scale * e.left().value() * e.right().value();
+		};
+
+	public:
+		template<typename Expression>
+		explicit LinearCombination(Expression const& e)
+			: Count(0), Constant(0){
+			collect(e, T{ 1 });
+		};
+
+		T operator[](std::size_t index) const {
+			T result{ Constant };
+			for (std::size_t t = 0; t < Count; ++t){
+				result += Coefficients[t] * Elements[t][index];
+			};
+			return result;
+		};
+		T at(std::size_t i, std::size_t j) const {
+			T result{ Constant };
+			for (std::size_t t = 0; t < Count; ++t){
+				result += Coefficients[t] * Terms[t]->at(i, j);
+			};
+			return result;
+		};
+
+		Layout layout() const {
+			Layout result{ Terms[0]->layout() };
+			for (std::size_t t = 1; t < Count; ++t){
+				result = CombineLayouts(result, Terms[t]->layout());
+			};
+			return result;
+		};
+		std::size_t size() const {
+			return Terms[0]->size();
+		};
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			return Terms[0]->getSizesAlongEachDimension();
+		};
+	};// END LinearCombination class
+
+	template<typename Expression, typename K>
+	void CollapseRepeated(Expression const& e, K const& k, std::false_type){
+		k(e);
+	};
+
+	// Dense leaves of a linear combination, to know their type.
+	template<typename Expression>
+	struct LeafOf{
+		typedef void Type;
+	};
+	template<typename T, std::size_t Dimension>
+	struct LeafOf<DenseMatrixContainer<T, Dimension> >{
+		typedef DenseMatrixContainer<T, Dimension> Type;
+	};
+	template<typename T, typename X, typename Y>
+	struct LeafOf<Addition<T, X, Y> >{
+		typedef typename std::conditional<std::is_void<typename LeafOf<X>::Type>::value, typename LeafOf<Y>::Type, typename LeafOf<X>::Type>::type Type;
+	};
+	template<typename T, typename X, typename Y>
+	struct LeafOf<Subtraction<T, X, Y> > : LeafOf<Addition<T, X, Y> >{
+	};
+	template<typename T, typename X, typename Y>
+	struct LeafOf<Multiplication<T, X, Y> > : LeafOf<Addition<T, X, Y> >{
+	};
+
+	// Sums and differences of Matrices become one LinearCombination.
+	template<typename T, std::size_t Dimension, typename Expression, typename K>
+	void CollapseForm(Expression const& e, K const& k, DenseMatrixContainer<T, Dimension> const*){
+		k(LinearCombination<T, Dimension, LeafCount<Expression>::value>(e));
+	};
+	template<typename Expression, typename K>
+	void CollapseForm(Expression const& e, K const& k, void const*){
+		k(e);
+	};
+
+	template<typename Expression, typename K>
+	void CollapseRepeated(Expression const& e, K const& k, std::true_type){
+		CollapseForm(e, k, static_cast<typename LeafOf<Expression>::Type const*>(nullptr));
+	};
+
+	// 2. Evaluation of shared expensive nodes into temporaries.
+
+	// The materializable nodes of a tree and how many times each is used.
+	template<typename T>
+	struct SharedNodes{
+		static std::size_t const Capacity{ 8 };
+		void const* Nodes[Capacity];
+		std::size_t Uses[Capacity];
+		MaterializedExpression<T> const* Values[Capacity];
+		std::size_t Count;
+
+		SharedNodes()
+			: Count(0){
+		};
+
+		void record(void const* node){
+			for (std::size_t i = 0; i < Count; ++i){
+				if (Nodes[i] == node){
+					++Uses[i];
+					return;
+				};
+			};
+			if (Count < Capacity){
+				Nodes[Count] = node;
+				Uses[Count] = 1;
+				Values[Count] = nullptr;
+				++Count;
+			};
+		};
+
+		// Index of a node used more than once, Capacity otherwise.
+		std::size_t find(void const* node) const {
+			for (std::size_t i = 0; i < Count; ++i){
+				if (Nodes[i] == node){
+					return Uses[i] > 1 ? i : Capacity;
+				};
+			};
+			return Capacity;
+		};
+	};
+
+	//
+	//                      The SharedExpression Class.
+	// A materializable node of the planned tree, with its operands substituted. It is read from its temporary
+	// when the node is used more than once, and computed element by element otherwise.
+	template<typename T, typename Expression>
+	class SharedExpression{
+	private:
+		typename Traits<Expression>::ExprRef Node;
+		MaterializedExpression<T> const* Value; // nullptr if not materialized.
+
+	public:
+		SharedExpression(Expression const& e, MaterializedExpression<T> const* value)
+			: Node(e), Value(value){
+		};
+
+		T operator[](std::size_t index) const {
+			return Value != nullptr ? (*Value)[index] : Node[index];
+		};
+		T at(std::size_t i, std::size_t j) const {
+			return Value != nullptr ? Value->at(i, j) : Node.at(i, j);
+		};
+
+		Layout layout() const {
+			return Value != nullptr ? Value->layout() : Node.layout();
+		};
+		std::size_t size() const {
+			return Node.size();
+		};
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			return Node.getSizesAlongEachDimension();
+		};
+	};// END SharedExpression class
+
+	template<typename T, typename Expression, typename K>
+	void Substitute(Expression const& e, SharedNodes<T>& shared, Layout layout, K const& k);
+
+	// Rebuilds a node with its operands substituted.
+	template<typename T, typename Expression, typename K>
+	void RebuildOperands(Expression const& e, SharedNodes<T>&, Layout, K const& k){
+		k(e);
+	};
+	template<typename T, template<typename, typename, typename> class Node, typename X, typename Y, typename K>
+	void RebuildBinary(Node<T, X, Y> const& e, SharedNodes<T>& shared, Layout layout, K const& k){
+		Substitute(e.left(), shared, layout, [&e, &shared, layout, &k](auto const& x){
+			Substitute(e.right(), shared, layout, [&x, &k](auto const& y){
+				using X2 = typename std::decay<decltype(x)>::type;
+				using Y2 = typename std::decay<decltype(y)>::type;
+				k(Node<T, X2, Y2>(x, y));
+			});
+		});
+	};
+	template<typename T, typename X, typename Y, typename K>
+	void RebuildOperands(Addition<T, X, Y> const& e, SharedNodes<T>& shared, Layout layout, K const& k){
+		RebuildBinary(e, shared, layout, k);
+	};
+	template<typename T, typename X, typename Y, typename K>
+	void RebuildOperands(Subtraction<T, X, Y> const& e, SharedNodes<T>& shared, Layout layout, K const& k){
+		RebuildBinary(e, shared, layout, k);
+	};
+	template<typename T, typename X, typename Y, typename K>
+	void RebuildOperands(Multiplication<T, X, Y> const& e, SharedNodes<T>& shared, Layout layout, K const& k){
+		RebuildBinary(e, shared, layout, k);
+	};
+	template<typename T, typename X, typename Y, typename K>
+	void RebuildOperands(Division<T, X, Y> const& e, SharedNodes<T>& shared, Layout layout, K const& k){
+		RebuildBinary(e, shared, layout, k);
+	};
+	template<typename T, typename Function, typename X, typename K>
+	void RebuildOperands(UnaryFunction<T, Function, X> const& e, SharedNodes<T>& shared, Layout layout, K const& k){
+		Substitute(e.inner(), shared, layout, [&e, &k](auto const& x){
+			using X2 = typename std::decay<decltype(x)>::type;
+			k(UnaryFunction<T, Function, X2>(x, e.functionObject()));
+		});
+	};
+	template<typename T, typename Function, typename X, typename Y, typename K>
+	void RebuildOperands(BinaryFunction<T, Function, X, Y> const& e, SharedNodes<T>& shared, Layout layout, K const& k){
+		Substitute(e.left(), shared, layout, [&e, &shared, layout, &k](auto const& x){
+			Substitute(e.right(), shared, layout, [&e, &x, &k](auto const& y){
+				using X2 = typename std::decay<decltype(x)>::type;
+				using Y2 = typename std::decay<decltype(y)>::type;
+				k(BinaryFunction<T, Function, X2, Y2>(x, y, e.functionObject()));
+			});
+		});
+	};
+
+	// A materializable node used more than once is evaluated the first time it is met, and read afterwards.
+	// Being in continuation style, the first use is still alive when the others are met.
+	template<typename T, typename Expression, typename K>
+	void SubstituteNode(Expression const& e, SharedNodes<T>& shared, Layout layout, K const& k, std::true_type){
+		RebuildOperands(e, shared, layout, [&e, &shared, layout, &k](auto const& x){
+			using X = typename std::decay<decltype(x)>::type;
+			std::size_t const slot{ shared.find(&e) };
+			bool const first{ slot != shared.Capacity && shared.Values[slot] == nullptr };
+			MaterializedExpression<T> value(x, layout, first);
+			if (first){
+				shared.Values[slot] = &value;
+			};
+			k(SharedExpression<T, X>(x, slot != shared.Capacity ? shared.Values[slot] : nullptr));
+		});
+	};
+	template<typename T, typename Expression, typename K>
+	void SubstituteNode(Expression const& e, SharedNodes<T>& shared, Layout layout, K const& k, std::false_type){
+		if (HasMaterializable<Expression>::value){
+			RebuildOperands(e, shared, layout, k);
+		}
+		else{
+			k(e);
+		};
+	};
+	template<typename T, typename Expression, typename K>
+	void Substitute(Expression const& e, SharedNodes<T>& shared, Layout layout, K const& k){
+		SubstituteNode(e, shared, layout, k, Materializable<Expression>());
+	};
+
+	template<typename T, typename Expression, typename K>
+	void MaterializeShared(Expression const& e, Layout, K const& k, std::false_type){
+		k(e);
+	};
+	template<typename T, typename Expression, typename K>
+	void MaterializeShared(Expression const& e, Layout layout, K const& k, std::true_type){
+		SharedNodes<T> shared;
+		ForEachNode(e, [&shared](auto const& node){
+			if (Materializable<typename std::decay<decltype(node)>::type>::value){
+				shared.record(&node);
+			};
+		});
+		RebuildOperands(e, shared, layout, k);
+	};
+
+	// Aliasing of the destination.
+
+	// Whether reading the leaf while writing the destination element by element may read overwritten elements.
+	template<typename Leaf, typename Destination>
+	bool Overlaps(Leaf const&, Destination const&){
+		return false;
+	};
+	template<typename T, std::size_t Dimension>
+	bool Overlaps(DenseMatrixContainer<T, Dimension> const& leaf, DenseMatrixContainer<T, Dimension> const& destination){
+		if (&leaf == &destination){
+			return false;
+		};
+		// A destination sharing its buffer (copy-on-write) gets one of its own before the first write.
+		if (destination.shared()){
+			return false;
+		};
+		T const* a{ leaf.data() };
+		T const* b{ destination.data() };
+		if (a == nullptr || b == nullptr || a + leaf.size() <= b || b + destination.size() <= a){
+			return false;
+		};
+		// Same storage read at the same positions.
+		return !(a == b && leaf.layout() == destination.layout() && leaf.layout() != Layout::Strided
+			&& leaf.getSizesAlongEachDimension() == destination.getSizesAlongEachDimension());
+	};
+
+	// Whether some operand of the expression shares memory with the destination, see Overlaps.
+	template<typename Destination, typename Expression>
+	bool SharesMemory(Expression const& e, Destination const& destination){
+		bool overlap{ false };
+		ForEachNode(e, [&overlap, &destination](auto const& node){
+			overlap = overlap || Overlaps(node, destination);
+		});
+		return overlap;
+	};
+
+	// Stages 1 to 3. Each stage is a function object depending only on the element type and the final
+	// continuation k, so that assignments to the same kind of Matrix share the instantiations of the later
+	// stages for the same (e.g. collapsed) trees.
+	template<typename K>
+	struct PlanAfterMaterializing{
+		K const& k;
+
+		template<typename Expression>
+		void operator()(Expression const& e) const {
+			Simplify(e, k);
+		};
+	};
+	template<typename T, typename K>
+	struct PlanAfterCollapsing{
+		Layout layout;
+		K const& k;
+
+		template<typename Expression>
+		void operator()(Expression const& e) const {
+			MaterializeShared<T>(e, layout, PlanAfterMaterializing<K>{ k }, std::integral_constant<bool, HasMaterializable<Expression>::value>());
+		};
+	};
+
+	// k is called with the planned expression. layout is the one of the destination, for the temporaries.
+	template<typename T, typename Expression, typename K>
+	void Plan(Expression const& e, Layout layout, K const& k){
+#ifdef FUSUS_FAST_MATH
+		CollapseRepeated(e, PlanAfterCollapsing<T, K>{ layout, k }, IsLinearCombination<Expression>());
+#else
+		PlanAfterCollapsing<T, K>{ layout, k }(e);
+#endif
+	};
+	//
+}// END namespace FususMatrix
+
+#endif
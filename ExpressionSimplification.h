@@ -0,0 +1,210 @@
+#ifndef _FususExpressionSimplification_
+#define _FususExpressionSimplification_
+
+#include <cmath>
+#include <type_traits>
+
+#include "LazyEvaluationExpressionTemplates.h"
+
+namespace FususMatrix{
+
+	// Algebraic simplification of expressions, done by Matrix::operator= before evaluating them.
+	// The tree is rewritten bottom-up, so that each element costs fewer operations and operand loads:
+	//   (X + a) + b, a + (b + X)...   ->  X + (a + b), the scalars added once.
+	//   a * (b * X), (X * a) * b...   ->  (a * b) * X.
+	//   X * Y + Z, Z + X * Y          ->  one fused multiply-add per element (also a * X + Y).
+	// Adding scalars first and fusing multiply-adds may change the last bits of the results, like reassociation.
+	// X / X and X * 0 are not rewritten: they aren't identities for zeros, infinities and NaNs.
+	//
+	// Simplify(e, k) calls k with the rewritten expression. The new nodes are locals of the calls that build them,
+	// so they are alive while k evaluates them. The rules look only at the types of the nodes, never at values
+	// (a scalar being 1, two operands being the same Matrix): a rule that did would call k with either type,
+	// compiling the rest of the rewrite once per alternative, so the code would grow exponentially with the expression.
+
+	// a * b + c, with a single rounding where the hardware has fused multiply-add.
+	template<typename T>
+	inline T FusedMultiplyAdd(T const& a, T const& b, T const& c){
+		return a * b + c;
+	};
+#ifdef FP_FAST_FMA
+	inline double FusedMultiplyAdd(double const& a, double const& b, double const& c){
+		return std::fma(a, b, c);
+	};
+#endif
+#ifdef FP_FAST_FMAF
+	inline float FusedMultiplyAdd(float const& a, float const& b, float const& c){
+		return std::fma(a, b, c);
+	};
+#endif
+
+	// MultiplyAdd class.
+	// Stores (traited) references to the three operands.
+	// Returns the product of the elements of the first two plus the element of the third if asked for a value.
+	template<typename T, typename Operand1, typename Operand2, typename Operand3>
+	class MultiplyAdd{
+	private:
+		typename Traits<Operand1>::ExprRef operand1;
+		typename Traits<Operand2>::ExprRef operand2;
+		typename Traits<Operand3>::ExprRef operand3;
+
+	public:
+		MultiplyAdd(Operand1 const& a, Operand2 const& b, Operand3 const& c)
+			: operand1(a), operand2(b), operand3(c){
+		};
+
+		Operand1 const& left() const {
+			return operand1;
+		};
+		Operand2 const& right() const {
+			return operand2;
+		};
+		Operand3 const& addend() const {
+			return operand3;
+		};
+
+		T operator[] (std::size_t index) const {
+			return FusedMultiplyAdd<T>(operand1[index], operand2[index], operand3[index]);
+		};
+		T at(std::size_t i, std::size_t j) const {
+			return FusedMultiplyAdd<T>(operand1.at(i, j), operand2.at(i, j), operand3.at(i, j));
+		};
+
+		Layout layout() const {
+			return CombineLayouts(operand1.layout(), CombineLayouts(operand2.layout(), operand3.layout()));
+		};
+		std::size_t size() const {
+			return operand1.size() != 0 ? operand1.size() : operand2.size() != 0 ? operand2.size() : operand3.size();
+		};
+
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			return operand1.size() != 0 ? operand1.getSizesAlongEachDimension()
+				: operand2.size() != 0 ? operand2.getSizesAlongEachDimension() : operand3.getSizesAlongEachDimension();
+		};
+	};
+
+	// Rank of the rewrite rules: among the rules that match, the one with the highest rank is used.
+	template<int N>
+	struct RewriteRank : RewriteRank<N - 1>{
+	};
+	template<>
+	struct RewriteRank<0>{
+	};
+
+	// Rules for x + y, x and y already simplified.
+	template<typename T, typename X, typename Y, typename K>
+	void SimplifyAddition(X const& x, Y const& y, K const& k, RewriteRank<0>){
+		k(Addition<T, X, Y>(x, y));
+	};
+	// X * Y + Z.
+	template<typename T, typename X1, typename X2, typename Y, typename K>
+	void SimplifyAddition(Multiplication<T, X1, X2> const& x, Y const& y, K const& k, RewriteRank<1>){
+		k(MultiplyAdd<T, X1, X2, Y>(x.left(), x.right(), y));
+	};
+	// Z + X * Y.
+	template<typename T, typename X, typename Y1, typename Y2, typename K>
+	void SimplifyAddition(X const& x, Multiplication<T, Y1, Y2> const& y, K const& k, RewriteRank<2>){
+		k(MultiplyAdd<T, Y1, Y2, X>(y.left(), y.right(), x));
+	};
+	// (X + a) + b, (a + X) + b.
+	template<typename T, typename X, typename K>
+	void SimplifyAddition(Addition<T, X, Scalar<T> > const& x, Scalar<T> const& y, K const& k, RewriteRank<3>){
+		SimplifyAddition<T>(x.left(), Scalar<T>(x.right().value() + y.value()), k, RewriteRank<5>());
+	};
+	template<typename T, typename X, typename K>
+	void SimplifyAddition(Addition<T, Scalar<T>, X> const& x, Scalar<T> const& y, K const& k, RewriteRank<3>){
+		SimplifyAddition<T>(Scalar<T>(x.left().value() + y.value()), x.right(), k, RewriteRank<5>());
+	};
+	// a + (X + b), a + (b + X).
+	template<typename T, typename Y, typename K>
+	void SimplifyAddition(Scalar<T> const& x, Addition<T, Y, Scalar<T> > const& y, K const& k, RewriteRank<4>){
+		SimplifyAddition<T>(y.left(), Scalar<T>(x.value() + y.right().value()), k, RewriteRank<5>());
+	};
+	template<typename T, typename Y, typename K>
+	void SimplifyAddition(Scalar<T> const& x, Addition<T, Scalar<T>, Y> const& y, K const& k, RewriteRank<4>){
+		SimplifyAddition<T>(Scalar<T>(x.value() + y.left().value()), y.right(), k, RewriteRank<5>());
+	};
+	// a + b.
+	template<typename T, typename K>
+	void SimplifyAddition(Scalar<T> const& x, Scalar<T> const& y, K const& k, RewriteRank<5>){
+		k(Scalar<T>(x.value() + y.value()));
+	};
+
+	// Rules for x * y, x and y already simplified. Scalar factors are moved to the left.
+	template<typename T, typename X, typename Y, typename K>
+	void SimplifyMultiplication(X const& x, Y const& y, K const& k, RewriteRank<0>){
+		k(Multiplication<T, X, Y>(x, y));
+	};
+	// a * Y, Y * a.
+	template<typename T, typename Y, typename K>
+	void SimplifyMultiplication(Scalar<T> const& x, Y const& y, K const& k, RewriteRank<1>){
+		k(Multiplication<T, Scalar<T>, Y>(x, y));
+	};
+	template<typename T, typename X, typename K>
+	void SimplifyMultiplication(X const& x, Scalar<T> const& y, K const& k, RewriteRank<2>){
+		SimplifyMultiplication<T>(y, x, k, RewriteRank<1>());
+	};
+	// (a * X) * b, a * (b * Y).
+	template<typename T, typename X, typename K>
+	void SimplifyMultiplication(Multiplication<T, Scalar<T>, X> const& x, Scalar<T> const& y, K const& k, RewriteRank<3>){
+		SimplifyMultiplication<T>(Scalar<T>(x.left().value() * y.value()), x.right(), k, RewriteRank<1>());
+	};
+	template<typename T, typename Y, typename K>
+	void SimplifyMultiplication(Scalar<T> const& x, Multiplication<T, Scalar<T>, Y> const& y, K const& k, RewriteRank<4>){
+		SimplifyMultiplication<T>(Scalar<T>(x.value() * y.left().value()), y.right(), k, RewriteRank<1>());
+	};
+	// a * b.
+	template<typename T, typename K>
+	void SimplifyMultiplication(Scalar<T> const& x, Scalar<T> const& y, K const& k, RewriteRank<5>){
+		k(Scalar<T>(x.value() * y.value()));
+	};
+
+	// Leaves, and nodes without rules, are evaluated as they are.
+	template<typename Expression, typename K>
+	void Simplify(Expression const& e, K const& k){
+		k(e);
+	};
+
+	template<typename T, typename Operand1, typename Operand2, typename K>
+	void Simplify(Addition<T, Operand1, Operand2> const& e, K const& k){
+		Simplify(e.left(), [&e, &k](auto const& x){
+			Simplify(e.right(), [&x, &k](auto const& y){
+				SimplifyAddition<T>(x, y, k, RewriteRank<5>());
+			});
+		});
+	};
+
+	template<typename T, typename Operand1, typename Operand2, typename K>
+	void Simplify(Multiplication<T, Operand1, Operand2> const& e, K const& k){
+		Simplify(e.left(), [&e, &k](auto const& x){
+			Simplify(e.right(), [&x, &k](auto const& y){
+				SimplifyMultiplication<T>(x, y, k, RewriteRank<5>());
+			});
+		});
+	};
+
+	// Subtractions and divisions have no rules of their own, but their operands are simplified.
+	template<typename T, typename Operand1, typename Operand2, typename K>
+	void Simplify(Subtraction<T, Operand1, Operand2> const& e, K const& k){
+		Simplify(e.left(), [&e, &k](auto const& x){
+			Simplify(e.right(), [&x, &k](auto const& y){
+				using X = typename std::decay<decltype(x)>::type;
+				using Y = typename std::decay<decltype(y)>::type;
+				k(Subtraction<T, X, Y>(x, y));
+			});
+		});
+	};
+
+	template<typename T, typename Operand1, typename Operand2, typename K>
+	void Simplify(Division<T, Operand1, Operand2> const& e, K const& k){
+		Simplify(e.left(), [&e, &k](auto const& x){
+			Simplify(e.right(), [&x, &k](auto const& y){
+				using X = typename std::decay<decltype(x)>::type;
+				using Y = typename std::decay<decltype(y)>::type;
+				k(Division<T, X, Y>(x, y));
+			});
+		});
+	};
+	//
+}// END namespace FususMatrix
+
+#endif
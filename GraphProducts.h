@@ -0,0 +1,272 @@
+#ifndef _FususGraphProducts_
+#define _FususGraphProducts_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "BufferPool.h"
+#include "Matrix.h"
+#include "RecursiveMultiply.h"
+#include "Semiring.h"
+#include "ThreadPool.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace FususMatrix{
+
+	// Products over semirings for graph problems.
+	//   BitMatrix, BooleanProduct and TransitiveClosure: reachability, 64 elements per word operation.
+	//   AllPairsShortestPaths: blocked Floyd-Warshall on the min-plus multiplication.
+
+	// Rows of the boolean products handled by a task, and rows of B read per block (kept in L2 meanwhile).
+	const std::size_t BitRowGrain{ 16 };
+	const std::size_t BitBlockBytes{ std::size_t{ 1 } << 18 };
+
+	// Number of bits set in a word.
+	inline std::size_t PopCount(std::uint64_t word){
+#if defined(__GNUC__) || defined(__clang__)
+		return static_cast<std::size_t>(__builtin_popcountll(word));
+#elif defined(_MSC_VER) && defined(_M_X64)
+		return static_cast<std::size_t>(__popcnt64(word));
+#else
+		word = word - ((word >> 1) & 0x5555555555555555ULL);
+		word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+		word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+		return static_cast<std::size_t>((word * 0x0101010101010101ULL) >> 56);
+#endif
+	};
+
+	// Position of the lowest bit set in a non-zero word.
+	inline std::size_t LowestSetBit(std::uint64_t word){
+		assert(word != 0);
+#if defined(__GNUC__) || defined(__clang__)
+		return static_cast<std::size_t>(__builtin_ctzll(word));
+#elif defined(_MSC_VER) && defined(_M_X64)
+		unsigned long position;
+		_BitScanForward64(&position, word);
+		return static_cast<std::size_t>(position);
+#else
+		return PopCount((word & (~word + 1)) - 1);
+#endif
+	};
+
+	//
+	//                      The BitMatrix Class.
+	// A boolean matrix stored by rows, 64 elements per word, bits past the last column zero.
+	class BitMatrix{
+	private:
+		std::size_t Rows;
+		std::size_t Columns;
+		std::size_t Words; // Per row.
+		std::vector<std::uint64_t> Bits;
+	public:
+		BitMatrix(std::size_t rows, std::size_t columns)
+			: Rows(rows), Columns(columns), Words((columns + 63) / 64), Bits(rows * ((columns + 63) / 64), 0){
+		};
+
+		// The non-zeros of a matrix, e.g. the adjacency matrix of a graph.
+		template<typename T>
+		explicit BitMatrix(Matrix<T, 2> const& a)
+			: BitMatrix(a.rows(), a.columns()){
+			for (std::size_t i = 0; i < Rows; ++i){
+				for (std::size_t j = 0; j < Columns; ++j){
+					if (a.rep().at(i, j) != T{ 0 }){
+						set(i, j);
+					};
+				};
+			};
+		};
+
+		std::size_t rows() const {
+			return Rows;
+		};
+		std::size_t columns() const {
+			return Columns;
+		};
+		// Words per row.
+		std::size_t words() const {
+			return Words;
+		};
+
+		bool operator()(std::size_t i, std::size_t j) const {
+			return (Bits[i * Words + j / 64] >> (j % 64)) & 1;
+		};
+		void set(std::size_t i, std::size_t j, bool value = true){
+			std::uint64_t const bit{ std::uint64_t{ 1 } << (j % 64) };
+			std::uint64_t& word{ Bits[i * Words + j / 64] };
+			word = value ? (word | bit) : (word & ~bit);
+		};
+
+		std::uint64_t* row(std::size_t i){
+			return Bits.data() + i * Words;
+		};
+		std::uint64_t const* row(std::size_t i) const {
+			return Bits.data() + i * Words;
+		};
+
+		// Number of true elements.
+		std::size_t count() const {
+			std::size_t c{ 0 };
+			for (auto word : Bits){
+				c += PopCount(word);
+			};
+			return c;
+		};
+
+		bool operator==(BitMatrix const& other) const {
+			return Rows == other.Rows && Columns == other.Columns && Bits == other.Bits;
+		};
+		bool operator!=(BitMatrix const& other) const {
+			return !(*this == other);
+		};
+
+		// As a Matrix<bool>.
+		Matrix<bool, 2> toMatrix() const {
+			Matrix<bool, 2> a(Rows, Columns);
+			for (std::size_t i = 0; i < Rows; ++i){
+				for (std::size_t j = 0; j < Columns; ++j){
+					a.rep().at(i, j) = (*this)(i, j);
+				};
+			};
+			return a;
+		};
+	};// END BitMatrix class
+
+	// Runs body(first, last) over rows [0, rows) in parallel when work (word operations) is large enough.
+	template<typename Body>
+	void ForBitRows(std::size_t rows, std::size_t work, Body const& body){
+		ThreadPool& pool{ ThreadPool::Global() };
+		if (work >= ParallelElementThreshold && pool.size() > 1){
+			pool.ParallelFor(0, rows, BitRowGrain, body);
+		}
+		else{
+			body(0, rows);
+		};
+	};
+
+	// C = A B over (or, and): row i of C is the or of the rows p of B with A(i, p) set.
+	// The set bits of A are found a word at a time, so the work is (set bits of A) x (words per row of B).
+	// B is read in blocks of rows that stay in L2 while every row of C is updated with them.
+	inline BitMatrix BooleanProduct(BitMatrix const& A, BitMatrix const& B){
+		assert(A.columns() == B.rows());
+		BitMatrix C(A.rows(), B.columns());
+		std::size_t const words{ B.words() };
+		std::size_t const block{ std::max<std::size_t>(64, BitBlockBytes / (8 * (words > 0 ? words : 1)) / 64 * 64) };
+		ForBitRows(A.rows(), A.rows() * A.columns() / 64 * words, [&](std::size_t first, std::size_t last){
+			for (std::size_t p0 = 0; p0 < B.rows(); p0 += block){
+				std::size_t const p1{ std::min(B.rows(), p0 + block) };
+				for (std::size_t i = first; i < last; ++i){
+					std::uint64_t const* a{ A.row(i) };
+					std::uint64_t* c{ C.row(i) };
+					for (std::size_t w = p0 / 64; w * 64 < p1; ++w){
+						std::uint64_t bits{ a[w] };
+						while (bits != 0){
+							std::size_t const p{ w * 64 + LowestSetBit(bits) };
+							bits &= bits - 1;
+							std::uint64_t const* b{ B.row(p) };
+							for (std::size_t j = 0; j < words; ++j){
+								c[j] |= b[j];
+							};
+						};
+					};
+				};
+			};
+		});
+		return C;
+	};
+
+	// Transitive closure of the relation (graph) A: R(i, j) if j can be reached from i in one or more steps,
+	// or zero or more if reflexive. Warshall's algorithm on the rows, O(n^3 / 64): at step k every row
+	// reaching k takes the row of k, rows split between the workers.
+	inline BitMatrix TransitiveClosure(BitMatrix const& A, bool reflexive = false){
+		assert(A.rows() == A.columns());
+		BitMatrix R(A);
+		std::size_t const n{ R.rows() };
+		std::size_t const words{ R.words() };
+		for (std::size_t k = 0; k < n; ++k){
+			std::uint64_t const* rk{ R.row(k) };
+			std::uint64_t const mask{ std::uint64_t{ 1 } << (k % 64) };
+			ForBitRows(n, n * words, [&](std::size_t first, std::size_t last){
+				for (std::size_t i = first; i < last; ++i){
+					std::uint64_t* ri{ R.row(i) };
+					if (i != k && (ri[k / 64] & mask) != 0){
+						for (std::size_t j = 0; j < words; ++j){
+							ri[j] |= rk[j];
+						};
+					};
+				};
+			});
+		};
+		if (reflexive){
+			for (std::size_t i = 0; i < n; ++i){
+				R.set(i, i);
+			};
+		};
+		return R;
+	};
+
+	// Shortest path lengths between all pairs of vertices, from the matrix of edge weights W
+	// (MinPlus<T>::Zero(), +infinity, where there is no edge). Blocked Floyd-Warshall: for each block K of
+	// LeafSize vertices, Floyd-Warshall inside the diagonal block, then the rows and columns of K and the rest of
+	// the matrix through K as min-plus multiply-adds, which run on the blocked, threaded multiplication.
+	// O(n^3) like Floyd-Warshall, nearly all of it in the multiplication kernel. Negative edges are fine,
+	// negative cycles are not.
+	template<typename T>
+	Matrix<T, 2> AllPairsShortestPaths(Matrix<T, 2> const& W){
+		typedef MinPlus<T> S;
+		assert(W.rows() == W.columns());
+		std::size_t const n{ W.rows() };
+		Matrix<T, 2> D(n, n);
+		for (std::size_t i = 0; i < n; ++i){
+			for (std::size_t j = 0; j < n; ++j){
+				D.rep().at(i, j) = i == j ? S::Add(W.rep().at(i, j), S::One()) : W.rep().at(i, j);
+			};
+		};
+		MatrixView<T> const V{ D.rep().data(), n, n, n, 1 };
+		std::size_t const b{ GlobalMultiplySettings().LeafSize };
+		ScratchBuffer<T> scratch{ BufferPool<T>::Global().Acquire(2 * b * n) };
+		for (std::size_t k0 = 0; k0 < n; k0 += b){
+			std::size_t const k1{ std::min(n, k0 + b) };
+			std::size_t const kk{ k1 - k0 };
+			MatrixView<T> const K{ V.block(k0, k0, kk, kk) };
+			for (std::size_t p = 0; p < kk; ++p){
+				for (std::size_t i = 0; i < kk; ++i){
+					T const kip{ K(i, p) };
+					for (std::size_t j = 0; j < kk; ++j){
+						K(i, j) = S::Add(K(i, j), S::Multiply(kip, K(p, j)));
+					};
+				};
+			};
+			// Rows and columns of K, from copies since they are also the results.
+			MatrixView<T> const rows{ scratch.data(), kk, n, n, 1 };
+			MatrixView<T> const columns{ scratch.data() + b * n, n, kk, kk, 1 };
+			for (std::size_t i = 0; i < n; ++i){
+				for (std::size_t p = 0; p < kk; ++p){
+					rows(p, i) = V(k0 + p, i);
+					columns(i, p) = V(i, k0 + p);
+				};
+			};
+			RecursiveMultiplyAdd<T, S>(K, rows.block(0, 0, kk, k0), V.block(k0, 0, kk, k0));
+			RecursiveMultiplyAdd<T, S>(K, rows.block(0, k1, kk, n - k1), V.block(k0, k1, kk, n - k1));
+			RecursiveMultiplyAdd<T, S>(columns.block(0, 0, k0, kk), K, V.block(0, k0, k0, kk));
+			RecursiveMultiplyAdd<T, S>(columns.block(k1, 0, n - k1, kk), K, V.block(k1, k0, n - k1, kk));
+			// The rest, through K.
+			std::size_t const first[2]{ 0, k1 };
+			std::size_t const size[2]{ k0, n - k1 };
+			for (std::size_t I = 0; I < 2; ++I){
+				for (std::size_t J = 0; J < 2; ++J){
+					RecursiveMultiplyAdd<T, S>(V.block(first[I], k0, size[I], kk), V.block(k0, first[J], kk, size[J]),
+						V.block(first[I], first[J], size[I], size[J]));
+				};
+			};
+		};
+		return D;
+	};
+	//
+}// END namespace FususMatrix
+
+#endif
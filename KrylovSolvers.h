@@ -0,0 +1,407 @@
+#ifndef _FususKrylovSolvers_
+#define _FususKrylovSolvers_
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Matrix.h"
+#include "SparseMatrix.h"
+
+namespace FususMatrix{
+
+	// Iterative solvers of A x = b for large systems, where A is only used through products A * v.
+	// A can be a Matrix, a SparseMatrix or a LinearOperator, anything with Multiply(x, y) writing A * x into y.
+	// The vectors are n x 1 Matrices. Every vector update of an iteration is a single expression,
+	// e.g. x = x + alpha * p + omega * s, evaluated in one pass without temporaries.
+
+	// A linear operator given by a function writing A * x into y.
+	template<typename T = double>
+	class LinearOperator{
+	private:
+		std::size_t Rows;
+		std::size_t Columns;
+		std::function<void(Matrix<T, 2> const&, Matrix<T, 2>&)> Function;
+	public:
+		LinearOperator(std::size_t rows, std::size_t columns, std::function<void(Matrix<T, 2> const&, Matrix<T, 2>&)> function)
+			: Rows(rows), Columns(columns), Function(std::move(function)){
+		};
+
+		std::size_t rows() const {
+			return Rows;
+		};
+
+		std::size_t columns() const {
+			return Columns;
+		};
+
+		void Multiply(Matrix<T, 2> const& x, Matrix<T, 2>& y) const {
+			Function(x, y);
+		};
+	};
+
+	// Preconditioners. Solve(r, z) writes an approximation of A^{-1} r into z.
+
+	// No preconditioning.
+	template<typename T = double>
+	class IdentityPreconditioner{
+	public:
+		void Solve(Matrix<T, 2> const& r, Matrix<T, 2>& z) const {
+			z = r;
+		};
+	};
+
+	// Jacobi preconditioner, the inverse of the diagonal of A.
+	template<typename T = double>
+	class JacobiPreconditioner{
+	private:
+		Matrix<T, 2> InverseDiagonal;
+	public:
+		template<typename Rep>
+		explicit JacobiPreconditioner(Matrix<T, 2, Rep> const& A)
+			: InverseDiagonal(A.rows(), 1){
+			assert(A.rows() == A.columns());
+			for (std::size_t i = 0; i < A.rows(); ++i){
+				T d{ A.rep().at(i, i) };
+				assert(d != T{ 0 });
+				InverseDiagonal[i] = T{ 1 } / d;
+			};
+		};
+
+		void Solve(Matrix<T, 2> const& r, Matrix<T, 2>& z) const {
+			z = r * InverseDiagonal;
+		};
+	};
+
+	// Incomplete LU factorization with no fill-in, ILU(0).
+	// L and U have the sparsity pattern of A (L with unit diagonal), and L * U equals A on that pattern.
+	// Needs every diagonal element of A to be stored and the pivots to be non-zero.
+	template<typename T = double>
+	class ILU0Preconditioner{
+	private:
+		std::vector<std::size_t> RowPointers;
+		std::vector<std::size_t> ColumnIndices;
+		std::vector<T> Values; // L below the diagonal, U on and above it.
+		std::vector<std::size_t> Diagonal; // Position of the diagonal element of each row in Values.
+	public:
+		explicit ILU0Preconditioner(SparseMatrix<T> const& A)
+			: RowPointers(A.rep().RowPointers()), ColumnIndices(A.rep().ColumnIndices()), Values(A.rep().Values()), Diagonal(A.rows()){
+			assert(A.rows() == A.columns());
+			std::size_t const n{ A.rows() };
+			std::size_t const none{ std::numeric_limits<std::size_t>::max() };
+			for (std::size_t i = 0; i < n; ++i){
+				Diagonal[i] = none;
+				for (std::size_t p = RowPointers[i]; p < RowPointers[i + 1]; ++p){
+					if (ColumnIndices[p] == i){
+						Diagonal[i] = p;
+					};
+				};
+				assert(Diagonal[i] != none);
+			};
+			// IKJ variant: row i is eliminated with the rows k < i already factored.
+			std::vector<std::size_t> position(n, none);
+			for (std::size_t i = 0; i < n; ++i){
+				for (std::size_t p = RowPointers[i]; p < RowPointers[i + 1]; ++p){
+					position[ColumnIndices[p]] = p;
+				};
+				for (std::size_t p = RowPointers[i]; p < Diagonal[i]; ++p){
+					std::size_t const k{ ColumnIndices[p] };
+					assert(Values[Diagonal[k]] != T{ 0 });
+					Values[p] /= Values[Diagonal[k]];
+					for (std::size_t q = Diagonal[k] + 1; q < RowPointers[k + 1]; ++q){
+						if (position[ColumnIndices[q]] != none){
+							Values[position[ColumnIndices[q]]] -= Values[p] * Values[q];
+						};
+					};
+				};
+				for (std::size_t p = RowPointers[i]; p < RowPointers[i + 1]; ++p){
+					position[ColumnIndices[p]] = none;
+				};
+			};
+		};
+
+		// z = U^{-1} L^{-1} r, by forward and backward substitution.
+		void Solve(Matrix<T, 2> const& r, Matrix<T, 2>& z) const {
+			std::size_t const n{ Diagonal.size() };
+			assert(r.size() == n && z.size() == n);
+			for (std::size_t i = 0; i < n; ++i){
+				T sum{ r[i] };
+				for (std::size_t p = RowPointers[i]; p < Diagonal[i]; ++p){
+					sum -= Values[p] * z[ColumnIndices[p]];
+				};
+				z[i] = sum;
+			};
+			for (std::size_t i = n; i > 0; --i){
+				T sum{ z[i - 1] };
+				for (std::size_t p = Diagonal[i - 1] + 1; p < RowPointers[i]; ++p){
+					sum -= Values[p] * z[ColumnIndices[p]];
+				};
+				z[i - 1] = sum / Values[Diagonal[i - 1]];
+			};
+		};
+	};
+
+	// Stopping criteria of the solvers.
+	// Tolerance: on the residual relative to b, ||b - A x|| / ||b||.
+	// MaximumIterations: products by A (for GMRES, inner iterations over all restarts).
+	// Restart: size of the Krylov basis of GMRES before it restarts.
+	struct SolverSettings{
+		double Tolerance;
+		std::size_t MaximumIterations;
+		std::size_t Restart;
+	};
+
+	inline SolverSettings DefaultSolverSettings(){
+		return SolverSettings{ 1e-8, 1000, 30 };
+	};
+
+	// What a solver did.
+	// ResidualHistory[0] is the relative residual of the initial guess, ResidualHistory[k] the one after iteration k.
+	struct SolverReport{
+		std::string Method;
+		bool Converged;
+		std::size_t Iterations;
+		std::vector<double> ResidualHistory;
+		std::vector<double> IterationTimes; // Seconds.
+		double TotalTime; // Seconds, setup included.
+
+		double RelativeResidual() const {
+			return ResidualHistory.empty() ? 0.0 : ResidualHistory.back();
+		};
+
+		double AverageIterationTime() const {
+			double total{ 0 };
+			for (auto t : IterationTimes){
+				total += t;
+			};
+			return IterationTimes.empty() ? 0.0 : total / IterationTimes.size();
+		};
+	};
+
+	inline std::ostream& operator<<(std::ostream& os, SolverReport const& report){
+		os << report.Method << (report.Converged ? " converged" : " did not converge") << " after " << report.Iterations
+			<< " iterations, relative residual " << report.RelativeResidual() << ", " << 1e3 * report.AverageIterationTime()
+			<< " ms per iteration, " << 1e3 * report.TotalTime << " ms in total." << std::endl;
+		return os;
+	};
+
+	// Seconds since a time point.
+	inline double SecondsSince(std::chrono::steady_clock::time_point start){
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	// Preconditioned Conjugate Gradient, for symmetric positive definite A (and preconditioner).
+	// x holds the initial guess and receives the solution.
+	template<typename T, typename Operator, typename Preconditioner>
+	SolverReport ConjugateGradient(Operator const& A, Matrix<T, 2> const& b, Matrix<T, 2>& x, Preconditioner const& M,
+		SolverSettings const& settings = DefaultSolverSettings()){
+		auto const start = std::chrono::steady_clock::now();
+		SolverReport report{ "ConjugateGradient", false, 0, std::vector<double>(), std::vector<double>(), 0.0 };
+		std::size_t const n{ b.rows() };
+		assert(b.columns() == 1 && A.rows() == n && A.columns() == n && x.size() == n);
+		Matrix<T, 2> r(n, 1), z(n, 1), p(n, 1), q(n, 1);
+		T bnorm{ norm2(b) };
+		bnorm = bnorm > T{ 0 } ? bnorm : T{ 1 };
+		A.Multiply(x, q);
+		r = b - q;
+		T residual{ norm2(r) / bnorm };
+		report.ResidualHistory.push_back(residual);
+		M.Solve(r, z);
+		p = z;
+		T rz{ dot(r, z) };
+		while (residual > settings.Tolerance && report.Iterations < settings.MaximumIterations){
+			auto const iterationStart = std::chrono::steady_clock::now();
+			A.Multiply(p, q);
+			T const pq{ dot(p, q) };
+			if (pq == T{ 0 }){
+				break;
+			};
+			T const alpha{ rz / pq };
+			x = x + alpha * p;
+			r = r - alpha * q;
+			residual = norm2(r) / bnorm;
+			M.Solve(r, z);
+			T const rzNew{ dot(r, z) };
+			p = z + (rzNew / rz) * p;
+			rz = rzNew;
+			++report.Iterations;
+			report.ResidualHistory.push_back(residual);
+			report.IterationTimes.push_back(SecondsSince(iterationStart));
+		};
+		report.Converged = residual <= settings.Tolerance;
+		report.TotalTime = SecondsSince(start);
+		return report;
+	};
+
+	template<typename T, typename Operator>
+	SolverReport ConjugateGradient(Operator const& A, Matrix<T, 2> const& b, Matrix<T, 2>& x, SolverSettings const& settings = DefaultSolverSettings()){
+		return ConjugateGradient(A, b, x, IdentityPreconditioner<T>(), settings);
+	};
+
+	// Preconditioned BiCGSTAB (van der Vorst), for general non-singular A. Right preconditioning,
+	// so the residual monitored is the true one.
+	template<typename T, typename Operator, typename Preconditioner>
+	SolverReport BiCGSTAB(Operator const& A, Matrix<T, 2> const& b, Matrix<T, 2>& x, Preconditioner const& M,
+		SolverSettings const& settings = DefaultSolverSettings()){
+		auto const start = std::chrono::steady_clock::now();
+		SolverReport report{ "BiCGSTAB", false, 0, std::vector<double>(), std::vector<double>(), 0.0 };
+		std::size_t const n{ b.rows() };
+		assert(b.columns() == 1 && A.rows() == n && A.columns() == n && x.size() == n);
+		Matrix<T, 2> r(n, 1), shadow(n, 1), p(n, 1), v(n, 1), s(n, 1), t(n, 1), pHat(n, 1), sHat(n, 1);
+		T bnorm{ norm2(b) };
+		bnorm = bnorm > T{ 0 } ? bnorm : T{ 1 };
+		A.Multiply(x, t);
+		r = b - t;
+		shadow = r;
+		T residual{ norm2(r) / bnorm };
+		report.ResidualHistory.push_back(residual);
+		T rho{ 1 }, alpha{ 1 }, omega{ 1 };
+		// p and v start at zero, as the containers do.
+		while (residual > settings.Tolerance && report.Iterations < settings.MaximumIterations){
+			auto const iterationStart = std::chrono::steady_clock::now();
+			T const rhoNew{ dot(shadow, r) };
+			if (rhoNew == T{ 0 } || omega == T{ 0 }){
+				break;
+			};
+			T const beta{ (rhoNew / rho) * (alpha / omega) };
+			p = r + beta * (p - omega * v);
+			M.Solve(p, pHat);
+			A.Multiply(pHat, v);
+			T const shadowV{ dot(shadow, v) };
+			if (shadowV == T{ 0 }){
+				break;
+			};
+			alpha = rhoNew / shadowV;
+			s = r - alpha * v;
+			rho = rhoNew;
+			++report.Iterations;
+			if (norm2(s) / bnorm <= settings.Tolerance){
+				x = x + alpha * pHat;
+				r = s;
+				residual = norm2(r) / bnorm;
+				report.ResidualHistory.push_back(residual);
+				report.IterationTimes.push_back(SecondsSince(iterationStart));
+				break;
+			};
+			M.Solve(s, sHat);
+			A.Multiply(sHat, t);
+			T const tt{ dot(t, t) };
+			omega = tt > T{ 0 } ? dot(t, s) / tt : T{ 0 };
+			x = x + alpha * pHat + omega * sHat;
+			r = s - omega * t;
+			residual = norm2(r) / bnorm;
+			report.ResidualHistory.push_back(residual);
+			report.IterationTimes.push_back(SecondsSince(iterationStart));
+		};
+		report.Converged = residual <= settings.Tolerance;
+		report.TotalTime = SecondsSince(start);
+		return report;
+	};
+
+	template<typename T, typename Operator>
+	SolverReport BiCGSTAB(Operator const& A, Matrix<T, 2> const& b, Matrix<T, 2>& x, SolverSettings const& settings = DefaultSolverSettings()){
+		return BiCGSTAB(A, b, x, IdentityPreconditioner<T>(), settings);
+	};
+
+	// Restarted GMRES(m), m = settings.Restart, for general non-singular A. Right preconditioning.
+	// The Krylov basis is orthogonalized with modified Gram-Schmidt, and the least squares problem is
+	// updated with Givens rotations, so the residual norm is known at every iteration without computing it.
+	template<typename T, typename Operator, typename Preconditioner>
+	SolverReport GMRES(Operator const& A, Matrix<T, 2> const& b, Matrix<T, 2>& x, Preconditioner const& M,
+		SolverSettings const& settings = DefaultSolverSettings()){
+		auto const start = std::chrono::steady_clock::now();
+		SolverReport report{ "GMRES", false, 0, std::vector<double>(), std::vector<double>(), 0.0 };
+		std::size_t const n{ b.rows() };
+		std::size_t const m{ settings.Restart > 0 ? settings.Restart : 1 };
+		assert(b.columns() == 1 && A.rows() == n && A.columns() == n && x.size() == n);
+		std::vector<Matrix<T, 2> > V;
+		for (std::size_t i = 0; i <= m; ++i){
+			V.emplace_back(n, 1);
+		};
+		Matrix<T, 2> w(n, 1), z(n, 1);
+		std::vector<std::vector<T> > H(m + 1, std::vector<T>(m)); // Hessenberg matrix, rotated into upper triangular.
+		std::vector<T> cosines(m), sines(m), g(m + 1), y(m);
+		T bnorm{ norm2(b) };
+		bnorm = bnorm > T{ 0 } ? bnorm : T{ 1 };
+		T residual{ std::numeric_limits<T>::max() };
+		for (;;){
+			A.Multiply(x, w);
+			V[0] = b - w;
+			T const beta{ norm2(V[0]) };
+			residual = beta / bnorm;
+			if (report.ResidualHistory.empty()){
+				report.ResidualHistory.push_back(residual);
+			};
+			if (residual <= settings.Tolerance || report.Iterations >= settings.MaximumIterations){
+				break;
+			};
+			V[0] = V[0] * (T{ 1 } / beta);
+			std::fill(g.begin(), g.end(), T{ 0 });
+			g[0] = beta;
+			std::size_t k{ 0 }; // Columns of the basis built in this cycle.
+			while (k < m && report.Iterations < settings.MaximumIterations){
+				auto const iterationStart = std::chrono::steady_clock::now();
+				M.Solve(V[k], z);
+				A.Multiply(z, w);
+				for (std::size_t i = 0; i <= k; ++i){
+					H[i][k] = dot(w, V[i]);
+					w = w - H[i][k] * V[i];
+				};
+				H[k + 1][k] = norm2(w);
+				bool const breakdown{ H[k + 1][k] == T{ 0 } };
+				if (!breakdown){
+					V[k + 1] = w * (T{ 1 } / H[k + 1][k]);
+				};
+				for (std::size_t i = 0; i < k; ++i){
+					T const temp{ cosines[i] * H[i][k] + sines[i] * H[i + 1][k] };
+					H[i + 1][k] = -sines[i] * H[i][k] + cosines[i] * H[i + 1][k];
+					H[i][k] = temp;
+				};
+				T const radius{ std::hypot(H[k][k], H[k + 1][k]) };
+				cosines[k] = H[k][k] / radius;
+				sines[k] = H[k + 1][k] / radius;
+				H[k][k] = radius;
+				H[k + 1][k] = T{ 0 };
+				g[k + 1] = -sines[k] * g[k];
+				g[k] = cosines[k] * g[k];
+				++k;
+				++report.Iterations;
+				residual = std::fabs(g[k]) / bnorm;
+				report.ResidualHistory.push_back(residual);
+				report.IterationTimes.push_back(SecondsSince(iterationStart));
+				if (residual <= settings.Tolerance || breakdown){
+					break;
+				};
+			};
+			// x += M^{-1} V y, with H y = g solved by back substitution.
+			for (std::size_t i = k; i > 0; --i){
+				T sum{ g[i - 1] };
+				for (std::size_t j = i; j < k; ++j){
+					sum -= H[i - 1][j] * y[j];
+				};
+				y[i - 1] = sum / H[i - 1][i - 1];
+			};
+			w = y[0] * V[0];
+			for (std::size_t i = 1; i < k; ++i){
+				w = w + y[i] * V[i];
+			};
+			M.Solve(w, z);
+			x = x + z;
+		};
+		report.Converged = residual <= settings.Tolerance;
+		report.TotalTime = SecondsSince(start);
+		return report;
+	};
+
+	template<typename T, typename Operator>
+	SolverReport GMRES(Operator const& A, Matrix<T, 2> const& b, Matrix<T, 2>& x, SolverSettings const& settings = DefaultSolverSettings()){
+		return GMRES(A, b, x, IdentityPreconditioner<T>(), settings);
+	};
+	//
+}// END namespace FususMatrix
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef _FususLayout_
+#define _FususLayout_
+
+#include <cstddef>
+
+namespace FususMatrix{
+
+	// How the elements of a container, or of all the operands of an expression, are laid out in memory.
+	// Any: no layout (scalars), can be read in any order.
+	// RowMajor / ColumnMajor: contiguous, last / first coordinate varying fastest.
+	// Strided: arbitrary strides, or operands of an expression with different layouts.
+	enum class Layout { Any, RowMajor, ColumnMajor, Strided };
+
+	// Layout of an expression with operands laid out as a and b.
+	inline Layout CombineLayouts(Layout a, Layout b){
+		if (a == Layout::Any){
+			return b;
+		};
+		if (b == Layout::Any){
+			return a;
+		};
+		return a == b ? a : Layout::Strided;
+	};
+
+	// Side of the square tiles used to traverse operands with different layouts.
+	// Each row of a tile of doubles spans 4 cache lines, and the tiles of a few operands fit in L1.
+	template<typename T>
+	constexpr std::size_t TileSize(){
+		return 256 / sizeof(T) < 8 ? 8 : 256 / sizeof(T);
+	};
+	//
+}// END namespace FususMatrix
+
+#endif
@@ -2,6 +2,12 @@
 #ifndef _FususLazyEvaluationExpressionTemplates_
 #define _FususLazyEvaluationExpressionTemplates_
 
+#include <initializer_list>
+#include <tuple>
+#include <utility>
+
+#include "Layout.h"
+
 namespace FususMatrix{
 
 	// Scalar class.
@@ -19,14 +25,27 @@ namespace FususMatrix{
 		T operator[](std::size_t index) const {
 			return s;
 		};
+		T at(std::size_t, std::size_t) const {
+			return s;
+		};
+
+		T value() const {
+			return s;
+		};
+
+		// A scalar can be read in any order.
+		Layout layout() const {
+			return Layout::Any;
+		};
 
 		// It has size 0.
 		std::size_t size() const {
 			return 0;
 		};
 
-		std::vector<std::size_t> getSizesAlongEachDimension() const {
-			return std::vector<std::size_t>(0);
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			static std::vector<std::size_t> const None;
+			return None;
 		}
 	};
 
@@ -61,17 +80,32 @@ namespace FususMatrix{
 			: operand1(a), operand2(b){
 		};
 
+		// Operands, for the rewrites of ExpressionSimplification.h and the evaluation planner.
+		Operand1 const& left() const {
+			return operand1;
+		};
+		Operand2 const& right() const {
+			return operand2;
+		};
+
 		T operator[] (std::size_t index) const {
 			return operand1[index] + operand2[index];
 		};
+		T at(std::size_t i, std::size_t j) const {
+			return operand1.at(i, j) + operand2.at(i, j);
+		};
+
+		Layout layout() const {
+			return CombineLayouts(operand1.layout(), operand2.layout());
+		};
 
 		std::size_t size() const {
 			return operand1.size() != 0 ? operand1.size() : operand2.size();
 		};
 
-		std::vector<std::size_t> getSizesAlongEachDimension() const {
-			assert(operand1.getSizesAlongEachDimension() == operand2.getSizesAlongEachDimension());
-			return operand1.getSizesAlongEachDimension();
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			assert(operand1.size() == 0 || operand2.size() == 0 || operand1.getSizesAlongEachDimension() == operand2.getSizesAlongEachDimension());
+			return operand1.size() != 0 ? operand1.getSizesAlongEachDimension() : operand2.getSizesAlongEachDimension();
 		};
 	};
 
@@ -89,16 +123,31 @@ namespace FususMatrix{
 			: operand1(a), operand2(b){
 		};
 
+		// Operands, for the rewrites of ExpressionSimplification.h and the evaluation planner.
+		Operand1 const& left() const {
+			return operand1;
+		};
+		Operand2 const& right() const {
+			return operand2;
+		};
+
 		T operator[] (std::size_t index) const {
 			return operand1[index] - operand2[index];
 		};
+		T at(std::size_t i, std::size_t j) const {
+			return operand1.at(i, j) - operand2.at(i, j);
+		};
+
+		Layout layout() const {
+			return CombineLayouts(operand1.layout(), operand2.layout());
+		};
 
 		std::size_t size() const {
 			return operand1.size() != 0 ? operand1.size() : operand2.size();
 		};
 
-		std::vector<std::size_t> getSizesAlongEachDimension() const {
-			return operand1.getSizesAlongEachDimension();
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			return operand1.size() != 0 ? operand1.getSizesAlongEachDimension() : operand2.getSizesAlongEachDimension();
 		};
 	};
 
@@ -116,14 +165,29 @@ namespace FususMatrix{
 			: operand1(a), operand2(b){
 		};
 
+		// Operands, for the rewrites of ExpressionSimplification.h and the evaluation planner.
+		Operand1 const& left() const {
+			return operand1;
+		};
+		Operand2 const& right() const {
+			return operand2;
+		};
+
 		T operator[] (std::size_t index) const {
 			return operand1[index] * operand2[index];
 		};
+		T at(std::size_t i, std::size_t j) const {
+			return operand1.at(i, j) * operand2.at(i, j);
+		};
+
+		Layout layout() const {
+			return CombineLayouts(operand1.layout(), operand2.layout());
+		};
 		std::size_t size() const {
 			return operand1.size() != 0 ? operand1.size() : operand2.size();
 		};
 
-		std::vector<std::size_t> getSizesAlongEachDimension() const {
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
 			return operand1.size() != 0 ? operand1.getSizesAlongEachDimension() : operand2.getSizesAlongEachDimension();
 		};
 	};
@@ -142,17 +206,223 @@ namespace FususMatrix{
 			: operand1(a), operand2(b){
 		};
 
+		// Operands, for the rewrites of ExpressionSimplification.h and the evaluation planner.
+		Operand1 const& left() const {
+			return operand1;
+		};
+		Operand2 const& right() const {
+			return operand2;
+		};
+
 		T operator[] (std::size_t index) const {
 			return operand1[index] / operand2[index];
 		};
+		T at(std::size_t i, std::size_t j) const {
+			return operand1.at(i, j) / operand2.at(i, j);
+		};
+
+		Layout layout() const {
+			return CombineLayouts(operand1.layout(), operand2.layout());
+		};
+		std::size_t size() const {
+			return operand1.size() != 0 ? operand1.size() : operand2.size();
+		};
+
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			return operand1.size() != 0 ? operand1.getSizesAlongEachDimension() : operand2.getSizesAlongEachDimension();
+		};
+	};
+
+	// UnaryFunction class.
+	// Stores a (traited) reference to the operand and the function object.
+	// Returns the function applied to the element if asked for a value.
+	template<typename T, typename Function, typename Operand>
+	class UnaryFunction{
+	private:
+		typename Traits<Operand>::ExprRef operand;
+		Function function;
+
+	public:
+		UnaryFunction(Operand const& a, Function const& f)
+			: operand(a), function(f){
+		};
+
+		// Operand and function, for the evaluation planner (EvaluationPlanner.h).
+		Operand const& inner() const {
+			return operand;
+		};
+		Function const& functionObject() const {
+			return function;
+		};
+
+		T operator[] (std::size_t index) const {
+			return function(operand[index]);
+		};
+		T at(std::size_t i, std::size_t j) const {
+			return function(operand.at(i, j));
+		};
+
+		Layout layout() const {
+			return operand.layout();
+		};
+		std::size_t size() const {
+			return operand.size();
+		};
+
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			return operand.getSizesAlongEachDimension();
+		};
+	};
+
+	// BinaryFunction class.
+	// Stores (traited) references to the operands and the function object.
+	// Returns the function applied to the pair of elements if asked for a value.
+	template<typename T, typename Function, typename Operand1, typename Operand2>
+	class BinaryFunction{
+	private:
+		typename Traits<Operand1>::ExprRef operand1;
+		typename Traits<Operand2>::ExprRef operand2;
+		Function function;
+
+	public:
+		BinaryFunction(Operand1 const& a, Operand2 const& b, Function const& f)
+			: operand1(a), operand2(b), function(f){
+		};
+
+		// Operands and function, for the evaluation planner (EvaluationPlanner.h).
+		Operand1 const& left() const {
+			return operand1;
+		};
+		Operand2 const& right() const {
+			return operand2;
+		};
+		Function const& functionObject() const {
+			return function;
+		};
+
+		T operator[] (std::size_t index) const {
+			return function(operand1[index], operand2[index]);
+		};
+		T at(std::size_t i, std::size_t j) const {
+			return function(operand1.at(i, j), operand2.at(i, j));
+		};
+
+		Layout layout() const {
+			return CombineLayouts(operand1.layout(), operand2.layout());
+		};
 		std::size_t size() const {
 			return operand1.size() != 0 ? operand1.size() : operand2.size();
 		};
 
-		std::vector<std::size_t> getSizesAlongEachDimension() const {
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
 			return operand1.size() != 0 ? operand1.getSizesAlongEachDimension() : operand2.getSizesAlongEachDimension();
 		};
 	};
+
+	// Selection class.
+	// Stores (traited) references to a mask and to the two alternatives.
+	// Returns the element of the first alternative where the mask is true, of the second one otherwise.
+	// Both alternatives are read, so the selection is free of branches.
+	template<typename T, typename Mask, typename Operand1, typename Operand2>
+	class Selection{
+	private:
+		typename Traits<Mask>::ExprRef mask;
+		typename Traits<Operand1>::ExprRef operand1;
+		typename Traits<Operand2>::ExprRef operand2;
+
+	public:
+		Selection(Mask const& m, Operand1 const& a, Operand2 const& b)
+			: mask(m), operand1(a), operand2(b){
+		};
+
+		// Operands, for the evaluation planner (EvaluationPlanner.h).
+		Mask const& condition() const {
+			return mask;
+		};
+		Operand1 const& left() const {
+			return operand1;
+		};
+		Operand2 const& right() const {
+			return operand2;
+		};
+
+		T operator[] (std::size_t index) const {
+			T first{ operand1[index] };
+			T second{ operand2[index] };
+			return mask[index] ? first : second;
+		};
+		T at(std::size_t i, std::size_t j) const {
+			T first{ operand1.at(i, j) };
+			T second{ operand2.at(i, j) };
+			return mask.at(i, j) ? first : second;
+		};
+
+		Layout layout() const {
+			return CombineLayouts(mask.layout(), CombineLayouts(operand1.layout(), operand2.layout()));
+		};
+		std::size_t size() const {
+			return mask.size();
+		};
+
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			return mask.getSizesAlongEachDimension();
+		};
+	};
+
+	// Map class.
+	// Stores (traited) references to any number of operands and a function object taking one element of each.
+	// Returns the function applied to the elements if asked for a value.
+	template<typename T, typename Function, typename... Operands>
+	class Map{
+	private:
+		std::tuple<typename Traits<Operands>::ExprRef...> operands;
+		Function function;
+
+		template<std::size_t... I>
+		T apply(std::size_t index, std::index_sequence<I...>) const {
+			return function(std::get<I>(operands)[index]...);
+		};
+		template<std::size_t... I>
+		T applyAt(std::size_t i, std::size_t j, std::index_sequence<I...>) const {
+			return function(std::get<I>(operands).at(i, j)...);
+		};
+		template<std::size_t... I>
+		Layout combinedLayout(std::index_sequence<I...>) const {
+			Layout result{ Layout::Any };
+			for (Layout l : { Layout::Any, std::get<I>(operands).layout()... }){
+				result = CombineLayouts(result, l);
+			};
+			return result;
+		};
+
+	public:
+		Map(Function const& f, Operands const&... a)
+			: operands(a...), function(f){
+		};
+
+		// Operands, for the evaluation planner (EvaluationPlanner.h).
+		std::tuple<typename Traits<Operands>::ExprRef...> const& arguments() const {
+			return operands;
+		};
+
+		T operator[] (std::size_t index) const {
+			return apply(index, std::index_sequence_for<Operands...>{});
+		};
+		T at(std::size_t i, std::size_t j) const {
+			return applyAt(i, j, std::index_sequence_for<Operands...>{});
+		};
+
+		Layout layout() const {
+			return combinedLayout(std::index_sequence_for<Operands...>{});
+		};
+		std::size_t size() const {
+			return std::get<0>(operands).size();
+		};
+
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			return std::get<0>(operands).getSizesAlongEachDimension();
+		};
+	};
 	//
 }// END namespace FususMatrix
 
@@ -1,8 +1,12 @@
 #include <iostream>
 #include <chrono>
+#include <cassert>
+#include <cstdlib>
+#include <new>
 
 #include "Matrix.h"
 #include "SparseMatrix.h"
+#include "KrylovSolvers.h"
 
 using namespace std;
 using namespace std::chrono;
@@ -20,6 +24,30 @@ std::cout << STR << std::endl
 
 int Page{ 1 };
 
+// Counts the allocations, to check that evaluating into a Matrix of the right sizes doesn't allocate.
+std::size_t Allocations{ 0 };
+void* operator new(std::size_t size){
+	++Allocations;
+	if (void* p = std::malloc(size == 0 ? 1 : size)){
+		return p;
+	};
+	throw std::bad_alloc();
+};
+// GCC doesn't see that this operator new allocates with malloc, and warns about the free.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept {
+	std::free(p);
+};
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+};
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
 void logo(){
 	std::cout << "_______________________________________________________________________________\n";
 	std::cout << "_______________________________________________________________________________\n\n";
@@ -142,6 +170,71 @@ void tests(){
 	PRINT("This means " << static_cast<int>(1000 * (6 * x*y*z) / static_cast<double>(duration)) << " operations/nanosecond.");
 	STOP;
 
+	// No allocations when evaluating.
+	PRINT("Evaluating an expression into a Matrix of the right sizes allocates nothing:");
+	PRINT("no temporaries, the result is written straight into the elements of the destination.");
+	PRINT("The same for evaluate_into, for products into an existing Matrix and for solving into one,");
+	PRINT("once their scratch buffers are in the pool (the first call takes them).");
+	PRINT("\nfor (int r = 0; r < 10; ++r) G = H + I * s;");
+	PRINT("for (int r = 0; r < 10; ++r) evaluate_into(G, H + I * s);");
+	PRINT("for (int r = 0; r < 10; ++r) M.Multiply(N, R);");
+	PRINT("for (int r = 0; r < 10; ++r) T.span(N, X);\n");
+	{
+		Matrix<double> G(100, 200), H(100, 200), I(100, 200);
+		double const s{ 0.5 };
+		for (std::size_t k = 0; k < H.size(); ++k){
+			H[k] = k;
+			I[k] = 2.0 * k;
+		};
+		std::size_t before{ Allocations };
+		for (int r = 0; r < 10; ++r){
+			G = H + I * s;
+		};
+		std::size_t allocations{ Allocations - before };
+		PRINT("Allocations of G = H + I * s: " << allocations);
+		assert(allocations == 0 && G(99, 199) == 2.0 * (99 * 200 + 199));
+
+		Matrix<double> Gt(200, 100);
+		Gt.transpose();
+		evaluate_into(Gt, H + I * s);
+		before = Allocations;
+		for (int r = 0; r < 10; ++r){
+			evaluate_into(G, H + I * s);
+			evaluate_into(Gt, H + I * s);
+		};
+		allocations = Allocations - before;
+		PRINT("Allocations of evaluate_into: " << allocations);
+		assert(allocations == 0 && Gt(99, 199) == G(99, 199));
+
+		Matrix<double> M(100, 100), N(100, 1), R(100, 1), T(100, 100), X(100, 1);
+		for (std::size_t i = 0; i < 100; ++i){
+			N[i] = 1.0;
+			for (std::size_t j = 0; j < 100; ++j){
+				M(i, j) = 1.0 / (1 + i + j);
+				T(i, j) = j <= i ? 1.0 : 0.0;
+			};
+		};
+		M.Multiply(N, R);
+		T.span(N, X);
+		before = Allocations;
+		for (int r = 0; r < 10; ++r){
+			M.Multiply(N, R);
+			T.span(N, X);
+		};
+		allocations = Allocations - before;
+		PRINT("Allocations of Multiply and span: " << allocations);
+		assert(allocations == 0 && X[0] == 1.0 && X[1] == 0.0);
+	};
+	STOP;
+
+	// Element-wise functions.
+	PRINT("Element-wise functions are lazy too, and get fused into the same single pass.");
+	PRINT("\nC = tanh(0.1*C) * B + sqrt(B) + max(C, 8.0);");
+	C = tanh(0.1*C) * B + sqrt(B) + max(C, 8.0);
+	PRINT("\nC =\n" << C << "\n");
+	PRINT("exp, log and tanh of doubles are computed with branch-free polynomials that vectorize.");
+	STOP;
+
 	// Testing matrix D with IsTriangular.
 	PRINT("Testing if a matrix is lower triangular.");
 	PRINT("Let's test the matrix ");
@@ -196,6 +289,22 @@ void tests(){
 	SparseMatrix<double> S(3, 3);
 	STOP;
 
+	PRINT("Large sparse systems are solved iteratively, only using products by the matrix.");
+	PRINT("\nSparseMatrix<double> L{ { 4, -1, 0 }, { -1, 4, -1 }, { 0, -1, 4 } };");
+	PRINT("Matrix<> u(3, 1);");
+	PRINT("ConjugateGradient(L, c, u, JacobiPreconditioner<double>(L));\n");
+	SparseMatrix<double> L{ { 4, -1, 0 }, { -1, 4, -1 }, { 0, -1, 4 } };
+	Matrix<> c(3, 1);
+	c(0, 0) = 1;
+	c(1, 0) = 2;
+	c(2, 0) = 3;
+	Matrix<> u(3, 1);
+	SolverReport report{ ConjugateGradient(L, c, u, JacobiPreconditioner<double>(L)) };
+	PRINT(report);
+	PRINT("u =\n" << u);
+	PRINT("BiCGSTAB and GMRES work the same way, also with an ILU0Preconditioner.");
+	STOP;
+
 	PRINT("\nThat's all folks!");
 	STOP;
 };
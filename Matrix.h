@@ -4,9 +4,11 @@
 #include <cassert>
 #include <vector>
 #include <iostream>
+#include <utility>
 
 #include "DenseMatrixContainer.h"
 #include "LazyEvaluationExpressionTemplates.h"
+#include "EvaluationPlanner.h"
 
 
 namespace FususMatrix{
@@ -20,6 +22,43 @@ namespace FususMatrix{
 		return temp;
 	};
 
+	// Elements of the destination of an evaluation, to be written in storage order through a pointer, or null
+	// when they have to be written through the container. Taking the pointer of a DenseMatrixContainer gives it
+	// a buffer of its own first (copy-on-write), once per evaluation rather than per element.
+	template<typename T, typename Rep>
+	T* WritableElements(Rep&){
+		return nullptr;
+	};
+	template<typename T, std::size_t Dimension>
+	T* WritableElements(DenseMatrixContainer<T, Dimension>& container){
+		return container.data();
+	};
+	// Strides of those elements along the two coordinates of a 2-D destination.
+	template<typename Rep>
+	void ElementStrides(Rep const&, std::size_t&, std::size_t&){
+	};
+	template<typename T, std::size_t Dimension>
+	void ElementStrides(DenseMatrixContainer<T, Dimension> const& container, std::size_t& RowStride, std::size_t& ColumnStride){
+		RowStride = container.getStrides()[0];
+		ColumnStride = container.getStrides()[1];
+	};
+
+	// Returned by Matrix::noalias(), to assign expressions without planning their evaluation.
+	template<typename Destination>
+	class NoAliasAssignment{
+	private:
+		Destination& destination;
+	public:
+		explicit NoAliasAssignment(Destination& d)
+			: destination(d){
+		};
+
+		template<typename Expression>
+		Destination& operator=(Expression const& b){
+			return destination.assignNoAlias(b);
+		};
+	};
+
 	//
 	//                      The Matrix Class.
 	// Template parameter Rep is used to implement lazy evaluation using Expression Templates.
@@ -28,6 +67,103 @@ namespace FususMatrix{
 	class Matrix {
 	protected:
 		Rep Expression_MyMatrixContainer; // (Access to) the data of the Matrix.
+
+		// Evaluation of an expression into 'this', element by element.
+		// When all the operands share the layout of 'this' the elements are visited in storage order.
+		// Otherwise (e.g. one operand is weakly transposed) they are visited in square tiles,
+		// so that every operand is read in blocks of whole cache lines whatever its layout.
+		template<typename Expression>
+		void Evaluate(Expression const& b){
+			T* const elements{ WritableElements<T>(Expression_MyMatrixContainer) };
+			Layout target{ Expression_MyMatrixContainer.layout() };
+			Layout source{ b.layout() };
+			if (Dimension != 2 || source == Layout::Any || (source == target && target != Layout::Strided)){
+				// Large expressions are split in the same blocks per worker as the first touch of the buffers.
+				std::size_t const n{ b.size() };
+				ThreadPool& pool{ ThreadPool::Global() };
+				if (n >= ParallelElementThreshold && pool.size() > 1){
+					pool.ParallelForStatic(0, n, [this, &b, elements](std::size_t first, std::size_t last){
+						EvaluateRange(b, elements, first, last);
+					});
+				}
+				else{
+					EvaluateRange(b, elements, 0, n);
+				};
+			}
+			else{
+				EvaluateTiled(b, elements, target == Layout::ColumnMajor);
+			};
+		};
+
+		// Evaluation in storage order of the elements in [first, last).
+		// The bounds are plain values, so that the loop has a single exit and can be vectorized.
+		template<typename Expression>
+		void EvaluateRange(Expression const& b, T* elements, std::size_t first, std::size_t last){
+			if (elements != nullptr){
+				for (std::size_t index = first; index < last; ++index){
+					elements[index] = b[index];
+				};
+				return;
+			};
+			for (std::size_t index = first; index < last; ++index){
+				Expression_MyMatrixContainer[index] = b[index];
+			};
+		};
+
+		// Tiled traversal for 2-D operands with different layouts.
+		// Inside a tile the fastest index is the one contiguous in 'this'.
+		template<typename Expression>
+		void EvaluateTiled(Expression const& b, T* elements, bool ColumnMajor){
+			if (elements != nullptr){
+				std::size_t RowStride{ 0 };
+				std::size_t ColumnStride{ 0 };
+				ElementStrides(Expression_MyMatrixContainer, RowStride, ColumnStride);
+				ForEachInTiles(ColumnMajor, [&b, elements, RowStride, ColumnStride](std::size_t i, std::size_t j){
+					elements[i * RowStride + j * ColumnStride] = b.at(i, j);
+				});
+			}
+			else{
+				ForEachInTiles(ColumnMajor, [this, &b](std::size_t i, std::size_t j){
+					Expression_MyMatrixContainer.at(i, j) = b.at(i, j);
+				});
+			};
+		};
+		template<typename Body>
+		void ForEachInTiles(bool ColumnMajor, Body const& body){
+			std::size_t const tile{ TileSize<T>() };
+			std::size_t const m{ Expression_MyMatrixContainer.SizeAlongDimension(0) };
+			std::size_t const n{ Expression_MyMatrixContainer.SizeAlongDimension(1) };
+			for (std::size_t ii = 0; ii < m; ii += tile){
+				std::size_t const iend{ ii + tile < m ? ii + tile : m };
+				for (std::size_t jj = 0; jj < n; jj += tile){
+					std::size_t const jend{ jj + tile < n ? jj + tile : n };
+					if (ColumnMajor){
+						for (std::size_t j = jj; j < jend; ++j){
+							for (std::size_t i = ii; i < iend; ++i){
+								body(i, j);
+							};
+						};
+					}
+					else{
+						for (std::size_t i = ii; i < iend; ++i){
+							for (std::size_t j = jj; j < jend; ++j){
+								body(i, j);
+							};
+						};
+					};
+				};
+			};
+		};
+
+		// Last stage of the evaluation plans (EvaluationPlanner.h): evaluation into 'this'.
+		struct Evaluator{
+			Matrix* destination;
+
+			template<typename Expression>
+			void operator()(Expression const& e) const {
+				destination->Evaluate(e);
+			};
+		};
 	public:
 		// Constructor from the sizes along each dimension.
 		template<typename... Sizes>
@@ -40,34 +176,78 @@ namespace FususMatrix{
 			: Expression_MyMatrixContainer(rb){
 		};
 
+		// Creates Matrix taking over a representation, e.g. a result computed by the container.
+		Matrix(Rep&& rb)
+			: Expression_MyMatrixContainer(std::move(rb)){
+		};
+
+		// Copy constructor.
+		Matrix(Matrix const& other)
+			: Expression_MyMatrixContainer(other.Expression_MyMatrixContainer){
+		};
+
+		// Move constructor. Takes over the data of other.
+		Matrix(Matrix&& other)
+			: Expression_MyMatrixContainer(std::move(other.Expression_MyMatrixContainer)){
+		};
+
 		// Assignment operator for the same type.
+		// O(1): the containers share the elements until one of the two matrices writes (copy-on-write).
 		Matrix& operator=(Matrix const& other){
 			assert(getSizesAlongEachDimension() == other.getSizesAlongEachDimension());
-			for (std::size_t index = 0; index < other.size(); ++index){
-				Expression_MyMatrixContainer[index] = other[index];
+			if (this != &other){
+				Expression_MyMatrixContainer = other.Expression_MyMatrixContainer;
 			};
 			return *this;
 		};
 
+		// Move assignment. Takes over the data of other, whatever its sizes.
+		Matrix& operator=(Matrix&& other){
+			Expression_MyMatrixContainer = std::move(other.Expression_MyMatrixContainer);
+			return *this;
+		};
+
 		// Assignment operator for Matrices of different types.
-		template<typename T2, std::size_t Dimension, typename Rep2>
-		Matrix& operator=(Matrix<T2, Dimension, Rep2> const& b){
+		// Expressions are planned first (see EvaluationPlanner.h): repeated operands, shared expensive nodes and
+		// algebraic simplification. Operands sharing memory with 'this' at other positions go through a temporary.
+		template<typename T2, std::size_t Dimension2, typename Rep2>
+		Matrix& operator=(Matrix<T2, Dimension2, Rep2> const& b){
 			if (size()>1 && b.size() > 1){
 				assert(getSizesAlongEachDimension() == b.getSizesAlongEachDimension());
 			};
-			for (std::size_t index = 0; index < b.size(); ++index){
-				Expression_MyMatrixContainer[index] = b[index];
+			if (SharesMemory(b.rep(), Expression_MyMatrixContainer)){
+				Matrix<T, Dimension> copy;
+				copy.rep().resize(getSizesAlongEachDimension());
+				copy = b;
+				Evaluate(copy.rep());
+				return *this;
 			};
+			Plan<T>(b.rep(), Expression_MyMatrixContainer.layout(), Evaluator{ this });
 			return *this;
 		};
 
+		// Assignment without planning, only simplified: the caller guarantees no operand shares memory with 'this'.
+		// Used through noalias(), A.noalias() = B + C.
+		template<typename T2, std::size_t Dimension2, typename Rep2>
+		Matrix& assignNoAlias(Matrix<T2, Dimension2, Rep2> const& b){
+			if (size()>1 && b.size() > 1){
+				assert(getSizesAlongEachDimension() == b.getSizesAlongEachDimension());
+			};
+			Simplify(b.rep(), Evaluator{ this });
+			return *this;
+		};
+
+		NoAliasAssignment<Matrix> noalias(){
+			return NoAliasAssignment<Matrix>(*this);
+		};
+
 		// Size returns the sizes along each dimension (a vector).
 		std::size_t size() const {
 			return Expression_MyMatrixContainer.size();
 		};
 
 		// Returns the SizesAlongEachDimension
-		const std::vector<std::size_t> getSizesAlongEachDimension() const {
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
 			return Expression_MyMatrixContainer.getSizesAlongEachDimension();
 		};
 
@@ -120,29 +300,25 @@ namespace FususMatrix{
 		};
 
 		// Compound assignment operators.
+		// They are evaluated as expressions, so operands with different layouts are combined correctly.
 		Matrix& operator+=(const Matrix& X){
 			assert(this->getSizesAlongEachDimension() == X.getSizesAlongEachDimension());
-			Expression_MyMatrixContainer += X.Expression_MyMatrixContainer;
-			return *this;
+			return *this = *this + X;
 		};
 		Matrix& operator-=(const Matrix& X){
 			assert(this->getSizesAlongEachDimension() == X.getSizesAlongEachDimension());
-			Expression_MyMatrixContainer -= X.Expression_MyMatrixContainer;
-			return *this;
+			return *this = *this - X;
 		};
 		Matrix& operator*=(const Matrix& X){
 			assert(this->getSizesAlongEachDimension() == X.getSizesAlongEachDimension());
-			Expression_MyMatrixContainer *= X.Expression_MyMatrixContainer;
-			return *this;
+			return *this = *this * X;
 		};
 		Matrix& operator*=(const T& s){
-			Expression_MyMatrixContainer *= s;
-			return *this;
+			return *this = *this * s;
 		};
 		Matrix& operator/=(const Matrix& X){
 			assert(this->getSizesAlongEachDimension() == X.getSizesAlongEachDimension());
-			Expression_MyMatrixContainer /= X.Expression_MyMatrixContainer;
-			return *this;
+			return *this = *this / X;
 		};
 
 		// Weak transpose.
@@ -155,6 +331,20 @@ namespace FususMatrix{
 			Expression_MyMatrixContainer.strongTranspose();
 		};
 
+		// Permutation of the axes, e.g. A.permute(2, 0, 1): axis k becomes the axis given in position k.
+		// Only the strides change where possible, otherwise a cache-blocked N-D transpose.
+		template<typename... Axes>
+		void permute(Axes... axes){
+			static_assert(sizeof...(Axes) == Dimension, "permute() takes one axis per dimension.");
+			Expression_MyMatrixContainer.permute({ static_cast<std::size_t>(axes)... });
+		};
+
+		// The same elements with other sizes, e.g. K.reshape(100, 60000), sharing the buffer when contiguous.
+		template<typename... Sizes>
+		Matrix<T, sizeof...(Sizes)> reshape(Sizes... sizes) const {
+			return Matrix<T, sizeof...(Sizes)>(Expression_MyMatrixContainer.template reshaped<sizeof...(Sizes)>({ static_cast<std::size_t>(sizes)... }));
+		};
+
 
 		// Accessing elements.
 		template<typename... Coordinates>
@@ -170,29 +360,94 @@ namespace FususMatrix{
 
 		// Matrix Multiplication
 		// Multiplication only for 2x2 matrices with the right sizes
-		Matrix<T, 2> Multiply(Matrix<T, 2>& secondFactor){
+		Matrix<T, 2> Multiply(Matrix<T, 2> const& secondFactor) const {
 			assert((Dimension == 2) && (columns() == secondFactor.rows()));
 			Matrix<T, 2> temp(rows(), secondFactor.columns());
 			temp.Expression_MyMatrixContainer.Multiply((*this).Expression_MyMatrixContainer, secondFactor.Expression_MyMatrixContainer);
 			return temp;
 		};
 
+		// Multiplication into an existing Matrix.
+		// result is resized only if needed, so that a loop multiplying into the same result doesn't allocate.
+		Matrix<T, 2>& Multiply(Matrix<T, 2> const& secondFactor, Matrix<T, 2>& result) const {
+			assert((Dimension == 2) && (columns() == secondFactor.rows()));
+			if (result.rows() != rows() || result.columns() != secondFactor.columns()){
+				result.rep().resize({ rows(), secondFactor.columns() });
+			};
+			result.rep().Multiply((*this).Expression_MyMatrixContainer, secondFactor.rep());
+			return result;
+		};
+
+		// Product over a semiring (Semiring.h), e.g. A.Multiply<MinPlus<double> >(B) for shortest paths.
+		template<typename Semiring>
+		Matrix<T, 2> Multiply(Matrix<T, 2> const& secondFactor) const {
+			assert((Dimension == 2) && (columns() == secondFactor.rows()));
+			Matrix<T, 2> temp(rows(), secondFactor.columns());
+			temp.Expression_MyMatrixContainer.template Multiply<Semiring>((*this).Expression_MyMatrixContainer, secondFactor.Expression_MyMatrixContainer);
+			return temp;
+		};
+		template<typename Semiring>
+		Matrix<T, 2>& Multiply(Matrix<T, 2> const& secondFactor, Matrix<T, 2>& result) const {
+			assert((Dimension == 2) && (columns() == secondFactor.rows()));
+			if (result.rows() != rows() || result.columns() != secondFactor.columns()){
+				result.rep().resize({ rows(), secondFactor.columns() });
+			};
+			result.rep().template Multiply<Semiring>((*this).Expression_MyMatrixContainer, secondFactor.rep());
+			return result;
+		};
+
 		bool IsLowerTriangular(){
 			return Expression_MyMatrixContainer.IsLowerTriangular();
 		};
 
+		// Rank-one update, 'this' += alpha x y^T (BLAS GER), for column vectors x and y.
+		Matrix& RankOneUpdate(T alpha, Matrix<T, 2> const& x, Matrix<T, 2> const& y){
+			Expression_MyMatrixContainer.RankOneUpdate(alpha, x.rep(), y.rep());
+			return *this;
+		};
+
+		// Product of the lower or upper triangle of 'this' and the vector x (BLAS TRMV), the rest read as zero.
+		Matrix TriangularMultiply(Triangle part, Matrix const& x) const {
+			Matrix y(x);
+			Expression_MyMatrixContainer.TriangularMultiply(part, x.Expression_MyMatrixContainer, y.Expression_MyMatrixContainer);
+			return y;
+		};
+
 		// Span computes coefficients for a linear combination of the columns of 'this' to obtain the vector in the input.
 		Matrix span(const Matrix& B){
-				Matrix temp(Expression_MyMatrixContainer.span(B.Expression_MyMatrixContainer));
-				return temp;
+			return Matrix(Expression_MyMatrixContainer.span(B.Expression_MyMatrixContainer));
+		};
+
+		// Span into an existing Matrix, which is resized only if needed.
+		Matrix& span(const Matrix& B, Matrix& X){
+			Expression_MyMatrixContainer.span(B.Expression_MyMatrixContainer, X.Expression_MyMatrixContainer);
+			return X;
 		};
 
+		// Makes the sizes of 'this' those of the expression, reusing the data when the number of elements is the same.
+		template<typename T2, typename Rep2>
+		void resizeLike(Matrix<T2, Dimension, Rep2> const& b){
+			std::vector<std::size_t> const& sizes{ b.getSizesAlongEachDimension() };
+			if (getSizesAlongEachDimension() != sizes){
+				Expression_MyMatrixContainer.resize(sizes);
+			};
+		};
 
 	}; // END Matrix class.
 
 	template<typename T = double>
 	using Vector = Matrix < T > ;
 
+	// Evaluates an expression into an existing Matrix.
+	// The destination is resized only when its sizes differ, and then reuses its buffer if the number of elements
+	// is the same, so hot loops don't allocate.
+	template<typename T, std::size_t Dimension, typename Rep2>
+	Matrix<T, Dimension>& evaluate_into(Matrix<T, Dimension>& destination, Matrix<T, Dimension, Rep2> const& expression){
+		destination.resizeLike(expression);
+		destination = expression;
+		return destination;
+	};
+
 	// To print two dimensional matrices. 
 	template<typename T = double, std::size_t Dimension = 2, typename Rep = DenseMatrixContainer<T, Dimension> >
 	std::ostream& operator<<(std::ostream& os, const Matrix<T, Dimension, Rep>& matrix){
@@ -216,5 +471,7 @@ namespace FususMatrix{
 }; // END namespace.
 
 #include "BinaryOperatorsForLazyEvaluation.h"
+#include "ElementWiseFunctions.h"
+#include "Reductions.h"
 
 #endif
@@ -0,0 +1,291 @@
+#ifndef _FususMatrixVectorProducts_
+#define _FususMatrixVectorProducts_
+
+#include <algorithm>
+#include <cstddef>
+
+#include "BufferPool.h"
+#include "RecursiveMultiply.h"
+#include "ThreadPool.h"
+
+namespace FususMatrix{
+
+	// Products of a matrix and a vector (the BLAS level 2), on the views of RecursiveMultiply.h:
+	//   MultiplyVector            y = alpha A x + beta y     (GEMV)
+	//   RankOneUpdate             A += alpha x y^T           (GER)
+	//   TriangularMultiplyVector  x = A x, A triangular      (TRMV)
+	//   TriangularSolveVector     x = A^-1 x, A triangular   (TRSV)
+	// Each element of A is used once, so their speed is that of reading A from memory. A is streamed along
+	// its contiguous direction, whichever it is (a weakly transposed matrix is read in place): rows are
+	// reduced with independent accumulators per lane, columns are added to a block of y kept in cache.
+	// Either way the inner loops are unit stride without dependencies between iterations, so they vectorize.
+	// Large matrices are split by rows between the workers of ThreadPool::Global().
+	// The vectors are contiguous.
+
+	enum class Triangle { Lower, Upper };
+
+	// Independent accumulators per dot product, and rows of y per task when A is read by columns.
+	const std::size_t DotLanes{ 4 };
+	const std::size_t AxpyRowBlock{ 512 };
+	// Rows of the diagonal blocks solved one element at a time by TriangularSolveVector.
+	const std::size_t TriangularSolveBlock{ 256 };
+
+	// Runs body(first, last) over the rows [0, rows) of a matrix with the given number of elements,
+	// in parallel if it is large enough.
+	template<typename Body>
+	void ForMatrixRows(std::size_t rows, std::size_t elements, std::size_t grain, Body const& body){
+		ThreadPool& pool{ ThreadPool::Global() };
+		if (elements >= ParallelElementThreshold && pool.size() > 1){
+			pool.ParallelFor(0, rows, std::max(grain, rows / (4 * pool.size())), body);
+		}
+		else{
+			body(0, rows);
+		};
+	};
+
+	// Sum of a[j] x[j] for j in [0, n).
+	template<typename T>
+	T Dot(T const* a, T const* x, std::size_t n){
+		T s[DotLanes]{};
+		std::size_t j{ 0 };
+		for (; j + DotLanes <= n; j += DotLanes){
+			for (std::size_t l = 0; l < DotLanes; ++l){
+				s[l] += a[j + l] * x[j + l];
+			};
+		};
+		for (; j < n; ++j){
+			s[0] += a[j] * x[j];
+		};
+		T sum{ 0 };
+		for (std::size_t l = 0; l < DotLanes; ++l){
+			sum += s[l];
+		};
+		return sum;
+	};
+
+	// y = alpha A x + beta y.
+	template<typename T>
+	void MultiplyVector(MatrixView<T> const& A, T const* x, T* y, T alpha = T{ 1 }, T beta = T{ 0 }){
+		std::size_t const m{ A.Rows };
+		std::size_t const n{ A.Columns };
+		// beta y, without reading y when beta is zero.
+		auto scale = [y, beta](std::size_t first, std::size_t last){
+			for (std::size_t i = first; i < last; ++i){
+				y[i] = beta == T{ 0 } ? T{ 0 } : beta * y[i];
+			};
+		};
+		if (A.ColumnStride == 1 || A.RowStride != 1){
+			// By rows, four at a time, so each element of x loaded is used four times.
+			ForMatrixRows(m, m * n, 16, [&](std::size_t first, std::size_t last){
+				scale(first, last);
+				std::size_t i{ first };
+				if (A.ColumnStride == 1){
+					for (; i + 4 <= last; i += 4){
+						T const* a0{ &A(i, 0) };
+						T const* a1{ &A(i + 1, 0) };
+						T const* a2{ &A(i + 2, 0) };
+						T const* a3{ &A(i + 3, 0) };
+						T s0[DotLanes]{};
+						T s1[DotLanes]{};
+						T s2[DotLanes]{};
+						T s3[DotLanes]{};
+						std::size_t j{ 0 };
+						for (; j + DotLanes <= n; j += DotLanes){
+							for (std::size_t l = 0; l < DotLanes; ++l){
+								T const xj{ x[j + l] };
+								s0[l] += a0[j + l] * xj;
+								s1[l] += a1[j + l] * xj;
+								s2[l] += a2[j + l] * xj;
+								s3[l] += a3[j + l] * xj;
+							};
+						};
+						for (; j < n; ++j){
+							s0[0] += a0[j] * x[j];
+							s1[0] += a1[j] * x[j];
+							s2[0] += a2[j] * x[j];
+							s3[0] += a3[j] * x[j];
+						};
+						for (std::size_t l = 1; l < DotLanes; ++l){
+							s0[0] += s0[l];
+							s1[0] += s1[l];
+							s2[0] += s2[l];
+							s3[0] += s3[l];
+						};
+						y[i] += alpha * s0[0];
+						y[i + 1] += alpha * s1[0];
+						y[i + 2] += alpha * s2[0];
+						y[i + 3] += alpha * s3[0];
+					};
+					for (; i < last; ++i){
+						y[i] += alpha * Dot(&A(i, 0), x, n);
+					};
+				}
+				else{
+					for (; i < last; ++i){
+						T s{ 0 };
+						for (std::size_t j = 0; j < n; ++j){
+							s += A(i, j) * x[j];
+						};
+						y[i] += alpha * s;
+					};
+				};
+			});
+			return;
+		};
+		// By columns (e.g. A^T x for a row-major A): the columns, four at a time, are added to a block of y.
+		ForMatrixRows(m, m * n, AxpyRowBlock, [&](std::size_t first, std::size_t last){
+			scale(first, last);
+			T* yb{ y + first };
+			std::size_t const rows{ last - first };
+			std::size_t j{ 0 };
+			for (; j + 4 <= n; j += 4){
+				T const* a0{ &A(first, j) };
+				T const* a1{ &A(first, j + 1) };
+				T const* a2{ &A(first, j + 2) };
+				T const* a3{ &A(first, j + 3) };
+				T const c0{ alpha * x[j] };
+				T const c1{ alpha * x[j + 1] };
+				T const c2{ alpha * x[j + 2] };
+				T const c3{ alpha * x[j + 3] };
+				for (std::size_t i = 0; i < rows; ++i){
+					yb[i] += c0 * a0[i] + c1 * a1[i] + c2 * a2[i] + c3 * a3[i];
+				};
+			};
+			for (; j < n; ++j){
+				T const* a{ &A(first, j) };
+				T const c{ alpha * x[j] };
+				for (std::size_t i = 0; i < rows; ++i){
+					yb[i] += c * a[i];
+				};
+			};
+		});
+	};
+
+	// A += alpha x y^T.
+	template<typename T>
+	void RankOneUpdate(MatrixView<T> const& A, T alpha, T const* x, T const* y){
+		std::size_t const m{ A.Rows };
+		std::size_t const n{ A.Columns };
+		if (A.RowStride == 1 && A.ColumnStride != 1){
+			// By columns, on the transpose.
+			RankOneUpdate(A.transposed(), alpha, y, x);
+			return;
+		};
+		ForMatrixRows(m, m * n, 16, [&](std::size_t first, std::size_t last){
+			for (std::size_t i = first; i < last; ++i){
+				T const c{ alpha * x[i] };
+				if (A.ColumnStride == 1){
+					T* a{ &A(i, 0) };
+					for (std::size_t j = 0; j < n; ++j){
+						a[j] += c * y[j];
+					};
+				}
+				else{
+					for (std::size_t j = 0; j < n; ++j){
+						A(i, j) += c * y[j];
+					};
+				};
+			};
+		});
+	};
+
+	// x = A x, with A the lower or upper triangle of a square view.
+	// Computed into a buffer of BufferPool<T>::Global(), so that the rows are independent.
+	template<typename T>
+	void TriangularMultiplyVector(MatrixView<T> const& A, Triangle part, T* x){
+		std::size_t const n{ A.Rows };
+		ScratchBuffer<T> buffer{ BufferPool<T>::Global().Acquire(n) };
+		T* y{ buffer.data() };
+		bool const lower{ part == Triangle::Lower };
+		if (A.ColumnStride == 1 || A.RowStride != 1){
+			// Row i is the dot product of its part in the triangle with x. The small grain balances the rows.
+			ForMatrixRows(n, n * n / 2, 16, [&](std::size_t first, std::size_t last){
+				for (std::size_t i = first; i < last; ++i){
+					std::size_t const j0{ lower ? 0 : i };
+					std::size_t const j1{ lower ? i + 1 : n };
+					if (A.ColumnStride == 1){
+						y[i] = Dot(&A(i, j0), x + j0, j1 - j0);
+					}
+					else{
+						T s{ 0 };
+						for (std::size_t j = j0; j < j1; ++j){
+							s += A(i, j) * x[j];
+						};
+						y[i] = s;
+					};
+				};
+			});
+		}
+		else{
+			// By columns: the part of each column in the triangle and in the block of rows is added to it.
+			ForMatrixRows(n, n * n / 2, AxpyRowBlock, [&](std::size_t first, std::size_t last){
+				std::fill(y + first, y + last, T{ 0 });
+				std::size_t const j0{ lower ? 0 : first };
+				std::size_t const j1{ lower ? last : n };
+				for (std::size_t j = j0; j < j1; ++j){
+					std::size_t const i0{ lower ? std::max(first, j) : first };
+					std::size_t const i1{ lower ? last : std::min(last, j + 1) };
+					T const* a{ &A(0, j) };
+					T const c{ x[j] };
+					for (std::size_t i = i0; i < i1; ++i){
+						y[i] += c * a[i];
+					};
+				};
+			});
+		};
+		std::copy(y, y + n, x);
+	};
+
+	// x = A^-1 x, with A the lower or upper triangle of a square view (substitution); with a unit diagonal,
+	// the diagonal isn't read (as for the L of an LU factorization stored with U).
+	// Blocked: each diagonal block is solved element by element, then its part of the solution is removed from
+	// the remaining elements of x with MultiplyVector, so nearly all of the work is in the parallel GEMV.
+	template<typename T>
+	void TriangularSolveVector(MatrixView<T> const& A, Triangle part, T* x, bool unitDiagonal = false){
+		std::size_t const n{ A.Rows };
+		std::size_t const b{ TriangularSolveBlock };
+		// Diagonal block of rows and columns [k0, k1).
+		auto diagonal = [&A, x, part, unitDiagonal](std::size_t k0, std::size_t k1){
+			if (part == Triangle::Lower){
+				for (std::size_t i = k0; i < k1; ++i){
+					T s{ x[i] };
+					for (std::size_t j = k0; j < i; ++j){
+						s -= A(i, j) * x[j];
+					};
+					x[i] = unitDiagonal ? s : s / A(i, i);
+				};
+			}
+			else{
+				for (std::size_t i = k1; i > k0; --i){
+					T s{ x[i - 1] };
+					for (std::size_t j = i; j < k1; ++j){
+						s -= A(i - 1, j) * x[j];
+					};
+					x[i - 1] = unitDiagonal ? s : s / A(i - 1, i - 1);
+				};
+			};
+		};
+		if (part == Triangle::Lower){
+			for (std::size_t k0 = 0; k0 < n; k0 += b){
+				std::size_t const k1{ std::min(n, k0 + b) };
+				diagonal(k0, k1);
+				if (k1 < n){
+					MultiplyVector(A.block(k1, k0, n - k1, k1 - k0), x + k0, x + k1, T{ -1 }, T{ 1 });
+				};
+			};
+		}
+		else{
+			for (std::size_t k1 = n; k1 > 0;){
+				std::size_t const k0{ k1 > b ? k1 - b : 0 };
+				diagonal(k0, k1);
+				if (k0 > 0){
+					MultiplyVector(A.block(0, k0, k0, k1 - k0), x + k0, x, T{ -1 }, T{ 1 });
+				};
+				k1 = k0;
+			};
+		};
+	};
+	//
+}// END namespace FususMatrix
+
+#endif
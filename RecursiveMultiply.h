@@ -0,0 +1,311 @@
+#ifndef _FususRecursiveMultiply_
+#define _FususRecursiveMultiply_
+
+#include <cstddef>
+
+#include "BufferPool.h"
+#include "Semiring.h"
+#include "ThreadPool.h"
+
+namespace FususMatrix{
+
+	// A 2-D block of elements in memory, element (i, j) at Data[i * RowStride + j * ColumnStride].
+	// Used by the multiplication kernels to address the quadrants of the operands without copying them.
+	template<typename T>
+	struct MatrixView{
+		T* Data;
+		std::size_t Rows;
+		std::size_t Columns;
+		std::size_t RowStride;
+		std::size_t ColumnStride;
+
+		T& operator()(std::size_t i, std::size_t j) const {
+			return Data[i * RowStride + j * ColumnStride];
+		};
+
+		// The rows x columns block starting at element (i, j).
+		MatrixView block(std::size_t i, std::size_t j, std::size_t rows, std::size_t columns) const {
+			return MatrixView{ Data + i * RowStride + j * ColumnStride, rows, columns, RowStride, ColumnStride };
+		};
+
+		// The transpose, on the same elements.
+		MatrixView transposed() const {
+			return MatrixView{ Data, Columns, Rows, ColumnStride, RowStride };
+		};
+	};
+
+	// Settings of the multiplication of dense matrices.
+	// LeafSize: the recursion stops once m, n and k are all at most this; the leaf kernel then works in L1/L2.
+	// StrassenCrossover: Strassen-Winograd is used while m, n and k are all larger than this. Zero disables it.
+	// It does 7 products of half size instead of 8, so it's faster for large matrices, but its error bound grows
+	// with the depth of the recursion (normwise instead of elementwise), which is why it is off by default.
+	// On an AVX2 machine a crossover of 128 made 2048 x 2048 products 1.7x faster than the recursion alone.
+	// ParallelWork: products with fewer than this many multiply-adds are not split between workers.
+	struct MultiplySettings{
+		std::size_t LeafSize;
+		std::size_t StrassenCrossover;
+		std::size_t ParallelWork;
+	};
+
+	inline MultiplySettings& GlobalMultiplySettings(){
+		static MultiplySettings settings{ 64, 0, std::size_t{ 1 } << 21 };
+		return settings;
+	};
+
+	// C += A * B for blocks that fit in cache, + and * being those of the semiring S (Semiring.h).
+	// With C and B contiguous along rows (or C and A along columns) the innermost loop is unit stride and vectorizes,
+	// and four rows (columns) of C are updated per pass over B (A), so each element loaded is used four times.
+	template<typename T, typename S = PlusTimes<T> >
+	void LeafMultiplyAdd(MatrixView<T> const& A, MatrixView<T> const& B, MatrixView<T> const& C){
+		std::size_t const m{ C.Rows };
+		std::size_t const n{ C.Columns };
+		std::size_t const k{ A.Columns };
+		if (C.ColumnStride == 1 && B.ColumnStride == 1){
+			std::size_t i{ 0 };
+			for (; i + 4 <= m; i += 4){
+				T* c0{ C.Data + i * C.RowStride };
+				T* c1{ c0 + C.RowStride };
+				T* c2{ c1 + C.RowStride };
+				T* c3{ c2 + C.RowStride };
+				for (std::size_t p = 0; p < k; ++p){
+					T const a0{ A(i, p) };
+					T const a1{ A(i + 1, p) };
+					T const a2{ A(i + 2, p) };
+					T const a3{ A(i + 3, p) };
+					T const* b{ B.Data + p * B.RowStride };
+					for (std::size_t j = 0; j < n; ++j){
+						T const bj{ b[j] };
+						c0[j] = S::Add(c0[j], S::Multiply(a0, bj));
+						c1[j] = S::Add(c1[j], S::Multiply(a1, bj));
+						c2[j] = S::Add(c2[j], S::Multiply(a2, bj));
+						c3[j] = S::Add(c3[j], S::Multiply(a3, bj));
+					};
+				};
+			};
+			for (; i < m; ++i){
+				T* c{ C.Data + i * C.RowStride };
+				for (std::size_t p = 0; p < k; ++p){
+					T const a{ A(i, p) };
+					T const* b{ B.Data + p * B.RowStride };
+					for (std::size_t j = 0; j < n; ++j){
+						c[j] = S::Add(c[j], S::Multiply(a, b[j]));
+					};
+				};
+			};
+		}
+		else if (C.RowStride == 1 && A.RowStride == 1){
+			std::size_t j{ 0 };
+			for (; j + 4 <= n; j += 4){
+				T* c0{ C.Data + j * C.ColumnStride };
+				T* c1{ c0 + C.ColumnStride };
+				T* c2{ c1 + C.ColumnStride };
+				T* c3{ c2 + C.ColumnStride };
+				for (std::size_t p = 0; p < k; ++p){
+					T const b0{ B(p, j) };
+					T const b1{ B(p, j + 1) };
+					T const b2{ B(p, j + 2) };
+					T const b3{ B(p, j + 3) };
+					T const* a{ A.Data + p * A.ColumnStride };
+					for (std::size_t i = 0; i < m; ++i){
+						T const ai{ a[i] };
+						c0[i] = S::Add(c0[i], S::Multiply(ai, b0));
+						c1[i] = S::Add(c1[i], S::Multiply(ai, b1));
+						c2[i] = S::Add(c2[i], S::Multiply(ai, b2));
+						c3[i] = S::Add(c3[i], S::Multiply(ai, b3));
+					};
+				};
+			};
+			for (; j < n; ++j){
+				T* c{ C.Data + j * C.ColumnStride };
+				for (std::size_t p = 0; p < k; ++p){
+					T const b{ B(p, j) };
+					T const* a{ A.Data + p * A.ColumnStride };
+					for (std::size_t i = 0; i < m; ++i){
+						c[i] = S::Add(c[i], S::Multiply(a[i], b));
+					};
+				};
+			};
+		}
+		else{
+			for (std::size_t i = 0; i < m; ++i){
+				for (std::size_t p = 0; p < k; ++p){
+					T const a{ A(i, p) };
+					for (std::size_t j = 0; j < n; ++j){
+						C(i, j) = S::Add(C(i, j), S::Multiply(a, B(p, j)));
+					};
+				};
+			};
+		};
+	};
+
+	// Cache-oblivious C += A * B.
+	// Like the strong transposition, the problem is halved along its largest dimension (m, n or k) until it fits
+	// the leaf kernel, so every level of the memory hierarchy is used in blocks of its own size without knowing it.
+	// Halving m or n gives independent halves of C, which run in parallel on ThreadPool::Global().
+	// Only the associativity of the semiring's + is needed, so the same recursion serves any semiring.
+	template<typename T, typename S = PlusTimes<T> >
+	void RecursiveMultiplyAdd(MatrixView<T> const& A, MatrixView<T> const& B, MatrixView<T> const& C){
+		MultiplySettings const& settings{ GlobalMultiplySettings() };
+		std::size_t const m{ C.Rows };
+		std::size_t const n{ C.Columns };
+		std::size_t const k{ A.Columns };
+		if (m == 0 || n == 0 || k == 0){
+			return;
+		};
+		if (m <= settings.LeafSize && n <= settings.LeafSize && k <= settings.LeafSize){
+			LeafMultiplyAdd<T, S>(A, B, C);
+			return;
+		};
+		bool const parallel{ m * n * k >= settings.ParallelWork && ThreadPool::Global().size() > 1 };
+		if (m >= n && m >= k){
+			std::size_t const h{ m / 2 };
+			auto first = [&]{ RecursiveMultiplyAdd<T, S>(A.block(0, 0, h, k), B, C.block(0, 0, h, n)); };
+			auto second = [&]{ RecursiveMultiplyAdd<T, S>(A.block(h, 0, m - h, k), B, C.block(h, 0, m - h, n)); };
+			if (parallel){
+				ThreadPool::Global().Invoke(first, second);
+			}
+			else{
+				first();
+				second();
+			};
+		}
+		else if (n >= k){
+			std::size_t const h{ n / 2 };
+			auto first = [&]{ RecursiveMultiplyAdd<T, S>(A, B.block(0, 0, k, h), C.block(0, 0, m, h)); };
+			auto second = [&]{ RecursiveMultiplyAdd<T, S>(A, B.block(0, h, k, n - h), C.block(0, h, m, n - h)); };
+			if (parallel){
+				ThreadPool::Global().Invoke(first, second);
+			}
+			else{
+				first();
+				second();
+			};
+		}
+		else{
+			// Both halves update all of C, so they run one after the other.
+			std::size_t const h{ k / 2 };
+			RecursiveMultiplyAdd<T, S>(A.block(0, 0, m, h), B.block(0, 0, h, n), C);
+			RecursiveMultiplyAdd<T, S>(A.block(0, h, m, k - h), B.block(h, 0, k - h, n), C);
+		};
+	};
+
+	// D = f(E, F) element by element.
+	template<typename T, typename Function>
+	void CombineBlocks(MatrixView<T> const& D, MatrixView<T> const& E, MatrixView<T> const& F, Function const& f){
+		for (std::size_t i = 0; i < D.Rows; ++i){
+			if (D.ColumnStride == 1 && E.ColumnStride == 1 && F.ColumnStride == 1){
+				T* d{ D.Data + i * D.RowStride };
+				T const* e{ E.Data + i * E.RowStride };
+				T const* g{ F.Data + i * F.RowStride };
+				for (std::size_t j = 0; j < D.Columns; ++j){
+					d[j] = f(e[j], g[j]);
+				};
+			}
+			else{
+				for (std::size_t j = 0; j < D.Columns; ++j){
+					D(i, j) = f(E(i, j), F(i, j));
+				};
+			};
+		};
+	};
+
+	// D = the zero of the semiring S.
+	template<typename T, typename S = PlusTimes<T> >
+	void ZeroBlock(MatrixView<T> const& D){
+		for (std::size_t i = 0; i < D.Rows; ++i){
+			for (std::size_t j = 0; j < D.Columns; ++j){
+				D(i, j) = S::Zero();
+			};
+		};
+	};
+
+	// C = A * B, cache-oblivious, over the semiring S.
+	template<typename T, typename S = PlusTimes<T> >
+	void RecursiveMultiply(MatrixView<T> const& A, MatrixView<T> const& B, MatrixView<T> const& C){
+		ZeroBlock<T, S>(C);
+		RecursiveMultiplyAdd<T, S>(A, B, C);
+	};
+
+	// C = A * B with the Strassen-Winograd algorithm (7 products, 15 additions per level) above the crossover,
+	// and the cache-oblivious multiplication below it.
+	// Odd sizes are handled by peeling the last row / column / inner index off and adding it afterwards.
+	// The products are scheduled as in Boyer, Dumas, Pernet and Zhou, "Memory efficient scheduling of
+	// Strassen-Winograd's matrix multiplication algorithm" (2009), which only needs two temporaries per level
+	// besides C, of sizes m/2 x max(k/2, n/2) and k/2 x n/2. They are borrowed from BufferPool<T>::Global().
+	template<typename T>
+	void StrassenMultiply(MatrixView<T> const& A, MatrixView<T> const& B, MatrixView<T> const& C){
+		std::size_t const crossover{ GlobalMultiplySettings().StrassenCrossover };
+		std::size_t const m{ C.Rows };
+		std::size_t const n{ C.Columns };
+		std::size_t const k{ A.Columns };
+		if (crossover == 0 || m <= crossover || n <= crossover || k <= crossover){
+			RecursiveMultiply(A, B, C);
+			return;
+		};
+		std::size_t const m2{ m / 2 };
+		std::size_t const n2{ n / 2 };
+		std::size_t const k2{ k / 2 };
+		ScratchBuffer<T> xBuffer{ BufferPool<T>::Global().Acquire(m2 * (k2 > n2 ? k2 : n2)) };
+		ScratchBuffer<T> yBuffer{ BufferPool<T>::Global().Acquire(k2 * n2) };
+		// X holds the sums of blocks of A (m2 x k2), then the product P1 (m2 x n2).
+		MatrixView<T> const XA{ xBuffer.data(), m2, k2, k2, 1 };
+		MatrixView<T> const XC{ xBuffer.data(), m2, n2, n2, 1 };
+		// Y holds the sums of blocks of B.
+		MatrixView<T> const Y{ yBuffer.data(), k2, n2, n2, 1 };
+		MatrixView<T> const A11{ A.block(0, 0, m2, k2) };
+		MatrixView<T> const A12{ A.block(0, k2, m2, k2) };
+		MatrixView<T> const A21{ A.block(m2, 0, m2, k2) };
+		MatrixView<T> const A22{ A.block(m2, k2, m2, k2) };
+		MatrixView<T> const B11{ B.block(0, 0, k2, n2) };
+		MatrixView<T> const B12{ B.block(0, n2, k2, n2) };
+		MatrixView<T> const B21{ B.block(k2, 0, k2, n2) };
+		MatrixView<T> const B22{ B.block(k2, n2, k2, n2) };
+		MatrixView<T> const C11{ C.block(0, 0, m2, n2) };
+		MatrixView<T> const C12{ C.block(0, n2, m2, n2) };
+		MatrixView<T> const C21{ C.block(m2, 0, m2, n2) };
+		MatrixView<T> const C22{ C.block(m2, n2, m2, n2) };
+		auto plus = [](T x, T y){ return x + y; };
+		auto minus = [](T x, T y){ return x - y; };
+		CombineBlocks(XA, A11, A21, minus);   // S3 = A11 - A21
+		CombineBlocks(Y, B22, B12, minus);    // T3 = B22 - B12
+		StrassenMultiply(XA, Y, C21);         // P7 = S3 T3
+		CombineBlocks(XA, A21, A22, plus);    // S1 = A21 + A22
+		CombineBlocks(Y, B12, B11, minus);    // T1 = B12 - B11
+		StrassenMultiply(XA, Y, C22);         // P5 = S1 T1
+		CombineBlocks(Y, B22, Y, minus);      // T2 = B22 - T1
+		CombineBlocks(XA, XA, A11, minus);    // S2 = S1 - A11
+		StrassenMultiply(XA, Y, C12);         // P6 = S2 T2
+		CombineBlocks(XA, A12, XA, minus);    // S4 = A12 - S2
+		StrassenMultiply(XA, B22, C11);       // P3 = S4 B22
+		StrassenMultiply(A11, B11, XC);       // P1 = A11 B11
+		CombineBlocks(C12, XC, C12, plus);    // U2 = P1 + P6
+		CombineBlocks(C21, C12, C21, plus);   // U3 = U2 + P7
+		CombineBlocks(C12, C12, C22, plus);   // U4 = U2 + P5
+		CombineBlocks(C22, C21, C22, plus);   // U7 = U3 + P5 = C22
+		CombineBlocks(C12, C12, C11, plus);   // U5 = U4 + P3 = C12
+		CombineBlocks(Y, Y, B21, minus);      // T4 = T2 - B21
+		StrassenMultiply(A22, Y, C11);        // P4 = A22 T4
+		CombineBlocks(C21, C21, C11, minus);  // U6 = U3 - P4 = C21
+		StrassenMultiply(A12, B21, C11);      // P2 = A12 B21
+		CombineBlocks(C11, XC, C11, plus);    // U1 = P1 + P2 = C11
+		// Peeled parts.
+		if (k > 2 * k2){
+			RecursiveMultiplyAdd(A.block(0, 2 * k2, 2 * m2, 1), B.block(2 * k2, 0, 1, 2 * n2), C.block(0, 0, 2 * m2, 2 * n2));
+		};
+		if (n > 2 * n2){
+			RecursiveMultiply(A, B.block(0, 2 * n2, k, 1), C.block(0, 2 * n2, m, 1));
+		};
+		if (m > 2 * m2){
+			RecursiveMultiply(A.block(2 * m2, 0, 1, k), B.block(0, 0, k, 2 * n2), C.block(2 * m2, 0, 1, 2 * n2));
+		};
+	};
+
+	// C = A * B, with the algorithm chosen by GlobalMultiplySettings().
+	template<typename T>
+	void MultiplyBlocks(MatrixView<T> const& A, MatrixView<T> const& B, MatrixView<T> const& C){
+		StrassenMultiply(A, B, C);
+	};
+	//
+}// END namespace FususMatrix
+
+#endif
@@ -0,0 +1,293 @@
+#ifndef _FususReductions_
+#define _FususReductions_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include "BufferPool.h"
+#include "ThreadPool.h"
+
+namespace FususMatrix{
+
+	// Reductions of Matrices and expressions to a scalar.
+	// The operands are read in storage order, so they must share their layout (e.g. vectors).
+	// Large operands are split in one block per worker of ThreadPool::Global(), and the partial results are added
+	// in block order, so the result only depends on the number of workers.
+
+	// Sum of the products of the elements of a and b (inner product of vectors).
+	template<typename T, std::size_t Dimension, typename R1, typename R2>
+	T dot(Matrix<T, Dimension, R1> const& a, Matrix<T, Dimension, R2> const& b){
+		assert(a.size() == b.size());
+		R1 const& x{ a.rep() };
+		R2 const& y{ b.rep() };
+		std::size_t const n{ a.size() };
+		auto partial = [&x, &y](std::size_t first, std::size_t last){
+			T sum{ 0 };
+			for (std::size_t i = first; i < last; ++i){
+				sum += x[i] * y[i];
+			};
+			return sum;
+		};
+		ThreadPool& pool{ ThreadPool::Global() };
+		if (n < ParallelElementThreshold || pool.size() == 1){
+			return partial(0, n);
+		};
+		std::size_t const parts{ pool.size() };
+		std::vector<T> sums(parts);
+		pool.ParallelFor(0, parts, 1, [&sums, &partial, n, parts](std::size_t first, std::size_t last){
+			for (std::size_t k = first; k < last; ++k){
+				sums[k] = partial(k * n / parts, (k + 1) * n / parts);
+			};
+		});
+		return std::accumulate(sums.begin(), sums.end(), T{ 0 });
+	};
+
+	// Euclidean (Frobenius) norm.
+	template<typename T, std::size_t Dimension, typename R>
+	T norm2(Matrix<T, Dimension, R> const& a){
+		return std::sqrt(dot(a, a));
+	};
+
+	// Reductions along axes.
+	// sum, mean, minimum, maximum and norm2 over a subset of the axes of an N-D Matrix, e.g. sum(K, { 0, 2 }).
+	// The reduced axes are kept with size one, and reshape() drops them without copying.
+	// The contiguous axis of the operand is the innermost loop: when it is kept, a chunk of it is accumulated
+	// element-wise over the reduced axes, otherwise runs of it are reduced with independent accumulators.
+	// The other axes are split between the workers; when they are too few, the reduced axes are split too and
+	// the partial results combined in block order, so the result only depends on the number of workers.
+
+	// Elements of the contiguous axis accumulated at once by a task.
+	const std::size_t ReductionChunk{ 512 };
+
+	// The operations: Map applied to each element, then Combine (associative, commutative, with unit Identity),
+	// then Finish, given the number of elements combined.
+	template<typename T>
+	struct SumReduction{
+		static T Identity(){
+			return T{ 0 };
+		};
+		static T Map(T x){
+			return x;
+		};
+		static T Combine(T x, T y){
+			return x + y;
+		};
+		static T Finish(T x, std::size_t){
+			return x;
+		};
+	};
+	template<typename T>
+	struct MeanReduction : SumReduction<T>{
+		static T Finish(T x, std::size_t count){
+			return x / static_cast<T>(count);
+		};
+	};
+	template<typename T>
+	struct MinimumReduction : SumReduction<T>{
+		static T Identity(){
+			return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+		};
+		static T Combine(T x, T y){
+			return y < x ? y : x;
+		};
+	};
+	template<typename T>
+	struct MaximumReduction : SumReduction<T>{
+		static T Identity(){
+			return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+		};
+		static T Combine(T x, T y){
+			return y > x ? y : x;
+		};
+	};
+	template<typename T>
+	struct Norm2Reduction : SumReduction<T>{
+		static T Map(T x){
+			return x * x;
+		};
+		static T Finish(T x, std::size_t){
+			return std::sqrt(x);
+		};
+	};
+
+	// The elements of the operand: those of a Matrix (an O(1) copy-on-write copy), or an expression evaluated.
+	template<typename T, std::size_t Dimension>
+	DenseMatrixContainer<T, Dimension> ReductionOperand(Matrix<T, Dimension> const& a){
+		return a.rep();
+	};
+	template<typename T, std::size_t Dimension, typename R>
+	DenseMatrixContainer<T, Dimension> ReductionOperand(Matrix<T, Dimension, R> const& a){
+		Matrix<T, Dimension> evaluated;
+		evaluated.rep().resize(a.getSizesAlongEachDimension());
+		evaluated = a;
+		return evaluated.rep();
+	};
+
+	// Offset of the index-th combination of the coordinates along the given axes (the last varying fastest).
+	inline std::size_t AxesOffset(std::size_t index, std::vector<std::size_t> const& axes, std::vector<std::size_t> const& sizes,
+		std::vector<std::size_t> const& strides){
+		std::size_t offset{ 0 };
+		for (std::size_t k = axes.size(); k > 0; --k){
+			offset += index % sizes[axes[k - 1]] * strides[axes[k - 1]];
+			index /= sizes[axes[k - 1]];
+		};
+		return offset;
+	};
+
+	template<typename Operation, typename T, std::size_t Dimension>
+	Matrix<T, Dimension> ReduceAlong(DenseMatrixContainer<T, Dimension> const& a, std::vector<std::size_t> const& axes){
+		static_assert(!std::is_same<T, bool>::value, "Reductions along axes are for numeric elements.");
+		static_assert(Dimension > 0, "Reductions along axes need axes.");
+		std::vector<std::size_t> const sizes{ a.getSizesAlongEachDimension() };
+		std::vector<std::size_t> const& strides{ a.getStrides() };
+		std::vector<bool> reduced(Dimension, false);
+		for (auto axis : axes){
+			assert(axis < Dimension);
+			reduced[axis] = true;
+		};
+		std::vector<std::size_t> resultSizes{ sizes };
+		for (std::size_t k = 0; k < Dimension; ++k){
+			if (reduced[k]){
+				resultSizes[k] = 1;
+			};
+		};
+		Matrix<T, Dimension> result;
+		result.rep().resize(resultSizes);
+		// The contiguous axis c, and the kept and reduced axes other than c.
+		std::size_t c{ Dimension - 1 };
+		for (std::size_t k = 0; k < Dimension; ++k){
+			if (sizes[k] > 1 && (sizes[c] == 1 || strides[k] < strides[c])){
+				c = k;
+			};
+		};
+		std::vector<std::size_t> kept;
+		std::vector<std::size_t> across;
+		std::size_t lines{ 1 };
+		std::size_t combinations{ 1 };
+		for (std::size_t k = 0; k < Dimension; ++k){
+			if (k != c){
+				(reduced[k] ? across : kept).push_back(k);
+				(reduced[k] ? combinations : lines) *= sizes[k];
+			};
+		};
+		std::size_t const n{ sizes[c] };
+		std::size_t const stride{ strides[c] };
+		bool const keep{ !reduced[c] };
+		std::size_t const count{ combinations * (keep ? 1 : n) };
+		std::size_t const width{ keep ? n : 1 }; // Partial results per line.
+		std::size_t const chunks{ keep ? (n + ReductionChunk - 1) / ReductionChunk : 1 };
+		// Tasks: (part of the reduced combinations, line, chunk of the contiguous axis).
+		ThreadPool& pool{ ThreadPool::Global() };
+		bool const parallel{ a.size() >= ParallelElementThreshold && pool.size() > 1 };
+		std::size_t const parts{ parallel && lines * chunks < pool.size() ? std::min(pool.size(), combinations) : 1 };
+		ScratchBuffer<T> partials{ BufferPool<T>::Global().Acquire(parts * lines * width) };
+		T const* data{ a.data() };
+		T* partial{ partials.data() };
+		auto task = [&](std::size_t first, std::size_t last){
+			T acc[ReductionChunk];
+			for (std::size_t t = first; t < last; ++t){
+				std::size_t const part{ t / (lines * chunks) };
+				std::size_t const line{ t / chunks % lines };
+				std::size_t const j0{ t % chunks * ReductionChunk };
+				std::size_t const j1{ keep ? std::min(n, j0 + ReductionChunk) : n };
+				std::size_t const base{ AxesOffset(line, kept, sizes, strides) };
+				std::size_t const m0{ part * combinations / parts };
+				std::size_t const m1{ (part + 1) * combinations / parts };
+				if (keep){
+					std::fill(acc, acc + (j1 - j0), Operation::Identity());
+					for (std::size_t m = m0; m < m1; ++m){
+						T const* p{ data + base + AxesOffset(m, across, sizes, strides) + j0 * stride };
+						if (stride == 1){
+							for (std::size_t j = 0; j < j1 - j0; ++j){
+								acc[j] = Operation::Combine(acc[j], Operation::Map(p[j]));
+							};
+						}
+						else{
+							for (std::size_t j = 0; j < j1 - j0; ++j){
+								acc[j] = Operation::Combine(acc[j], Operation::Map(p[j * stride]));
+							};
+						};
+					};
+					std::copy(acc, acc + (j1 - j0), partial + (part * lines + line) * width + j0);
+				}
+				else{
+					// Four independent accumulators, so that the combinations pipeline and vectorize.
+					T r[4]{ Operation::Identity(), Operation::Identity(), Operation::Identity(), Operation::Identity() };
+					for (std::size_t m = m0; m < m1; ++m){
+						T const* p{ data + base + AxesOffset(m, across, sizes, strides) };
+						std::size_t j{ 0 };
+						for (; j + 4 <= n; j += 4){
+							r[0] = Operation::Combine(r[0], Operation::Map(p[j * stride]));
+							r[1] = Operation::Combine(r[1], Operation::Map(p[(j + 1) * stride]));
+							r[2] = Operation::Combine(r[2], Operation::Map(p[(j + 2) * stride]));
+							r[3] = Operation::Combine(r[3], Operation::Map(p[(j + 3) * stride]));
+						};
+						for (; j < n; ++j){
+							r[0] = Operation::Combine(r[0], Operation::Map(p[j * stride]));
+						};
+					};
+					partial[part * lines + line] = Operation::Combine(Operation::Combine(r[0], r[1]), Operation::Combine(r[2], r[3]));
+				};
+			};
+		};
+		std::size_t const tasks{ parts * lines * chunks };
+		if (parallel){
+			std::size_t const work{ std::max<std::size_t>(1, count / parts * (keep ? std::min(n, ReductionChunk) : 1)) };
+			pool.ParallelFor(0, tasks, std::max<std::size_t>(1, ParallelElementThreshold / 16 / work), task);
+		}
+		else{
+			task(0, tasks);
+		};
+		// The partial results combined in order, into the result.
+		T* out{ result.rep().data() };
+		std::vector<std::size_t> const& resultStrides{ result.rep().getStrides() };
+		std::size_t const outStride{ keep ? resultStrides[c] : 0 };
+		for (std::size_t line = 0; line < lines; ++line){
+			std::size_t const base{ AxesOffset(line, kept, resultSizes, resultStrides) };
+			for (std::size_t j = 0; j < width; ++j){
+				T x{ partial[line * width + j] };
+				for (std::size_t part = 1; part < parts; ++part){
+					x = Operation::Combine(x, partial[(part * lines + line) * width + j]);
+				};
+				out[base + j * outStride] = Operation::Finish(x, count);
+			};
+		};
+		return result;
+	};
+
+	// Sum of the elements along the given axes.
+	template<typename T, std::size_t Dimension, typename R>
+	Matrix<T, Dimension> sum(Matrix<T, Dimension, R> const& a, std::vector<std::size_t> const& axes){
+		return ReduceAlong<SumReduction<T> >(ReductionOperand(a), axes);
+	};
+
+	// Mean of the elements along the given axes.
+	template<typename T, std::size_t Dimension, typename R>
+	Matrix<T, Dimension> mean(Matrix<T, Dimension, R> const& a, std::vector<std::size_t> const& axes){
+		return ReduceAlong<MeanReduction<T> >(ReductionOperand(a), axes);
+	};
+
+	// Smallest element along the given axes (min() is the element-wise minimum).
+	template<typename T, std::size_t Dimension, typename R>
+	Matrix<T, Dimension> minimum(Matrix<T, Dimension, R> const& a, std::vector<std::size_t> const& axes){
+		return ReduceAlong<MinimumReduction<T> >(ReductionOperand(a), axes);
+	};
+
+	// Largest element along the given axes (max() is the element-wise maximum).
+	template<typename T, std::size_t Dimension, typename R>
+	Matrix<T, Dimension> maximum(Matrix<T, Dimension, R> const& a, std::vector<std::size_t> const& axes){
+		return ReduceAlong<MaximumReduction<T> >(ReductionOperand(a), axes);
+	};
+
+	// Euclidean norm along the given axes.
+	template<typename T, std::size_t Dimension, typename R>
+	Matrix<T, Dimension> norm2(Matrix<T, Dimension, R> const& a, std::vector<std::size_t> const& axes){
+		return ReduceAlong<Norm2Reduction<T> >(ReductionOperand(a), axes);
+	};
+	//
+}// END namespace FususMatrix
+
+#endif
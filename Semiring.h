@@ -0,0 +1,109 @@
+#ifndef _FususSemiring_
+#define _FususSemiring_
+
+#include <limits>
+
+namespace FususMatrix{
+
+	// Semirings for the matrix products of RecursiveMultiply.h: C(i, j) = Add over p of Multiply(A(i, p), B(p, j)),
+	// starting from Zero. A semiring is any type with these static members (One being the unit of Multiply):
+	//   static T Zero();  static T One();  static T Add(T x, T y);  static T Multiply(T x, T y);
+	// Add must be associative and commutative with unit Zero, Multiply associative with unit One and distribute
+	// over Add, and Zero must annihilate: Multiply(Zero, x) == Zero. The products then don't depend on how
+	// the recursion splits the sums. They are written as selects rather than branches, so the kernels vectorize.
+
+	// The ordinary product.
+	template<typename T = double>
+	struct PlusTimes{
+		typedef T Value;
+		static T Zero(){
+			return T{ 0 };
+		};
+		static T One(){
+			return T{ 1 };
+		};
+		static T Add(T x, T y){
+			return x + y;
+		};
+		static T Multiply(T x, T y){
+			return x * y;
+		};
+	};
+
+	// Tropical (min, +): shortest paths. Zero is +infinity (the largest value for types without one,
+	// with which the sums saturate, so that integer weights don't overflow).
+	template<typename T = double>
+	struct MinPlus{
+		typedef T Value;
+		static T Zero(){
+			return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+		};
+		static T One(){
+			return T{ 0 };
+		};
+		static T Add(T x, T y){
+			return y < x ? y : x;
+		};
+		static T Multiply(T x, T y){
+			return std::numeric_limits<T>::has_infinity || (x != Zero() && y != Zero()) ? x + y : Zero();
+		};
+	};
+
+	// Tropical (max, +): longest / critical paths. Zero is -infinity (the lowest value for types without one).
+	template<typename T = double>
+	struct MaxPlus{
+		typedef T Value;
+		static T Zero(){
+			return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+		};
+		static T One(){
+			return T{ 0 };
+		};
+		static T Add(T x, T y){
+			return y > x ? y : x;
+		};
+		static T Multiply(T x, T y){
+			return std::numeric_limits<T>::has_infinity || (x != Zero() && y != Zero()) ? x + y : Zero();
+		};
+	};
+
+	// (max, *) on non-negative values: most reliable paths (products of probabilities).
+	template<typename T = double>
+	struct MaxTimes{
+		typedef T Value;
+		static T Zero(){
+			return T{ 0 };
+		};
+		static T One(){
+			return T{ 1 };
+		};
+		static T Add(T x, T y){
+			return y > x ? y : x;
+		};
+		static T Multiply(T x, T y){
+			return x * y;
+		};
+	};
+
+	// Boolean (or, and): reachability. On elements of any integral type holding 0 or 1; the bit-packed
+	// products of BitMatrix (GraphProducts.h) do 64 elements per operation.
+	template<typename T = unsigned char>
+	struct OrAnd{
+		typedef T Value;
+		static T Zero(){
+			return T{ 0 };
+		};
+		static T One(){
+			return T{ 1 };
+		};
+		static T Add(T x, T y){
+			return x | y;
+		};
+		static T Multiply(T x, T y){
+			return x & y;
+		};
+	};
+	//
+}// END namespace FususMatrix
+
+#endif
@@ -0,0 +1,278 @@
+#ifndef _FususSparseExpressions_
+#define _FususSparseExpressions_
+
+#include <utility>
+#include <vector>
+
+namespace FususMatrix{
+
+	// Operators with sparse operands.
+	// They are more specialized than the lazy operators of BinaryOperatorsForLazyEvaluation.h, so they get chosen
+	// whenever an operand is a SparseMatrix. Each one is evaluated right away, with work bounded by the non-zeros
+	// (plus the dense operand, when there is one):
+	//   sparse + sparse, sparse - sparse  ->  sparse, merging the patterns of each row.
+	//   sparse * sparse (element-wise)    ->  sparse, intersecting the patterns.
+	//   sparse * dense, dense * sparse    ->  sparse, with the pattern of the sparse operand.
+	//   sparse + dense, sparse - dense... ->  dense, the dense operand plus the scattered non-zeros.
+	//   scalar * sparse, sparse * scalar  ->  sparse, scaling the stored elements (in place for a = s * a).
+	// Dense operands can be any expression; they are read with at(i, j), so their layout doesn't matter.
+	// Positions that cancel out in a sum are kept in the pattern, as explicit zeros.
+
+	template<typename T>
+	using SparseOperand = Matrix<T, 2, SparseMatrixContainer<T> >;
+
+	// Merge of the rows of a and b. Positions only in a give onlyA(x), only in b onlyB(y), in both both(x, y).
+	// With intersection set, positions not in both are dropped.
+	template<typename T, typename OnlyA, typename OnlyB, typename Both>
+	SparseMatrix<T> MergeSparse(SparseMatrixContainer<T> const& a, SparseMatrixContainer<T> const& b, bool intersection,
+		OnlyA const& onlyA, OnlyB const& onlyB, Both const& both){
+		assert(a.rows() == b.rows() && a.columns() == b.columns());
+		std::vector<std::size_t> const& ar{ a.RowPointers() };
+		std::vector<std::size_t> const& ac{ a.ColumnIndices() };
+		std::vector<T> const& av{ a.Values() };
+		std::vector<std::size_t> const& br{ b.RowPointers() };
+		std::vector<std::size_t> const& bc{ b.ColumnIndices() };
+		std::vector<T> const& bv{ b.Values() };
+		std::vector<std::size_t> rowPointers(a.rows() + 1, 0);
+		std::vector<std::size_t> columnIndices;
+		std::vector<T> values;
+		std::size_t const bound{ intersection ? (av.size() < bv.size() ? av.size() : bv.size()) : av.size() + bv.size() };
+		columnIndices.reserve(bound);
+		values.reserve(bound);
+		for (std::size_t i = 0; i < a.rows(); ++i){
+			std::size_t p{ ar[i] };
+			std::size_t q{ br[i] };
+			while (p < ar[i + 1] || q < br[i + 1]){
+				if (q == br[i + 1] || (p < ar[i + 1] && ac[p] < bc[q])){
+					if (!intersection){
+						columnIndices.push_back(ac[p]);
+						values.push_back(onlyA(av[p]));
+					};
+					++p;
+				}
+				else if (p == ar[i + 1] || bc[q] < ac[p]){
+					if (!intersection){
+						columnIndices.push_back(bc[q]);
+						values.push_back(onlyB(bv[q]));
+					};
+					++q;
+				}
+				else{
+					columnIndices.push_back(ac[p]);
+					values.push_back(both(av[p], bv[q]));
+					++p;
+					++q;
+				};
+			};
+			rowPointers[i + 1] = values.size();
+		};
+		return SparseMatrix<T>(SparseMatrixContainer<T>(a.rows(), a.columns(), std::move(rowPointers), std::move(columnIndices), std::move(values)));
+	};
+
+	// A sparse matrix with the pattern of a and elements f(x, i, j), x the stored element at (i, j).
+	template<typename T, typename Function>
+	SparseMatrix<T> TransformSparse(SparseMatrixContainer<T> const& a, Function const& f){
+		std::vector<std::size_t> const& rowPointers{ a.RowPointers() };
+		std::vector<std::size_t> const& columnIndices{ a.ColumnIndices() };
+		std::vector<T> values(a.Values());
+		for (std::size_t i = 0; i < a.rows(); ++i){
+			for (std::size_t p = rowPointers[i]; p < rowPointers[i + 1]; ++p){
+				values[p] = f(values[p], i, columnIndices[p]);
+			};
+		};
+		return SparseMatrix<T>(SparseMatrixContainer<T>(a.rows(), a.columns(), rowPointers, columnIndices, std::move(values)));
+	};
+
+	// The dense expression b times denseSign, plus the non-zeros of a times sparseSign scattered into it.
+	template<typename T, typename R>
+	Matrix<T, 2> ScatterSparse(SparseMatrixContainer<T> const& a, Matrix<T, 2, R> const& b, T const& denseSign, T const& sparseSign){
+		assert(a.rows() == b.getSizesAlongEachDimension()[0] && a.columns() == b.getSizesAlongEachDimension()[1]);
+		Matrix<T, 2> result(a.rows(), a.columns());
+		if (denseSign == T{ 1 }){
+			result = b;
+		}
+		else{
+			result = denseSign * b;
+		};
+		std::vector<std::size_t> const& rowPointers{ a.RowPointers() };
+		std::vector<std::size_t> const& columnIndices{ a.ColumnIndices() };
+		std::vector<T> const& values{ a.Values() };
+		for (std::size_t i = 0; i < a.rows(); ++i){
+			for (std::size_t p = rowPointers[i]; p < rowPointers[i + 1]; ++p){
+				result.rep().at(i, columnIndices[p]) += sparseSign * values[p];
+			};
+		};
+		return result;
+	};
+
+	// sparse + sparse.
+	template<typename T>
+	inline SparseMatrix<T> operator+(SparseOperand<T> const& a, SparseOperand<T> const& b){
+		return MergeSparse(a.rep(), b.rep(), false, [](T x){ return x; }, [](T y){ return y; }, [](T x, T y){ return x + y; });
+	};
+
+	// sparse - sparse.
+	template<typename T>
+	inline SparseMatrix<T> operator-(SparseOperand<T> const& a, SparseOperand<T> const& b){
+		return MergeSparse(a.rep(), b.rep(), false, [](T x){ return x; }, [](T y){ return -y; }, [](T x, T y){ return x - y; });
+	};
+
+	// sparse * sparse, element-wise.
+	template<typename T>
+	inline SparseMatrix<T> operator*(SparseOperand<T> const& a, SparseOperand<T> const& b){
+		return MergeSparse(a.rep(), b.rep(), true, [](T x){ return x; }, [](T y){ return y; }, [](T x, T y){ return x * y; });
+	};
+
+	// sparse * dense and dense * sparse, element-wise.
+	template<typename T, typename R>
+	inline SparseMatrix<T> operator*(SparseOperand<T> const& a, Matrix<T, 2, R> const& b){
+		assert(a.getSizesAlongEachDimension() == b.getSizesAlongEachDimension());
+		R const& dense{ b.rep() };
+		return TransformSparse(a.rep(), [&dense](T x, std::size_t i, std::size_t j){ return x * dense.at(i, j); });
+	};
+	template<typename T, typename R>
+	inline SparseMatrix<T> operator*(Matrix<T, 2, R> const& a, SparseOperand<T> const& b){
+		assert(a.getSizesAlongEachDimension() == b.getSizesAlongEachDimension());
+		R const& dense{ a.rep() };
+		return TransformSparse(b.rep(), [&dense](T y, std::size_t i, std::size_t j){ return dense.at(i, j) * y; });
+	};
+
+	// sparse / dense, element-wise.
+	template<typename T, typename R>
+	inline SparseMatrix<T> operator/(SparseOperand<T> const& a, Matrix<T, 2, R> const& b){
+		assert(a.getSizesAlongEachDimension() == b.getSizesAlongEachDimension());
+		R const& dense{ b.rep() };
+		return TransformSparse(a.rep(), [&dense](T x, std::size_t i, std::size_t j){ return x / dense.at(i, j); });
+	};
+
+	//
+	//                      The SparseScaling Class.
+	// s * a or a * s, left unevaluated until it is assigned or used. Assigned to a itself, as in a = s * a, it scales
+	// the stored elements in place; anything else gets the pattern of a with the scaled elements.
+	template<typename T>
+	class SparseScaling {
+	public:
+		SparseScaling(SparseOperand<T> const& a, T const& s, bool scalarOnTheLeft)
+			: Operand(a), Factor(s), ScalarOnTheLeft(scalarOnTheLeft){
+		};
+
+		SparseOperand<T> const& operand() const {
+			return Operand;
+		};
+		std::size_t rows() const {
+			return Operand.rows();
+		};
+		std::size_t columns() const {
+			return Operand.columns();
+		};
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			return Operand.getSizesAlongEachDimension();
+		};
+
+		// The container of the scaled matrix.
+		SparseMatrixContainer<T> Evaluate() const {
+			SparseMatrixContainer<T> result(Operand.rep());
+			ScaleInPlace(result);
+			return result;
+		};
+
+		// Scaling of the stored elements of a, which has the pattern of the operand or is the operand.
+		void ScaleInPlace(SparseMatrixContainer<T>& a) const {
+			for (auto& value : a.Values()){
+				value = ScalarOnTheLeft ? Factor * value : value * Factor;
+			};
+		};
+
+	private:
+		SparseOperand<T> const& Operand;
+		T Factor;
+		bool ScalarOnTheLeft;
+	};// END SparseScaling class
+
+	// Scaling.
+	template<typename T>
+	inline SparseScaling<T> operator*(T const& s, SparseOperand<T> const& a){
+		return SparseScaling<T>(a, s, true);
+	};
+	template<typename T>
+	inline SparseScaling<T> operator*(SparseOperand<T> const& a, T const& s){
+		return SparseScaling<T>(a, s, false);
+	};
+
+	// Scaling of a temporary, e.g. s * (a + b), reuses its elements.
+	template<typename T>
+	inline SparseMatrix<T> operator*(T const& s, SparseMatrix<T>&& a){
+		SparseScaling<T>(a, s, true).ScaleInPlace(a.rep());
+		return std::move(a);
+	};
+	template<typename T>
+	inline SparseMatrix<T> operator*(SparseMatrix<T>&& a, T const& s){
+		SparseScaling<T>(a, s, false).ScaleInPlace(a.rep());
+		return std::move(a);
+	};
+
+	// A scaling used as the operand of another operator is evaluated first.
+	template<typename T, typename B>
+	inline auto operator+(SparseScaling<T> const& a, B const& b) -> decltype(std::declval<SparseMatrix<T> >() + b){
+		return SparseMatrix<T>(a) + b;
+	};
+	template<typename A, typename T>
+	inline auto operator+(A const& a, SparseScaling<T> const& b) -> decltype(a + std::declval<SparseMatrix<T> >()){
+		return a + SparseMatrix<T>(b);
+	};
+	template<typename T>
+	inline SparseMatrix<T> operator+(SparseScaling<T> const& a, SparseScaling<T> const& b){
+		return SparseMatrix<T>(a) + SparseMatrix<T>(b);
+	};
+	template<typename T, typename B>
+	inline auto operator-(SparseScaling<T> const& a, B const& b) -> decltype(std::declval<SparseMatrix<T> >() - b){
+		return SparseMatrix<T>(a) - b;
+	};
+	template<typename A, typename T>
+	inline auto operator-(A const& a, SparseScaling<T> const& b) -> decltype(a - std::declval<SparseMatrix<T> >()){
+		return a - SparseMatrix<T>(b);
+	};
+	template<typename T>
+	inline SparseMatrix<T> operator-(SparseScaling<T> const& a, SparseScaling<T> const& b){
+		return SparseMatrix<T>(a) - SparseMatrix<T>(b);
+	};
+	template<typename T, typename B>
+	inline auto operator*(SparseScaling<T> const& a, B const& b) -> decltype(std::declval<SparseMatrix<T> >() * b){
+		return SparseMatrix<T>(a) * b;
+	};
+	template<typename A, typename T>
+	inline auto operator*(A const& a, SparseScaling<T> const& b) -> decltype(a * std::declval<SparseMatrix<T> >()){
+		return a * SparseMatrix<T>(b);
+	};
+	template<typename T>
+	inline SparseMatrix<T> operator*(SparseScaling<T> const& a, SparseScaling<T> const& b){
+		return SparseMatrix<T>(a) * SparseMatrix<T>(b);
+	};
+	template<typename T, typename B>
+	inline auto operator/(SparseScaling<T> const& a, B const& b) -> decltype(std::declval<SparseMatrix<T> >() / b){
+		return SparseMatrix<T>(a) / b;
+	};
+
+	// sparse + dense, dense + sparse.
+	template<typename T, typename R>
+	inline Matrix<T, 2> operator+(SparseOperand<T> const& a, Matrix<T, 2, R> const& b){
+		return ScatterSparse(a.rep(), b, T{ 1 }, T{ 1 });
+	};
+	template<typename T, typename R>
+	inline Matrix<T, 2> operator+(Matrix<T, 2, R> const& a, SparseOperand<T> const& b){
+		return ScatterSparse(b.rep(), a, T{ 1 }, T{ 1 });
+	};
+
+	// sparse - dense, dense - sparse.
+	template<typename T, typename R>
+	inline Matrix<T, 2> operator-(SparseOperand<T> const& a, Matrix<T, 2, R> const& b){
+		return ScatterSparse(a.rep(), b, T{ -1 }, T{ 1 });
+	};
+	template<typename T, typename R>
+	inline Matrix<T, 2> operator-(Matrix<T, 2, R> const& a, SparseOperand<T> const& b){
+		return ScatterSparse(b.rep(), a, T{ 1 }, T{ -1 });
+	};
+	//
+}// END namespace FususMatrix
+
+#endif
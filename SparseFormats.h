@@ -0,0 +1,632 @@
+#ifndef _FususSparseFormats_
+#define _FususSparseFormats_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "BufferPool.h"
+#include "Matrix.h"
+#include "SparseMatrix.h"
+#include "SparseMatrixContainer.h"
+#include "ThreadPool.h"
+
+namespace FususMatrix{
+
+	// Storage formats for sparse matrices besides CSR (SparseMatrixContainer).
+	// Each one is built from, and converted back to, CSR, so any format converts to any other through it.
+	// Their products y = A x work on raw vectors of A.columns() and A.rows() elements; SparseOperator
+	// wraps them with the Multiply(x, y) of Matrices used by the solvers.
+
+	// Formats known to SparseOperator.
+	// CSR: general purpose. CSC: columns compressed, fast transposed products.
+	// SELL: sliced ELLPACK (SELL-C-sigma), vectorized products for rows of similar lengths.
+	// BCSR: CSR of small dense blocks, for matrices with block structure (e.g. 3 unknowns per FEM node).
+	enum class SparseFormat { CSR, CSC, SELL, BCSR };
+
+	//
+	//                      The CSCContainer Class.
+	// Compressed Sparse Column: the non-zeros of column j are Values[ColumnPointers[j]] ... by increasing row.
+	template<typename T = double>
+	class CSCContainer{
+	private:
+		std::size_t Rows;
+		std::size_t Columns;
+		std::vector<std::size_t> ColumnPointers;
+		std::vector<std::size_t> RowIndices;
+		std::vector<T> Values;
+	public:
+		explicit CSCContainer(SparseMatrixContainer<T> const& csr)
+			: Rows(csr.rows()), Columns(csr.columns()){
+			TransposeCompressed(Rows, Columns, csr.RowPointers(), csr.ColumnIndices(), csr.Values(), ColumnPointers, RowIndices, Values);
+		};
+
+		SparseMatrixContainer<T> ToCSR() const {
+			std::vector<std::size_t> pointers, indices;
+			std::vector<T> values;
+			TransposeCompressed(Columns, Rows, ColumnPointers, RowIndices, Values, pointers, indices, values);
+			return SparseMatrixContainer<T>(Rows, Columns, std::move(pointers), std::move(indices), std::move(values));
+		};
+
+		std::size_t rows() const {
+			return Rows;
+		};
+		std::size_t columns() const {
+			return Columns;
+		};
+		std::size_t NonZeros() const {
+			return Values.size();
+		};
+
+		// y = A x, scattering column j times x[j].
+		void Multiply(T const* x, T* y) const {
+			std::fill(y, y + Rows, T{ 0 });
+			for (std::size_t j = 0; j < Columns; ++j){
+				T const xj{ x[j] };
+				for (std::size_t p = ColumnPointers[j]; p < ColumnPointers[j + 1]; ++p){
+					y[RowIndices[p]] += Values[p] * xj;
+				};
+			};
+		};
+
+		// y = transpose(A) x, one dot product per column. Columns are split between the workers.
+		void MultiplyTransposed(T const* x, T* y) const {
+			auto columnsProduct = [this, x, y](std::size_t first, std::size_t last){
+				for (std::size_t j = first; j < last; ++j){
+					T sum{ 0 };
+					for (std::size_t p = ColumnPointers[j]; p < ColumnPointers[j + 1]; ++p){
+						sum += Values[p] * x[RowIndices[p]];
+					};
+					y[j] = sum;
+				};
+			};
+			ThreadPool& pool{ ThreadPool::Global() };
+			if (Values.size() >= ParallelElementThreshold && pool.size() > 1){
+				pool.ParallelForStatic(0, Columns, columnsProduct);
+			}
+			else{
+				columnsProduct(0, Columns);
+			};
+		};
+	};// END CSCContainer class
+
+	// Chunk height of SELL-C-sigma: rows processed together, one per SIMD lane.
+	// 8 fills two AVX2 or one AVX-512 register of doubles.
+	const std::size_t SELLChunk{ 8 };
+
+	//
+	//                      The SELLContainer Class.
+	// Sliced ELLPACK, SELL-C-sigma (Kreutzer, Hager, Wellein, Fehske and Bishop, 2014).
+	// Rows are sorted by decreasing length inside windows of Sigma rows, then cut in chunks of C = SELLChunk rows.
+	// Each chunk is stored column by column, padded to its longest row, so that the product handles
+	// the C rows of a chunk in SIMD lanes with unit stride loads. Sorting keeps the padding small,
+	// and the windows keep the rows close to their position, so the accesses to x and y stay local.
+	template<typename T = double>
+	class SELLContainer{
+	private:
+		std::size_t Rows;
+		std::size_t Columns;
+		std::size_t Sigma;
+		std::size_t NNZ;
+		std::vector<std::size_t> Permutation; // Row of A stored at position r.
+		std::vector<std::size_t> RowLengths; // Non-zeros of each row of A, to tell them from the padding.
+		std::vector<std::size_t> ChunkPointers; // First element of each chunk.
+		std::vector<std::size_t> ChunkWidths; // Length of the longest row of each chunk.
+		std::vector<std::size_t> ColumnIndices; // Column index of padding is 0.
+		std::vector<T> Values; // Padding is 0.
+	public:
+		// Sigma is rounded up to a multiple of the chunk height. Sigma = chunk height doesn't sort at all.
+		explicit SELLContainer(SparseMatrixContainer<T> const& csr, std::size_t sigma = 32 * SELLChunk)
+			: Rows(csr.rows()), Columns(csr.columns()), Sigma(((sigma + SELLChunk - 1) / SELLChunk) * SELLChunk), NNZ(csr.NonZeros()), Permutation(csr.rows()){
+			std::size_t const C{ SELLChunk };
+			std::vector<std::size_t> const& rp{ csr.RowPointers() };
+			std::iota(Permutation.begin(), Permutation.end(), std::size_t{ 0 });
+			RowLengths.resize(Rows);
+			for (std::size_t i = 0; i < Rows; ++i){
+				RowLengths[i] = rp[i + 1] - rp[i];
+			};
+			for (std::size_t first = 0; first < Rows; first += Sigma){
+				std::size_t const last{ first + Sigma < Rows ? first + Sigma : Rows };
+				std::stable_sort(Permutation.begin() + first, Permutation.begin() + last, [&rp](std::size_t a, std::size_t b){
+					return rp[a + 1] - rp[a] > rp[b + 1] - rp[b];
+				});
+			};
+			std::size_t const chunks{ (Rows + C - 1) / C };
+			ChunkPointers.assign(chunks + 1, 0);
+			ChunkWidths.assign(chunks, 0);
+			for (std::size_t c = 0; c < chunks; ++c){
+				for (std::size_t r = c * C; r < (c + 1) * C && r < Rows; ++r){
+					std::size_t const length{ rp[Permutation[r] + 1] - rp[Permutation[r]] };
+					ChunkWidths[c] = length > ChunkWidths[c] ? length : ChunkWidths[c];
+				};
+				ChunkPointers[c + 1] = ChunkPointers[c] + ChunkWidths[c] * C;
+			};
+			ColumnIndices.assign(ChunkPointers[chunks], 0);
+			Values.assign(ChunkPointers[chunks], T{ 0 });
+			for (std::size_t r = 0; r < Rows; ++r){
+				std::size_t const c{ r / C };
+				std::size_t const lane{ r % C };
+				std::size_t const row{ Permutation[r] };
+				for (std::size_t p = rp[row]; p < rp[row + 1]; ++p){
+					std::size_t const position{ ChunkPointers[c] + (p - rp[row]) * C + lane };
+					ColumnIndices[position] = csr.ColumnIndices()[p];
+					Values[position] = csr.Values()[p];
+				};
+			};
+		};
+
+		SparseMatrixContainer<T> ToCSR() const {
+			std::size_t const C{ SELLChunk };
+			std::vector<std::size_t> pointers(Rows + 1, 0);
+			for (std::size_t i = 0; i < Rows; ++i){
+				pointers[i + 1] = pointers[i] + RowLengths[i];
+			};
+			std::vector<std::size_t> indices(pointers[Rows]);
+			std::vector<T> values(pointers[Rows]);
+			for (std::size_t r = 0; r < Rows; ++r){
+				std::size_t const c{ r / C };
+				std::size_t const row{ Permutation[r] };
+				for (std::size_t k = 0; k < RowLengths[row]; ++k){
+					indices[pointers[row] + k] = ColumnIndices[ChunkPointers[c] + k * C + r % C];
+					values[pointers[row] + k] = Values[ChunkPointers[c] + k * C + r % C];
+				};
+			};
+			return SparseMatrixContainer<T>(Rows, Columns, std::move(pointers), std::move(indices), std::move(values));
+		};
+
+		std::size_t rows() const {
+			return Rows;
+		};
+		std::size_t columns() const {
+			return Columns;
+		};
+		std::size_t NonZeros() const {
+			return NNZ;
+		};
+		// Elements stored, padding included.
+		std::size_t StoredElements() const {
+			return Values.size();
+		};
+
+		// Elements a SELLContainer of csr would store, padding included, from the lengths of the rows alone.
+		// Once a window is sorted, each of its chunks is as wide as its first row.
+		static std::size_t StoredElements(SparseMatrixContainer<T> const& csr, std::size_t sigma = 32 * SELLChunk){
+			std::size_t const C{ SELLChunk };
+			std::size_t const window{ ((sigma + C - 1) / C) * C };
+			std::size_t const rows{ csr.rows() };
+			std::vector<std::size_t> const& rp{ csr.RowPointers() };
+			std::vector<std::size_t> lengths(window < rows ? window : rows);
+			std::size_t stored{ 0 };
+			for (std::size_t first = 0; first < rows; first += window){
+				std::size_t const last{ first + window < rows ? first + window : rows };
+				for (std::size_t i = first; i < last; ++i){
+					lengths[i - first] = rp[i + 1] - rp[i];
+				};
+				std::sort(lengths.begin(), lengths.begin() + (last - first), std::greater<std::size_t>());
+				for (std::size_t r = 0; r < last - first; r += C){
+					stored += lengths[r] * C;
+				};
+			};
+			return stored;
+		};
+
+		// y = A x. The loop over the lanes of a chunk has a constant trip count and vectorizes (with gathers from x).
+		// Chunks are split between the workers.
+		void Multiply(T const* x, T* y) const {
+			std::size_t const C{ SELLChunk };
+			auto chunksProduct = [this, x, y, C](std::size_t first, std::size_t last){
+				for (std::size_t c = first; c < last; ++c){
+					std::array<T, SELLChunk> sum;
+					sum.fill(T{ 0 });
+					T const* values{ Values.data() + ChunkPointers[c] };
+					std::size_t const* columns{ ColumnIndices.data() + ChunkPointers[c] };
+					for (std::size_t k = 0; k < ChunkWidths[c]; ++k){
+						for (std::size_t lane = 0; lane < SELLChunk; ++lane){
+							sum[lane] += values[k * SELLChunk + lane] * x[columns[k * SELLChunk + lane]];
+						};
+					};
+					for (std::size_t lane = 0; lane < C && c * C + lane < Rows; ++lane){
+						y[Permutation[c * C + lane]] = sum[lane];
+					};
+				};
+			};
+			std::size_t const chunks{ ChunkWidths.size() };
+			ThreadPool& pool{ ThreadPool::Global() };
+			if (Values.size() >= ParallelElementThreshold && pool.size() > 1){
+				pool.ParallelForStatic(0, chunks, chunksProduct);
+			}
+			else{
+				chunksProduct(0, chunks);
+			};
+		};
+	};// END SELLContainer class
+
+	// y += B x for a dense block of R x C elements stored by rows. Fixed sizes unroll completely.
+	template<typename T, std::size_t R, std::size_t C>
+	inline void BlockMultiplyAdd(T const* block, T const* x, T* y){
+		for (std::size_t r = 0; r < R; ++r){
+			T sum{ 0 };
+			for (std::size_t c = 0; c < C; ++c){
+				sum += block[r * C + c] * x[c];
+			};
+			y[r] += sum;
+		};
+	};
+
+	//
+	//                      The BCSRContainer Class.
+	// Block Compressed Sparse Row: CSR whose elements are dense BlockRows x BlockColumns blocks.
+	// One column index per block instead of per element, and the elements of a block multiply
+	// contiguous pieces of x held in registers. Blocks with some zeros store them explicitly.
+	// Sizes that aren't multiples of the block are padded with zeros.
+	template<typename T = double>
+	class BCSRContainer{
+	private:
+		std::size_t Rows;
+		std::size_t Columns;
+		std::size_t BlockRows;
+		std::size_t BlockColumns;
+		std::size_t NNZ;
+		std::vector<std::size_t> BlockRowPointers;
+		std::vector<std::size_t> BlockColumnIndices;
+		std::vector<T> Values; // Block k at Values[k * BlockRows * BlockColumns], by rows.
+
+		template<std::size_t R, std::size_t C>
+		void MultiplyBlocks(T const* x, T* y, std::size_t first, std::size_t last) const {
+			for (std::size_t bi = first; bi < last; ++bi){
+				std::array<T, R> sum;
+				sum.fill(T{ 0 });
+				for (std::size_t p = BlockRowPointers[bi]; p < BlockRowPointers[bi + 1]; ++p){
+					BlockMultiplyAdd<T, R, C>(Values.data() + p * R * C, x + BlockColumnIndices[p] * C, sum.data());
+				};
+				for (std::size_t r = 0; r < R; ++r){
+					y[bi * R + r] = sum[r];
+				};
+			};
+		};
+
+		void MultiplyBlocksGeneric(T const* x, T* y, std::size_t first, std::size_t last) const {
+			std::size_t const R{ BlockRows };
+			std::size_t const C{ BlockColumns };
+			for (std::size_t bi = first; bi < last; ++bi){
+				for (std::size_t r = 0; r < R; ++r){
+					y[bi * R + r] = T{ 0 };
+				};
+				for (std::size_t p = BlockRowPointers[bi]; p < BlockRowPointers[bi + 1]; ++p){
+					T const* block{ Values.data() + p * R * C };
+					T const* xb{ x + BlockColumnIndices[p] * C };
+					for (std::size_t r = 0; r < R; ++r){
+						for (std::size_t c = 0; c < C; ++c){
+							y[bi * R + r] += block[r * C + c] * xb[c];
+						};
+					};
+				};
+			};
+		};
+
+		// The product on padded vectors, with the kernel unrolled for the usual block sizes.
+		void MultiplyPadded(T const* x, T* y, std::size_t first, std::size_t last) const {
+			if (BlockRows == 2 && BlockColumns == 2){
+				MultiplyBlocks<2, 2>(x, y, first, last);
+			}
+			else if (BlockRows == 3 && BlockColumns == 3){
+				MultiplyBlocks<3, 3>(x, y, first, last);
+			}
+			else if (BlockRows == 4 && BlockColumns == 4){
+				MultiplyBlocks<4, 4>(x, y, first, last);
+			}
+			else{
+				MultiplyBlocksGeneric(x, y, first, last);
+			};
+		};
+	public:
+		BCSRContainer(SparseMatrixContainer<T> const& csr, std::size_t blockRows, std::size_t blockColumns)
+			: Rows(csr.rows()), Columns(csr.columns()), BlockRows(blockRows), BlockColumns(blockColumns), NNZ(csr.NonZeros()){
+			assert(blockRows > 0 && blockColumns > 0);
+			std::size_t const R{ BlockRows };
+			std::size_t const C{ BlockColumns };
+			std::size_t const blockRowCount{ (Rows + R - 1) / R };
+			std::size_t const blockColumnCount{ (Columns + C - 1) / C };
+			std::vector<std::size_t> const& rp{ csr.RowPointers() };
+			std::vector<std::size_t> const& ci{ csr.ColumnIndices() };
+			std::vector<T> const& v{ csr.Values() };
+			std::size_t const none{ std::numeric_limits<std::size_t>::max() };
+			std::vector<std::size_t> position(blockColumnCount, none); // Block of the current block row in each block column.
+			BlockRowPointers.assign(blockRowCount + 1, 0);
+			for (std::size_t bi = 0; bi < blockRowCount; ++bi){
+				std::size_t const firstBlock{ BlockColumnIndices.size() };
+				for (std::size_t i = bi * R; i < (bi + 1) * R && i < Rows; ++i){
+					for (std::size_t p = rp[i]; p < rp[i + 1]; ++p){
+						std::size_t const bj{ ci[p] / C };
+						if (position[bj] == none){
+							position[bj] = BlockColumnIndices.size();
+							BlockColumnIndices.push_back(bj);
+						};
+					};
+				};
+				std::sort(BlockColumnIndices.begin() + firstBlock, BlockColumnIndices.end());
+				for (std::size_t k = firstBlock; k < BlockColumnIndices.size(); ++k){
+					position[BlockColumnIndices[k]] = k;
+				};
+				Values.resize(BlockColumnIndices.size() * R * C, T{ 0 });
+				for (std::size_t i = bi * R; i < (bi + 1) * R && i < Rows; ++i){
+					for (std::size_t p = rp[i]; p < rp[i + 1]; ++p){
+						Values[position[ci[p] / C] * R * C + (i - bi * R) * C + ci[p] % C] = v[p];
+					};
+				};
+				for (std::size_t k = firstBlock; k < BlockColumnIndices.size(); ++k){
+					position[BlockColumnIndices[k]] = none;
+				};
+				BlockRowPointers[bi + 1] = BlockColumnIndices.size();
+			};
+		};
+
+		SparseMatrixContainer<T> ToCSR() const {
+			std::size_t const R{ BlockRows };
+			std::size_t const C{ BlockColumns };
+			std::vector<std::size_t> pointers(Rows + 1, 0);
+			std::vector<std::size_t> indices;
+			std::vector<T> values;
+			// Zeros stored in the blocks are dropped.
+			for (std::size_t i = 0; i < Rows; ++i){
+				std::size_t const bi{ i / R };
+				for (std::size_t p = BlockRowPointers[bi]; p < BlockRowPointers[bi + 1]; ++p){
+					for (std::size_t c = 0; c < C; ++c){
+						T const value{ Values[p * R * C + (i % R) * C + c] };
+						if (value != T{ 0 }){
+							indices.push_back(BlockColumnIndices[p] * C + c);
+							values.push_back(value);
+						};
+					};
+				};
+				pointers[i + 1] = values.size();
+			};
+			return SparseMatrixContainer<T>(Rows, Columns, std::move(pointers), std::move(indices), std::move(values));
+		};
+
+		std::size_t rows() const {
+			return Rows;
+		};
+		std::size_t columns() const {
+			return Columns;
+		};
+		std::size_t NonZeros() const {
+			return NNZ;
+		};
+		// Elements stored, zeros inside the blocks included.
+		std::size_t StoredElements() const {
+			return Values.size();
+		};
+
+		// y = A x. Block rows are split between the workers.
+		// When the sizes aren't multiples of the block, x and y go through padded copies from BufferPool<T>::Global().
+		void Multiply(T const* x, T* y) const {
+			std::size_t const blockRowCount{ BlockRowPointers.size() - 1 };
+			std::size_t const paddedRows{ blockRowCount * BlockRows };
+			std::size_t const paddedColumns{ ((Columns + BlockColumns - 1) / BlockColumns) * BlockColumns };
+			bool const padded{ paddedRows != Rows || paddedColumns != Columns };
+			ScratchBuffer<T> xBuffer{ BufferPool<T>::Global().Acquire(padded ? paddedColumns : 0) };
+			ScratchBuffer<T> yBuffer{ BufferPool<T>::Global().Acquire(padded ? paddedRows : 0) };
+			T const* xp{ x };
+			T* yp{ y };
+			if (padded){
+				std::copy(x, x + Columns, xBuffer.data());
+				std::fill(xBuffer.data() + Columns, xBuffer.data() + paddedColumns, T{ 0 });
+				xp = xBuffer.data();
+				yp = yBuffer.data();
+			};
+			auto blockRowsProduct = [this, xp, yp](std::size_t first, std::size_t last){
+				MultiplyPadded(xp, yp, first, last);
+			};
+			ThreadPool& pool{ ThreadPool::Global() };
+			if (Values.size() >= ParallelElementThreshold && pool.size() > 1){
+				pool.ParallelForStatic(0, blockRowCount, blockRowsProduct);
+			}
+			else{
+				blockRowsProduct(0, blockRowCount);
+			};
+			if (padded){
+				std::copy(yp, yp + Rows, y);
+			};
+		};
+	};// END BCSRContainer class
+
+	// What the choice of format is based on.
+	struct SparseAnalysis{
+		double MeanRowLength;
+		std::size_t MaximumRowLength;
+		double RowLengthVariation; // Standard deviation over mean.
+		double SELLEfficiency; // Non-zeros over elements stored by SELL-C-sigma (with its default sigma).
+		std::size_t BlockSize; // Side of the square blocks that minimize the traffic of BCSR.
+		double BCSREfficiency; // Non-zeros over elements stored by BCSR with those blocks.
+		SparseFormat Format; // The format chosen.
+	};
+
+	// Picks the format of the fastest product from the structure of the matrix.
+	// The product is limited by memory bandwidth, so the model compares the bytes moved per non-zero:
+	//   CSR:  one value and one index.
+	//   BCSR: a block of values and one index per block, over the non-zeros of the block.
+	//   SELL: like CSR over its efficiency (padding moves too), but its chunks run in SIMD lanes,
+	//         which pays off for short rows, where CSR spends its time in loop overhead.
+	// With transposedProducts set CSC is chosen, whose transposed product gathers instead of scattering.
+	template<typename T>
+	SparseAnalysis AnalyzeSparse(SparseMatrixContainer<T> const& csr, bool transposedProducts = false){
+		SparseAnalysis analysis{ 0.0, 0, 0.0, 1.0, 1, 1.0, SparseFormat::CSR };
+		std::size_t const n{ csr.rows() };
+		std::vector<std::size_t> const& rp{ csr.RowPointers() };
+		std::vector<std::size_t> const& ci{ csr.ColumnIndices() };
+		if (n == 0 || csr.NonZeros() == 0){
+			return analysis;
+		};
+		double const nnz{ static_cast<double>(csr.NonZeros()) };
+		analysis.MeanRowLength = nnz / n;
+		double variance{ 0 };
+		for (std::size_t i = 0; i < n; ++i){
+			std::size_t const length{ rp[i + 1] - rp[i] };
+			analysis.MaximumRowLength = length > analysis.MaximumRowLength ? length : analysis.MaximumRowLength;
+			variance += (length - analysis.MeanRowLength) * (length - analysis.MeanRowLength);
+		};
+		analysis.RowLengthVariation = std::sqrt(variance / n) / analysis.MeanRowLength;
+		analysis.SELLEfficiency = nnz / SELLContainer<T>::StoredElements(csr);
+		// Number of distinct blocks of each size, counted with a marker per block column.
+		double const indexBytes{ static_cast<double>(sizeof(std::size_t)) };
+		double const valueBytes{ static_cast<double>(sizeof(T)) };
+		double bestBlockBytes{ valueBytes + indexBytes };
+		for (std::size_t b = 2; b <= 4; ++b){
+			std::vector<std::size_t> mark((csr.columns() + b - 1) / b, std::numeric_limits<std::size_t>::max());
+			std::size_t blocks{ 0 };
+			for (std::size_t i = 0; i < n; ++i){
+				for (std::size_t p = rp[i]; p < rp[i + 1]; ++p){
+					if (mark[ci[p] / b] != i / b){
+						mark[ci[p] / b] = i / b;
+						++blocks;
+					};
+				};
+			};
+			double const bytes{ blocks * (b * b * valueBytes + indexBytes) / nnz };
+			if (bytes < bestBlockBytes){
+				bestBlockBytes = bytes;
+				analysis.BlockSize = b;
+				analysis.BCSREfficiency = nnz / (blocks * b * b);
+			};
+		};
+		double const csrBytes{ valueBytes + indexBytes };
+		double const sellBytes{ csrBytes / analysis.SELLEfficiency };
+		if (transposedProducts){
+			analysis.Format = SparseFormat::CSC;
+		}
+		else if (analysis.BlockSize > 1 && bestBlockBytes < 0.75 * csrBytes){
+			analysis.Format = SparseFormat::BCSR;
+		}
+		else if (sellBytes < 1.25 * csrBytes && analysis.MeanRowLength < 32){
+			analysis.Format = SparseFormat::SELL;
+		};
+		return analysis;
+	};
+
+	//
+	//                      The SparseOperator Class.
+	// A sparse matrix stored in one of the formats, chosen by AnalyzeSparse unless given.
+	// It has the Multiply(x, y) of the solvers in KrylovSolvers.h, for n x 1 vectors.
+	template<typename T = double>
+	class SparseOperator{
+	private:
+		SparseAnalysis Analysis;
+		std::unique_ptr<SparseMatrixContainer<T> > CSR;
+		std::unique_ptr<CSCContainer<T> > CSC;
+		std::unique_ptr<SELLContainer<T> > SELL;
+		std::unique_ptr<BCSRContainer<T> > BCSR;
+
+		void Build(SparseMatrixContainer<T> const& csr){
+			switch (Analysis.Format){
+			case SparseFormat::CSR:
+				CSR.reset(new SparseMatrixContainer<T>(csr));
+				break;
+			case SparseFormat::CSC:
+				CSC.reset(new CSCContainer<T>(csr));
+				break;
+			case SparseFormat::SELL:
+				SELL.reset(new SELLContainer<T>(csr));
+				break;
+			case SparseFormat::BCSR:
+				BCSR.reset(new BCSRContainer<T>(csr, Analysis.BlockSize, Analysis.BlockSize));
+				break;
+			};
+		};
+	public:
+		// In the format of the fastest product, or of the fastest transposed product.
+		explicit SparseOperator(SparseMatrix<T> const& A, bool transposedProducts = false)
+			: Analysis(AnalyzeSparse(A.rep(), transposedProducts)){
+			Build(A.rep());
+		};
+
+		// In the given format. BCSR uses the block size found by AnalyzeSparse.
+		SparseOperator(SparseMatrix<T> const& A, SparseFormat format)
+			: Analysis(AnalyzeSparse(A.rep())){
+			Analysis.Format = format;
+			if (format == SparseFormat::BCSR && Analysis.BlockSize == 1){
+				Analysis.BlockSize = 2;
+			};
+			Build(A.rep());
+		};
+
+		SparseFormat format() const {
+			return Analysis.Format;
+		};
+
+		SparseAnalysis const& analysis() const {
+			return Analysis;
+		};
+
+		std::size_t rows() const {
+			return Analysis.Format == SparseFormat::CSR ? CSR->rows() : (Analysis.Format == SparseFormat::CSC ? CSC->rows() :
+				(Analysis.Format == SparseFormat::SELL ? SELL->rows() : BCSR->rows()));
+		};
+
+		std::size_t columns() const {
+			return Analysis.Format == SparseFormat::CSR ? CSR->columns() : (Analysis.Format == SparseFormat::CSC ? CSC->columns() :
+				(Analysis.Format == SparseFormat::SELL ? SELL->columns() : BCSR->columns()));
+		};
+
+		// Back to CSR, e.g. to convert to another format.
+		SparseMatrix<T> ToSparseMatrix() const {
+			switch (Analysis.Format){
+			case SparseFormat::CSC:
+				return SparseMatrix<T>(CSC->ToCSR());
+			case SparseFormat::SELL:
+				return SparseMatrix<T>(SELL->ToCSR());
+			case SparseFormat::BCSR:
+				return SparseMatrix<T>(BCSR->ToCSR());
+			default:
+				return SparseMatrix<T>(SparseMatrixContainer<T>(*CSR));
+			};
+		};
+
+		// y = A x, y resized only if needed.
+		Matrix<T, 2>& Multiply(Matrix<T, 2> const& x, Matrix<T, 2>& y) const {
+			assert(x.columns() == 1 && x.rows() == columns());
+			if (y.rows() != rows() || y.columns() != 1){
+				y.rep().resize({ rows(), 1 });
+			};
+			switch (Analysis.Format){
+			case SparseFormat::CSR:
+				CSR->Multiply(x.rep(), y.rep());
+				break;
+			case SparseFormat::CSC:
+				CSC->Multiply(x.rep().data(), y.rep().data());
+				break;
+			case SparseFormat::SELL:
+				SELL->Multiply(x.rep().data(), y.rep().data());
+				break;
+			case SparseFormat::BCSR:
+				BCSR->Multiply(x.rep().data(), y.rep().data());
+				break;
+			};
+			return y;
+		};
+
+		// y = transpose(A) x. Only for CSR and CSC; the other formats are chosen for the direct product.
+		Matrix<T, 2>& MultiplyTransposed(Matrix<T, 2> const& x, Matrix<T, 2>& y) const {
+			assert(x.columns() == 1 && x.rows() == rows());
+			assert(Analysis.Format == SparseFormat::CSR || Analysis.Format == SparseFormat::CSC);
+			if (y.rows() != columns() || y.columns() != 1){
+				y.rep().resize({ columns(), 1 });
+			};
+			if (Analysis.Format == SparseFormat::CSC){
+				CSC->MultiplyTransposed(x.rep().data(), y.rep().data());
+			}
+			else{
+				CSR->MultiplyTransposed(x.rep(), y.rep());
+			};
+			return y;
+		};
+	};// END SparseOperator class
+	//
+}// END namespace FususMatrix
+
+#endif
@@ -7,11 +7,16 @@
 #include <iostream>
 
 //#include "MatrixInitializer.h"
+#include "Matrix.h"
 #include "SparseMatrixContainer.h"
 #include "LazyEvaluationExpressionTemplates.h"
 
 namespace FususMatrix{
 
+	template<typename T> class SparseScaling;
+
+	// Sparse matrices mixed with other operands are evaluated by the operators of SparseExpressions.h,
+	// with work proportional to the non-zeros. Assigning to a SparseMatrix replaces its sparsity pattern.
 	template<typename T = double, typename Rep = SparseMatrixContainer<T> >//std::vector<T> >
 	class SparseMatrix : public Matrix < T, 2, Rep> {
 	public:
@@ -23,9 +28,101 @@ namespace FususMatrix{
 		SparseMatrix(std::size_t rows, std::size_t columns) : Matrix<T, 2, Rep>(rows, columns){
 		};
 
-		SparseMatrix(std::initializer_list<std::initializer_list<double>> init){}
+		// Constructor from the non-zero elements, in any order. Repeated positions are added up.
+		SparseMatrix(std::size_t rows, std::size_t columns, std::vector<Triplet<T> > const& elements)
+			: Matrix<T, 2, Rep>(Rep(rows, columns, elements)){
+		};
+
+		// Constructor from the rows of a dense matrix. Only the non-zeros are stored.
+		SparseMatrix(std::initializer_list<std::initializer_list<T>> init)
+			: Matrix<T, 2, Rep>(Rep(init)){
+		};
+
+		// Constructor taking over a container, e.g. the result of an operation.
+		SparseMatrix(Rep&& rep)
+			: Matrix<T, 2, Rep>(std::move(rep)){
+		};
+
+		SparseMatrix(SparseMatrix const& other) = default;
+		SparseMatrix(SparseMatrix&& other) = default;
+
+		// Assignments replace the container, pattern included.
+		SparseMatrix& operator=(SparseMatrix const& other){
+			Rep copy(other.rep());
+			this->rep().swap(copy);
+			return *this;
+		};
+		SparseMatrix& operator=(SparseMatrix&& other){
+			this->rep().swap(other.rep());
+			return *this;
+		};
+
+		// Constructor and assignment from s * a (see SparseExpressions.h). Assigning s * a to a itself scales in place.
+		SparseMatrix(SparseScaling<T> const& scaling)
+			: Matrix<T, 2, Rep>(scaling.Evaluate()){
+		};
+		SparseMatrix& operator=(SparseScaling<T> const& scaling){
+			if (&scaling.operand().rep() == &this->rep()){
+				scaling.ScaleInPlace(this->rep());
+			}
+			else{
+				Rep result(scaling.Evaluate());
+				this->rep().swap(result);
+			};
+			return *this;
+		};
+
+		// Scaling of the stored elements, in place.
+		SparseMatrix& operator*=(T const& s){
+			for (auto& value : this->rep().Values()){
+				value *= s;
+			};
+			return *this;
+		};
+
+		// Number of stored elements.
+		std::size_t NonZeros() const {
+			return this->rep().NonZeros();
+		};
+
+		// Product with a dense Matrix (e.g. a vector) written into y, which is resized only if needed.
+		Matrix<T, 2>& Multiply(Matrix<T, 2> const& x, Matrix<T, 2>& y) const {
+			assert(this->columns() == x.rows());
+			if (y.rows() != this->rows() || y.columns() != x.columns()){
+				y.rep().resize({ this->rows(), x.columns() });
+			};
+			this->rep().Multiply(x.rep(), y.rep());
+			return y;
+		};
+
+		// Product of the transpose with a dense Matrix, without transposing.
+		Matrix<T, 2>& MultiplyTransposed(Matrix<T, 2> const& x, Matrix<T, 2>& y) const {
+			assert(this->rows() == x.rows());
+			if (y.rows() != this->columns() || y.columns() != x.columns()){
+				y.rep().resize({ this->columns(), x.columns() });
+			};
+			this->rep().MultiplyTransposed(x.rep(), y.rep());
+			return y;
+		};
+
+		// Product with a dense Matrix.
+		Matrix<T, 2> Multiply(Matrix<T, 2> const& x) const {
+			Matrix<T, 2> y(this->rows(), x.columns());
+			Multiply(x, y);
+			return y;
+		};
+
+		// Product with another sparse matrix, sparse (see SparseProduct.h).
+		SparseMatrix Multiply(SparseMatrix const& b) const {
+			return SparseMatrix(SparseProduct(this->rep(), b.rep()));
+		};
 	};
 	//
 }// END namespace FususMatrix
 
+#include "SparseExpressions.h"
+#include "SparseFormats.h"
+#include "SparseProduct.h"
+#include "SparseReordering.h"
+
 #endif
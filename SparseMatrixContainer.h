@@ -1,11 +1,52 @@
 #ifndef _FususSparseMatrixContainer_
 #define _FususSparseMatrixContainer_
 
+#include <algorithm>
+#include <initializer_list>
 #include <numeric>
 #include <map>
+#include <utility>
+
+#include "DenseMatrixContainer.h"
+#include "Layout.h"
+#include "ThreadPool.h"
 
 namespace FususMatrix{
-	//
+
+	// A non-zero element given by its position, used to build sparse matrices.
+	template<typename T = double>
+	struct Triplet{
+		std::size_t Row;
+		std::size_t Column;
+		T Value;
+	};
+
+	// Transposition of compressed arrays by counting sort, O(nnz + rows + columns).
+	// The CSR arrays of a rows x columns matrix become those of its transpose, which are also its CSC arrays.
+	// The indices of each output row come out increasing.
+	template<typename T>
+	void TransposeCompressed(std::size_t rows, std::size_t columns,
+		std::vector<std::size_t> const& pointers, std::vector<std::size_t> const& indices, std::vector<T> const& values,
+		std::vector<std::size_t>& tPointers, std::vector<std::size_t>& tIndices, std::vector<T>& tValues){
+		tPointers.assign(columns + 1, 0);
+		tIndices.resize(indices.size());
+		tValues.resize(values.size());
+		for (auto j : indices){
+			++tPointers[j + 1];
+		};
+		std::partial_sum(tPointers.begin(), tPointers.end(), tPointers.begin());
+		std::vector<std::size_t> next(tPointers.begin(), tPointers.end() - 1);
+		for (std::size_t i = 0; i < rows; ++i){
+			for (std::size_t p = pointers[i]; p < pointers[i + 1]; ++p){
+				std::size_t const q{ next[indices[p]]++ };
+				tIndices[q] = i;
+				tValues[q] = values[p];
+			};
+		};
+	};
+
+	// Compressed Sparse Row (CSR) container.
+	// The non-zeros of row i are vals[rindx[i]] ... vals[rindx[i + 1] - 1], by increasing column.
 	template<typename T = double>
 	class SparseMatrixContainer{
 	private:
@@ -13,14 +54,63 @@ namespace FususMatrix{
 		std::vector<std::size_t> cindx; // Column indices of the non-zero components.
 		std::vector<std::size_t> rindx; // Index in vals and cindx where the pivot of the corresponding row lies.
 		//
-		bool Transposed; // Transposed or not.
+		bool Transposed; // Transposed or not. The arrays are always those of the matrix as it is now.
 		std::size_t Rows;
 		std::size_t Columns;
 		std::size_t NNZ; // Number of Non-Zero elements.
+		std::vector<std::size_t> Sizes; // { Rows, Columns }
 	public:
 		// Constructor from the sizes along each dimension.
 		SparseMatrixContainer(std::size_t Dimension, std::size_t rows, std::size_t columns)
-			: Transposed(false), Rows(rows), Columns(columns), rindx(columns + 1), NNZ(0){
+			: rindx(rows + 1), Transposed(false), Rows(rows), Columns(columns), NNZ(0), Sizes{ rows, columns }{
+		};
+
+		// Constructor from the non-zero elements, in any order. Repeated positions are added up.
+		SparseMatrixContainer(std::size_t rows, std::size_t columns, std::vector<Triplet<T> > elements)
+			: rindx(rows + 1), Transposed(false), Rows(rows), Columns(columns), NNZ(0), Sizes{ rows, columns }{
+			std::sort(elements.begin(), elements.end(), [](Triplet<T> const& a, Triplet<T> const& b){
+				return a.Row < b.Row || (a.Row == b.Row && a.Column < b.Column);
+			});
+			vals.reserve(elements.size());
+			cindx.reserve(elements.size());
+			for (std::size_t k = 0; k < elements.size(); ++k){
+				assert(elements[k].Row < rows && elements[k].Column < columns);
+				if (k > 0 && elements[k].Row == elements[k - 1].Row && elements[k].Column == elements[k - 1].Column){
+					vals.back() += elements[k].Value;
+				}
+				else{
+					vals.push_back(elements[k].Value);
+					cindx.push_back(elements[k].Column);
+					++rindx[elements[k].Row + 1];
+				};
+			};
+			std::partial_sum(rindx.begin(), rindx.end(), rindx.begin());
+			NNZ = vals.size();
+		};
+
+		// Constructor from the CSR arrays, which are taken over. The columns of each row must be increasing.
+		SparseMatrixContainer(std::size_t rows, std::size_t columns, std::vector<std::size_t> rowPointers, std::vector<std::size_t> columnIndices, std::vector<T> values)
+			: vals(std::move(values)), cindx(std::move(columnIndices)), rindx(std::move(rowPointers)), Transposed(false), Rows(rows), Columns(columns), NNZ(vals.size()), Sizes{ rows, columns }{
+			assert(rindx.size() == rows + 1 && cindx.size() == vals.size() && rindx.back() == vals.size());
+		};
+
+		// Constructor from the rows of a dense matrix, e.g. { { 4, 1, 0 }, { 1, 4, 1 }, { 0, 1, 4 } }. Zeros aren't stored.
+		SparseMatrixContainer(std::initializer_list<std::initializer_list<T> > init)
+			: rindx(init.size() + 1), Transposed(false), Rows(init.size()), Columns(init.size() > 0 ? init.begin()->size() : 0), NNZ(0), Sizes{ Rows, Columns }{
+			std::size_t i{ 0 };
+			for (auto const& row : init){
+				assert(row.size() == Columns);
+				std::size_t j{ 0 };
+				for (auto const& value : row){
+					if (value != T{ 0 }){
+						vals.push_back(value);
+						cindx.push_back(j);
+					};
+					++j;
+				};
+				rindx[++i] = vals.size();
+			};
+			NNZ = vals.size();
 		};
 
 		// Swap.
@@ -28,10 +118,11 @@ namespace FususMatrix{
 			vals.swap(other.vals);
 			cindx.swap(other.cindx);
 			rindx.swap(other.rindx);
-			Transposed = other.Transposed;
-			Rows = other.Rows;
-			Columns = other.Columns;
-			NNZ = other.NNZ;
+			std::swap(Transposed, other.Transposed);
+			std::swap(Rows, other.Rows);
+			std::swap(Columns, other.Columns);
+			std::swap(NNZ, other.NNZ);
+			Sizes.swap(other.Sizes);
 		};
 
 		// Size is size of represented data.
@@ -39,6 +130,40 @@ namespace FususMatrix{
 			return Rows * Columns;
 		};
 
+		// Getter for all the sizes.
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			return Sizes;
+		};
+
+		// Number of rows.
+		std::size_t rows() const {
+			return Rows;
+		};
+
+		// Number of columns.
+		std::size_t columns() const {
+			return Columns;
+		};
+
+		// Number of stored (non-zero) elements.
+		std::size_t NonZeros() const {
+			return NNZ;
+		};
+
+		// The CSR arrays, for the kernels working directly on them (preconditioners, other formats).
+		std::vector<std::size_t> const& RowPointers() const {
+			return rindx;
+		};
+		std::vector<std::size_t> const& ColumnIndices() const {
+			return cindx;
+		};
+		std::vector<T> const& Values() const {
+			return vals;
+		};
+		std::vector<T>& Values(){
+			return vals;
+		};
+
 		// Getter for sizes along each dimension.
 		std::size_t SizeAlongDimension(std::size_t dim) const {
 			assert(dim == 0 || dim == 1);
@@ -57,11 +182,13 @@ namespace FususMatrix{
 
 		// Index operator for constants and variables.
 		// Accesses the elements according to the linear order in the 1-D vector container.
+		// The linear order is the row-major order of the logical (dense) matrix, as for the dense containers,
+		// so that a sparse operand gives the right answers inside any expression (though at a lookup per element).
 		T operator[](std::size_t index) const {
-			return vals[index]; // This one is not this simple.
+			return at(index / Columns, index % Columns);
 		};
 		T& operator[](std::size_t index) {
-			return vals[index];
+			return vals[ComputePosition(index / Columns, index % Columns)];
 		};
 
 		// Unitary operators.
@@ -82,22 +209,115 @@ namespace FususMatrix{
 
 
 		// Accessing elements
-		std::size_t ComputePosition(std::size_t row, std::size_t column){
-			return 0;
+		// Position in vals of a stored element. The sparsity pattern is fixed, so only stored elements can be written.
+		std::size_t ComputePosition(std::size_t row, std::size_t column) const {
+			auto first = cindx.begin() + rindx[row];
+			auto last = cindx.begin() + rindx[row + 1];
+			auto position = std::lower_bound(first, last, column);
+			assert(position != last && *position == column);
+			return static_cast<std::size_t>(position - cindx.begin());
 		};
 
 		T& operator()(std::size_t row, std::size_t column){
-			return vals[ComputePosition(row, column)];// much more complicated.
+			return vals[ComputePosition(row, column)];
 		};
 
+		// Elements not stored are zero.
 		const T& operator()(std::size_t row, std::size_t column) const {
+			static const T Zero{ 0 };
 			for (std::size_t i = rindx[row]; i < rindx[row + 1]; ++i){
 				if (cindx[i] == column){
 					return vals[i];
 				}
 			};
+			return Zero;
+		};
+
+		// The elements are not laid out in a dense order.
+		Layout layout() const {
+			return Layout::Strided;
+		};
+
+		// Element in row i and column j.
+		T at(std::size_t i, std::size_t j) const {
+			for (std::size_t k = rindx[i]; k < rindx[i + 1]; ++k){
+				if (cindx[k] == j){
+					return vals[k];
+				};
+			};
 			return T{ 0 };
 		};
+		T& at(std::size_t i, std::size_t j){
+			return (*this)(i, j);
+		};
+
+		// Transpose, by rebuilding the arrays (O(nnz)), so that every kernel keeps working on rows.
+		void transpose(){
+			std::vector<std::size_t> tPointers, tIndices;
+			std::vector<T> tValues;
+			TransposeCompressed(Rows, Columns, rindx, cindx, vals, tPointers, tIndices, tValues);
+			rindx.swap(tPointers);
+			cindx.swap(tIndices);
+			vals.swap(tValues);
+			std::swap(Rows, Columns);
+			std::swap(Sizes[0], Sizes[1]);
+			Transposed = !Transposed;
+		};
+
+		// Whether transpose() was called an odd number of times.
+		bool IsTransposed() const {
+			return Transposed;
+		};
+
+		// y = 'this' * x, for dense x with as many rows as 'this' has columns (any number of columns).
+		// y must have the right sizes and not be x. Rows are split between the workers for large matrices.
+		void Multiply(DenseMatrixContainer<T, 2> const& x, DenseMatrixContainer<T, 2>& y) const {
+			assert(x.rows() == Columns && y.rows() == Rows && y.columns() == x.columns());
+			std::size_t const k{ x.columns() };
+			// y is detached once here, so that the workers write its elements through a plain pointer.
+			y.detach();
+			T* out{ y.data() };
+			std::size_t const rowStride{ y.getStrides()[0] };
+			std::size_t const columnStride{ y.getStrides()[1] };
+			auto rowsProduct = [this, &x, out, rowStride, columnStride, k](std::size_t first, std::size_t last){
+				for (std::size_t i = first; i < last; ++i){
+					for (std::size_t j = 0; j < k; ++j){
+						T sum{ 0 };
+						for (std::size_t p = rindx[i]; p < rindx[i + 1]; ++p){
+							sum += vals[p] * x.at(cindx[p], j);
+						};
+						out[i * rowStride + j * columnStride] = sum;
+					};
+				};
+			};
+			ThreadPool& pool{ ThreadPool::Global() };
+			if (NNZ * k >= ParallelElementThreshold && pool.size() > 1){
+				pool.ParallelForStatic(0, Rows, rowsProduct);
+			}
+			else{
+				rowsProduct(0, Rows);
+			};
+		};
+
+		// y = transpose('this') * x without transposing, scattering each row of 'this' times x(i) into y.
+		void MultiplyTransposed(DenseMatrixContainer<T, 2> const& x, DenseMatrixContainer<T, 2>& y) const {
+			assert(x.rows() == Rows && y.rows() == Columns && y.columns() == x.columns());
+			T* out{ y.data() };
+			std::size_t const rowStride{ y.getStrides()[0] };
+			std::size_t const columnStride{ y.getStrides()[1] };
+			for (std::size_t j = 0; j < y.columns(); ++j){
+				T* column{ out + j * columnStride };
+				for (std::size_t i = 0; i < Columns; ++i){
+					column[i * rowStride] = T{ 0 };
+				};
+				for (std::size_t i = 0; i < Rows; ++i){
+					T const xi{ x.at(i, j) };
+					for (std::size_t p = rindx[i]; p < rindx[i + 1]; ++p){
+						column[cindx[p] * rowStride] += vals[p] * xi;
+					};
+				};
+			};
+		};
 		//
 	};// END SparseMatrixContainer class
 	//
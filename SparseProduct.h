@@ -0,0 +1,229 @@
+#ifndef _FususSparseProduct_
+#define _FususSparseProduct_
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "SparseMatrixContainer.h"
+#include "ThreadPool.h"
+
+namespace FususMatrix{
+
+	// Product of two sparse matrices (SpGEMM), C = A B, row by row (Gustavson):
+	// row i of C is the sum of the rows k of B scaled by A(i, k).
+	// It runs in two passes over the rows. The symbolic pass counts the columns of each row of C, which gives
+	// the row pointers; the numeric pass then writes each row straight into its place of the CSR arrays.
+	// The terms of a row are accumulated either in a hash table, sized by the number of terms of the row,
+	// or in a dense array as long as a row of C, whichever is cheaper for that row. Each thread keeps its own.
+	// Rows are split among the threads in blocks with about the same number of terms.
+
+	// Rows whose terms times this factor are fewer than the columns of C use the hash table.
+	std::size_t const SparseHashFactor{ 16 };
+
+	// Accumulator of the terms of one row of C, one per thread.
+	template<typename T>
+	class RowAccumulator{
+	private:
+		std::size_t const Empty{ std::numeric_limits<std::size_t>::max() };
+		std::size_t Columns;
+		std::vector<std::size_t> Marker; // Dense: the stamp of the last row that touched each column.
+		std::vector<T> Dense;
+		std::vector<std::size_t> Keys; // Hash: columns, Empty where free.
+		std::vector<T> Hashed;
+		std::size_t Mask;
+		bool UseHash;
+		std::size_t Stamp; // Counts the rows started.
+		std::vector<std::size_t> Touched; // Columns of the current row, in order of appearance.
+	public:
+		explicit RowAccumulator(std::size_t columns)
+			: Columns(columns), Mask(0), UseHash(true), Stamp(0){
+		};
+
+		// Starts a row with at most terms terms.
+		void start(std::size_t terms){
+			++Stamp;
+			Touched.clear();
+			UseHash = terms * SparseHashFactor < Columns;
+			if (UseHash){
+				std::size_t capacity{ 16 };
+				while (capacity < 2 * terms){
+					capacity *= 2;
+				};
+				if (Keys.size() < capacity){
+					Keys.assign(capacity, Empty);
+					Hashed.resize(capacity);
+				};
+				Mask = capacity - 1;
+			}
+			else if (Marker.empty()){
+				Marker.assign(Columns, Empty);
+				Dense.resize(Columns);
+			};
+		};
+
+		// Adds the term value to column j. The symbolic pass adds without values.
+		template<bool Numeric>
+		void add(std::size_t j, T const& value){
+			if (UseHash){
+				std::size_t slot{ (j * 0x9E3779B97F4A7C15ull) >> 32 & Mask };
+				while (Keys[slot] != j && Keys[slot] != Empty){
+					slot = (slot + 1) & Mask;
+				};
+				if (Keys[slot] == Empty){
+					Keys[slot] = j;
+					Touched.push_back(slot);
+					if (Numeric){
+						Hashed[slot] = value;
+					};
+				}
+				else if (Numeric){
+					Hashed[slot] += value;
+				};
+			}
+			else{
+				if (Marker[j] != Stamp){
+					Marker[j] = Stamp;
+					Touched.push_back(j);
+					if (Numeric){
+						Dense[j] = value;
+					};
+				}
+				else if (Numeric){
+					Dense[j] += value;
+				};
+			};
+		};
+
+		// Number of columns of the row.
+		std::size_t count() const {
+			return Touched.size();
+		};
+
+		// Writes the row, by increasing column, into indices and values, and leaves the accumulator clean.
+		void finish(std::size_t* indices, T* values){
+			std::size_t const n{ Touched.size() };
+			if (UseHash){
+				// Sorted by column through the slots, with values following.
+				std::sort(Touched.begin(), Touched.end(), [this](std::size_t a, std::size_t b){
+					return Keys[a] < Keys[b];
+				});
+				for (std::size_t q = 0; q < n; ++q){
+					indices[q] = Keys[Touched[q]];
+					values[q] = Hashed[Touched[q]];
+				};
+			}
+			else{
+				std::sort(Touched.begin(), Touched.end());
+				for (std::size_t q = 0; q < n; ++q){
+					indices[q] = Touched[q];
+					values[q] = Dense[Touched[q]];
+				};
+			};
+			clear();
+		};
+
+		// Leaves the accumulator ready for another row, after the symbolic pass.
+		void clear(){
+			if (UseHash){
+				for (auto slot : Touched){
+					Keys[slot] = Empty;
+				};
+			};
+			Touched.clear();
+		};
+	};// END RowAccumulator class
+
+	// C = A B.
+	template<typename T>
+	SparseMatrixContainer<T> SparseProduct(SparseMatrixContainer<T> const& A, SparseMatrixContainer<T> const& B){
+		assert(A.columns() == B.rows());
+		std::size_t const rows{ A.rows() };
+		std::size_t const columns{ B.columns() };
+		std::vector<std::size_t> const& ar{ A.RowPointers() };
+		std::vector<std::size_t> const& ac{ A.ColumnIndices() };
+		std::vector<T> const& av{ A.Values() };
+		std::vector<std::size_t> const& br{ B.RowPointers() };
+		std::vector<std::size_t> const& bc{ B.ColumnIndices() };
+		std::vector<T> const& bv{ B.Values() };
+
+		// Terms of each row, an upper bound of its length, and their running sum for the partition.
+		std::vector<std::size_t> terms(rows + 1, 0);
+		for (std::size_t i = 0; i < rows; ++i){
+			std::size_t sum{ 0 };
+			for (std::size_t p = ar[i]; p < ar[i + 1]; ++p){
+				sum += br[ac[p] + 1] - br[ac[p]];
+			};
+			terms[i + 1] = terms[i] + sum;
+		};
+		ThreadPool& pool{ ThreadPool::Global() };
+		std::size_t const totalTerms{ terms[rows] };
+		std::size_t parts{ totalTerms < ParallelElementThreshold ? 1 : 4 * pool.size() };
+		std::vector<std::size_t> boundaries(parts + 1, rows);
+		boundaries[0] = 0;
+		for (std::size_t k = 1; k < parts; ++k){
+			boundaries[k] = std::lower_bound(terms.begin(), terms.end(), k * (totalTerms / parts)) - terms.begin();
+			boundaries[k] = std::max(boundaries[k], boundaries[k - 1]);
+			boundaries[k] = std::min(boundaries[k], rows);
+		};
+
+		// One accumulator per worker, plus one for the calling thread if it isn't a worker.
+		std::vector<std::unique_ptr<RowAccumulator<T> > > accumulators(pool.size() + 1);
+		auto accumulator = [&accumulators, &pool, columns]() -> RowAccumulator<T>& {
+			std::size_t worker{ ThreadPool::CurrentWorker() };
+			worker = pool.IsWorkerThread() ? worker : pool.size();
+			if (!accumulators[worker]){
+				accumulators[worker].reset(new RowAccumulator<T>(columns));
+			};
+			return *accumulators[worker];
+		};
+		auto forEachPart = [&pool, parts](auto const& body){
+			if (parts == 1){
+				body(0, 1);
+				return;
+			};
+			pool.ParallelFor(0, parts, 1, body);
+		};
+
+		// Symbolic pass: the length of each row.
+		std::vector<std::size_t> rowPointers(rows + 1, 0);
+		forEachPart([&](std::size_t first, std::size_t last){
+			RowAccumulator<T>& row{ accumulator() };
+			for (std::size_t i = boundaries[first]; i < boundaries[last]; ++i){
+				row.start(terms[i + 1] - terms[i]);
+				for (std::size_t p = ar[i]; p < ar[i + 1]; ++p){
+					for (std::size_t q = br[ac[p]]; q < br[ac[p] + 1]; ++q){
+						row.template add<false>(bc[q], T{});
+					};
+				};
+				rowPointers[i + 1] = row.count();
+				row.clear();
+			};
+		});
+		for (std::size_t i = 0; i < rows; ++i){
+			rowPointers[i + 1] += rowPointers[i];
+		};
+
+		// Numeric pass, into the final arrays.
+		std::vector<std::size_t> columnIndices(rowPointers[rows]);
+		std::vector<T> values(rowPointers[rows]);
+		forEachPart([&](std::size_t first, std::size_t last){
+			RowAccumulator<T>& row{ accumulator() };
+			for (std::size_t i = boundaries[first]; i < boundaries[last]; ++i){
+				row.start(terms[i + 1] - terms[i]);
+				for (std::size_t p = ar[i]; p < ar[i + 1]; ++p){
+					T const a{ av[p] };
+					for (std::size_t q = br[ac[p]]; q < br[ac[p] + 1]; ++q){
+						row.template add<true>(bc[q], a * bv[q]);
+					};
+				};
+				row.finish(columnIndices.data() + rowPointers[i], values.data() + rowPointers[i]);
+			};
+		});
+		return SparseMatrixContainer<T>(rows, columns, std::move(rowPointers), std::move(columnIndices), std::move(values));
+	};
+	//
+}// END namespace FususMatrix
+
+#endif
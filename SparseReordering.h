@@ -0,0 +1,424 @@
+#ifndef _FususSparseReordering_
+#define _FususSparseReordering_
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+#include <ostream>
+#include <vector>
+
+#include "Matrix.h"
+#include "SparseMatrixContainer.h"
+#include "ThreadPool.h"
+
+namespace FususMatrix{
+
+	// Reorderings of the unknowns of sparse matrices, to bring the non-zeros close to the diagonal.
+	// Then SpMV reads x in nearby positions, and factorizations / triangular solves have less fill.
+	// The orderings look at the graph of the symmetrized pattern, A + transpose(A).
+
+	//
+	//                      The Permutation Class.
+	// New position k holds old index Order[k]. Applied to a vector, y[k] = x[Order[k]];
+	// applied to a matrix, symmetrically, B(k, l) = A(Order[k], Order[l]), that is B = P A transpose(P).
+	class Permutation{
+	private:
+		std::vector<std::size_t> Order; // Old index of each new position.
+		std::vector<std::size_t> Position; // New position of each old index.
+	public:
+		// Identity of n elements.
+		explicit Permutation(std::size_t n = 0)
+			: Order(n), Position(n){
+			std::iota(Order.begin(), Order.end(), std::size_t{ 0 });
+			std::iota(Position.begin(), Position.end(), std::size_t{ 0 });
+		};
+
+		// From the old index of each new position.
+		explicit Permutation(std::vector<std::size_t> order)
+			: Order(std::move(order)), Position(Order.size()){
+			for (std::size_t k = 0; k < Order.size(); ++k){
+				assert(Order[k] < Order.size());
+				Position[Order[k]] = k;
+			};
+		};
+
+		std::size_t size() const {
+			return Order.size();
+		};
+
+		// Old index at new position k.
+		std::size_t operator[](std::size_t k) const {
+			return Order[k];
+		};
+
+		// New position of old index i.
+		std::size_t position(std::size_t i) const {
+			return Position[i];
+		};
+
+		std::vector<std::size_t> const& order() const {
+			return Order;
+		};
+
+		Permutation inverse() const {
+			return Permutation(Position);
+		};
+
+		// y = P x, y[k] = x[Order[k]], for n x 1 vectors. y is resized only if needed and must not be x.
+		template<typename T>
+		Matrix<T, 2>& apply(Matrix<T, 2> const& x, Matrix<T, 2>& y) const {
+			assert(x.size() == size() && &x != &y);
+			if (y.size() != size()){
+				y.rep().resize({ size(), 1 });
+			};
+			// Through the elements of y, detached once, so that the workers don't check for copy-on-write.
+			T const* in{ x.rep().data() };
+			T* out{ y.rep().data() };
+			ThreadPool::Global().ParallelFor(0, size(), ParallelElementThreshold / 4, [this, in, out](std::size_t first, std::size_t last){
+				for (std::size_t k = first; k < last; ++k){
+					out[k] = in[Order[k]];
+				};
+			});
+			return y;
+		};
+
+		// x = transpose(P) y, undoing apply, e.g. to bring a solution back to the original numbering.
+		template<typename T>
+		Matrix<T, 2>& applyInverse(Matrix<T, 2> const& y, Matrix<T, 2>& x) const {
+			assert(y.size() == size() && &x != &y);
+			if (x.size() != size()){
+				x.rep().resize({ size(), 1 });
+			};
+			T const* in{ y.rep().data() };
+			T* out{ x.rep().data() };
+			ThreadPool::Global().ParallelFor(0, size(), ParallelElementThreshold / 4, [this, in, out](std::size_t first, std::size_t last){
+				for (std::size_t k = first; k < last; ++k){
+					out[Order[k]] = in[k];
+				};
+			});
+			return x;
+		};
+
+		// B = P A transpose(P) for a square sparse matrix. Rows are built in parallel.
+		template<typename T>
+		SparseMatrixContainer<T> apply(SparseMatrixContainer<T> const& A) const {
+			assert(A.rows() == size() && A.columns() == size());
+			std::vector<std::size_t> const& rp{ A.RowPointers() };
+			std::vector<std::size_t> const& ci{ A.ColumnIndices() };
+			std::vector<T> const& v{ A.Values() };
+			std::size_t const n{ size() };
+			std::vector<std::size_t> pointers(n + 1, 0);
+			for (std::size_t k = 0; k < n; ++k){
+				pointers[k + 1] = pointers[k] + (rp[Order[k] + 1] - rp[Order[k]]);
+			};
+			std::vector<std::size_t> indices(pointers[n]);
+			std::vector<T> values(pointers[n]);
+			ThreadPool::Global().ParallelFor(0, n, 1024, [&](std::size_t first, std::size_t last){
+				std::vector<std::pair<std::size_t, T> > row;
+				for (std::size_t k = first; k < last; ++k){
+					std::size_t const i{ Order[k] };
+					row.clear();
+					for (std::size_t p = rp[i]; p < rp[i + 1]; ++p){
+						row.emplace_back(Position[ci[p]], v[p]);
+					};
+					std::sort(row.begin(), row.end(), [](std::pair<std::size_t, T> const& a, std::pair<std::size_t, T> const& b){
+						return a.first < b.first;
+					});
+					for (std::size_t q = 0; q < row.size(); ++q){
+						indices[pointers[k] + q] = row[q].first;
+						values[pointers[k] + q] = row[q].second;
+					};
+				};
+			});
+			return SparseMatrixContainer<T>(n, n, std::move(pointers), std::move(indices), std::move(values));
+		};
+	};// END Permutation class
+
+	// Graph of the symmetrized pattern without the diagonal, in CSR form (neighbours of vertex i in
+	// Adjacency[Pointers[i]] ... Adjacency[Pointers[i + 1] - 1]).
+	struct SparseGraph{
+		std::vector<std::size_t> Pointers;
+		std::vector<std::size_t> Adjacency;
+
+		std::size_t size() const {
+			return Pointers.size() - 1;
+		};
+		std::size_t degree(std::size_t i) const {
+			return Pointers[i + 1] - Pointers[i];
+		};
+	};
+
+	template<typename T>
+	SparseGraph GraphOf(SparseMatrixContainer<T> const& A){
+		assert(A.rows() == A.columns());
+		std::size_t const n{ A.rows() };
+		std::vector<std::size_t> tPointers, tIndices;
+		std::vector<T> tValues;
+		TransposeCompressed(n, n, A.RowPointers(), A.ColumnIndices(), A.Values(), tPointers, tIndices, tValues);
+		std::vector<std::size_t> const& rp{ A.RowPointers() };
+		std::vector<std::size_t> const& ci{ A.ColumnIndices() };
+		SparseGraph graph;
+		graph.Pointers.assign(n + 1, 0);
+		graph.Adjacency.reserve(2 * ci.size());
+		// Merge of the (sorted) rows of A and of its transpose.
+		for (std::size_t i = 0; i < n; ++i){
+			std::size_t p{ rp[i] };
+			std::size_t q{ tPointers[i] };
+			while (p < rp[i + 1] || q < tPointers[i + 1]){
+				std::size_t j;
+				if (q == tPointers[i + 1] || (p < rp[i + 1] && ci[p] < tIndices[q])){
+					j = ci[p++];
+				}
+				else if (p == rp[i + 1] || tIndices[q] < ci[p]){
+					j = tIndices[q++];
+				}
+				else{
+					j = ci[p++];
+					++q;
+				};
+				if (j != i){
+					graph.Adjacency.push_back(j);
+				};
+			};
+			graph.Pointers[i + 1] = graph.Adjacency.size();
+		};
+		return graph;
+	};
+
+	// Breadth-first level structure of the vertices reachable from root among those with allowed[v] set.
+	// Returns the vertices by levels; levelStart[l] is where level l begins. level[v] is written for the vertices visited.
+	inline std::vector<std::size_t> LevelStructure(SparseGraph const& graph, std::size_t root, std::vector<char> const& allowed,
+		std::vector<std::size_t>& level, std::vector<std::size_t>& levelStart){
+		std::size_t const unvisited{ std::numeric_limits<std::size_t>::max() };
+		std::vector<std::size_t> vertices{ root };
+		level[root] = 0;
+		for (std::size_t head = 0; head < vertices.size(); ++head){
+			std::size_t const v{ vertices[head] };
+			for (std::size_t p = graph.Pointers[v]; p < graph.Pointers[v + 1]; ++p){
+				std::size_t const w{ graph.Adjacency[p] };
+				if (allowed[w] && level[w] == unvisited){
+					level[w] = level[v] + 1;
+					vertices.push_back(w);
+				};
+			};
+		};
+		// Level starts, from the levels of the vertices in visiting order.
+		levelStart.assign(1, 0);
+		for (std::size_t k = 1; k < vertices.size(); ++k){
+			if (level[vertices[k]] != level[vertices[k - 1]]){
+				levelStart.push_back(k);
+			};
+		};
+		levelStart.push_back(vertices.size());
+		return vertices;
+	};
+
+	// Pseudo-peripheral vertex of the component of start (George and Liu): a vertex whose level structure
+	// is about as deep as possible, found by restarting from a vertex of minimum degree in the last level.
+	inline std::size_t PseudoPeripheralVertex(SparseGraph const& graph, std::size_t start, std::vector<char> const& allowed){
+		std::size_t const unvisited{ std::numeric_limits<std::size_t>::max() };
+		std::vector<std::size_t> level(graph.size(), unvisited);
+		std::vector<std::size_t> levelStart;
+		std::size_t root{ start };
+		std::size_t depth{ 0 };
+		for (;;){
+			std::vector<std::size_t> vertices{ LevelStructure(graph, root, allowed, level, levelStart) };
+			std::size_t const newDepth{ levelStart.size() - 1 };
+			std::size_t candidate{ vertices[levelStart[newDepth - 1]] };
+			for (std::size_t k = levelStart[newDepth - 1]; k < vertices.size(); ++k){
+				if (graph.degree(vertices[k]) < graph.degree(candidate)){
+					candidate = vertices[k];
+				};
+			};
+			for (auto v : vertices){
+				level[v] = unvisited;
+			};
+			if (newDepth <= depth){
+				return root;
+			};
+			depth = newDepth;
+			root = candidate;
+		};
+	};
+
+	// Reverse Cuthill-McKee ordering (George and Liu).
+	// Each connected component is numbered breadth-first from a pseudo-peripheral vertex, visiting neighbours
+	// by increasing degree, and the whole order is reversed. Reduces bandwidth and profile.
+	template<typename T>
+	Permutation ReverseCuthillMcKee(SparseMatrixContainer<T> const& A){
+		SparseGraph const graph{ GraphOf(A) };
+		std::size_t const n{ graph.size() };
+		std::vector<char> allowed(n, 1);
+		std::vector<char> numbered(n, 0);
+		std::vector<std::size_t> order;
+		order.reserve(n);
+		// Components are started from their vertex of lowest degree.
+		std::vector<std::size_t> byDegree(n);
+		std::iota(byDegree.begin(), byDegree.end(), std::size_t{ 0 });
+		std::stable_sort(byDegree.begin(), byDegree.end(), [&graph](std::size_t a, std::size_t b){
+			return graph.degree(a) < graph.degree(b);
+		});
+		std::vector<std::size_t> neighbours;
+		for (auto start : byDegree){
+			if (numbered[start]){
+				continue;
+			};
+			std::size_t const root{ PseudoPeripheralVertex(graph, start, allowed) };
+			std::size_t head{ order.size() };
+			order.push_back(root);
+			numbered[root] = 1;
+			for (; head < order.size(); ++head){
+				std::size_t const v{ order[head] };
+				neighbours.clear();
+				for (std::size_t p = graph.Pointers[v]; p < graph.Pointers[v + 1]; ++p){
+					if (!numbered[graph.Adjacency[p]]){
+						neighbours.push_back(graph.Adjacency[p]);
+						numbered[graph.Adjacency[p]] = 1;
+					};
+				};
+				std::stable_sort(neighbours.begin(), neighbours.end(), [&graph](std::size_t a, std::size_t b){
+					return graph.degree(a) < graph.degree(b);
+				});
+				order.insert(order.end(), neighbours.begin(), neighbours.end());
+			};
+		};
+		std::reverse(order.begin(), order.end());
+		return Permutation(std::move(order));
+	};
+
+	// Nested dissection ordering, with level-structure separators.
+	// Each part of the graph is split by the middle level of a breadth-first level structure from a
+	// pseudo-peripheral vertex; the two halves are ordered recursively and the separator goes last.
+	// Parts of at most leafSize vertices are ordered by reversed breadth-first search, like Cuthill-McKee.
+	// Elimination in this order keeps the fill of sparse factorizations low for mesh-like graphs,
+	// and the halves are independent, which is what parallel factorizations exploit.
+	template<typename T>
+	Permutation NestedDissection(SparseMatrixContainer<T> const& A, std::size_t leafSize = 64){
+		SparseGraph const graph{ GraphOf(A) };
+		std::size_t const n{ graph.size() };
+		std::size_t const unvisited{ std::numeric_limits<std::size_t>::max() };
+		std::vector<std::size_t> order(n);
+		std::vector<char> allowed(n, 0);
+		std::vector<std::size_t> level(n, unvisited);
+		std::vector<std::size_t> levelStart;
+		// Parts still to order, as lists of vertices, with the last position of the order they fill.
+		struct Part{
+			std::vector<std::size_t> Vertices;
+			std::size_t End;
+		};
+		std::vector<Part> stack;
+		{
+			std::vector<std::size_t> all(n);
+			std::iota(all.begin(), all.end(), std::size_t{ 0 });
+			stack.push_back(Part{ std::move(all), n });
+		};
+		while (!stack.empty()){
+			Part part{ std::move(stack.back()) };
+			stack.pop_back();
+			std::vector<std::size_t>& vertices{ part.Vertices };
+			if (vertices.empty()){
+				continue;
+			};
+			for (auto v : vertices){
+				allowed[v] = 1;
+			};
+			// One connected component of the part.
+			std::size_t const root{ PseudoPeripheralVertex(graph, vertices[0], allowed) };
+			std::vector<std::size_t> component{ LevelStructure(graph, root, allowed, level, levelStart) };
+			std::size_t const depth{ levelStart.size() - 1 };
+			for (auto v : component){
+				level[v] = unvisited;
+			};
+			if (component.size() < vertices.size()){
+				// Several components: the component and the rest are ordered independently.
+				for (auto v : component){
+					allowed[v] = 2;
+				};
+				std::vector<std::size_t> rest;
+				for (auto v : vertices){
+					if (allowed[v] == 1){
+						rest.push_back(v);
+					};
+					allowed[v] = 0;
+				};
+				std::size_t const restEnd{ part.End - component.size() };
+				stack.push_back(Part{ std::move(rest), restEnd });
+				stack.push_back(Part{ std::move(component), part.End });
+				continue;
+			};
+			if (vertices.size() <= leafSize || depth < 3){
+				// Small part: reversed breadth-first order from the pseudo-peripheral vertex.
+				std::size_t position{ part.End };
+				for (auto v : component){
+					order[--position] = v;
+					allowed[v] = 0;
+				};
+				continue;
+			};
+			// Separator: the middle level. The levels before and after are disconnected by it.
+			std::size_t const middle{ depth / 2 };
+			std::vector<std::size_t> first(component.begin(), component.begin() + levelStart[middle]);
+			std::vector<std::size_t> separator(component.begin() + levelStart[middle], component.begin() + levelStart[middle + 1]);
+			std::vector<std::size_t> second(component.begin() + levelStart[middle + 1], component.end());
+			for (auto v : vertices){
+				allowed[v] = 0;
+			};
+			std::size_t position{ part.End };
+			for (auto v : separator){
+				order[--position] = v;
+			};
+			std::size_t const secondEnd{ position };
+			std::size_t const firstEnd{ position - second.size() };
+			stack.push_back(Part{ std::move(first), firstEnd });
+			stack.push_back(Part{ std::move(second), secondEnd });
+		};
+		return Permutation(std::move(order));
+	};
+
+	// Bandwidth and profile of a square sparse matrix.
+	// Bandwidth: largest |i - j| over the non-zeros. Profile (envelope size): sum over the rows of the distance
+	// from the first non-zero to the diagonal, the storage of a skyline factorization.
+	struct SparseProfile{
+		std::size_t Bandwidth;
+		std::size_t Profile;
+	};
+
+	template<typename T>
+	SparseProfile ProfileOf(SparseMatrixContainer<T> const& A){
+		SparseProfile result{ 0, 0 };
+		std::vector<std::size_t> const& rp{ A.RowPointers() };
+		std::vector<std::size_t> const& ci{ A.ColumnIndices() };
+		for (std::size_t i = 0; i < A.rows(); ++i){
+			if (rp[i] == rp[i + 1]){
+				continue;
+			};
+			std::size_t const low{ ci[rp[i]] };
+			std::size_t const high{ ci[rp[i + 1] - 1] };
+			std::size_t const width{ std::max(i > low ? i - low : 0, high > i ? high - i : 0) };
+			result.Bandwidth = std::max(result.Bandwidth, width);
+			result.Profile += i > low ? i - low : 0;
+		};
+		return result;
+	};
+
+	// Profile before and after a reordering, to decide whether it pays.
+	struct ReorderingReport{
+		SparseProfile Before;
+		SparseProfile After;
+	};
+
+	template<typename T>
+	ReorderingReport CompareOrdering(SparseMatrixContainer<T> const& A, Permutation const& P){
+		return ReorderingReport{ ProfileOf(A), ProfileOf(P.apply(A)) };
+	};
+
+	inline std::ostream& operator<<(std::ostream& os, ReorderingReport const& report){
+		os << "bandwidth " << report.Before.Bandwidth << " -> " << report.After.Bandwidth
+			<< ", profile " << report.Before.Profile << " -> " << report.After.Profile << std::endl;
+		return os;
+	};
+	//
+}// END namespace FususMatrix
+
+#endif
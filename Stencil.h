@@ -0,0 +1,527 @@
+#ifndef _FususStencil_
+#define _FususStencil_
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include "BufferPool.h"
+#include "Matrix.h"
+#include "ThreadPool.h"
+
+namespace FususMatrix{
+
+	// Stencils over N-D dense matrices: out(x) = sum of w_k in(x + o_k), or out(x) = f(neighbourhood of x).
+	// The matrix is cut into tiles. Each tile is copied with a halo of the stencil radius into a contiguous scratch
+	// buffer, where the boundary policy fills the points outside the matrix, so that the inner loops see neither
+	// strides nor boundaries: a neighbour is a fixed offset from the point, and the innermost dimension is a
+	// contiguous row the compiler vectorizes. The tiles are split between the workers of the pool.
+	// Tiles whose halo lies inside the matrix are read in place. Several time steps can be taken on each tile
+	// before writing it back (temporal blocking), with a halo of radius x steps, instead of a sweep over the whole
+	// matrix per step; it pays off when the sweeps are bound by memory bandwidth rather than by the arithmetic.
+
+	// What the points outside the matrix read as.
+	// Zero: zero. Clamp: the nearest point of the matrix. Periodic: the matrix repeated along each dimension.
+	enum class Boundary { Zero, Clamp, Periodic };
+
+	// Elements of the core of a tile, and longest row of a tile along the last dimension.
+	// The two buffers of a tile and its halo then stay within L2.
+	const std::size_t StencilTileElements{ 1 << 16 };
+	const std::ptrdiff_t StencilRowLength{ 1024 };
+
+	// Coordinate of [0, n) that the coordinate g reads, or -1 for a zero.
+	inline std::ptrdiff_t BoundaryCoordinate(Boundary policy, std::ptrdiff_t g, std::ptrdiff_t n){
+		if (g >= 0 && g < n){
+			return g;
+		};
+		switch (policy){
+		case Boundary::Clamp:
+			return g < 0 ? 0 : n - 1;
+		case Boundary::Periodic:
+			return ((g % n) + n) % n;
+		default:
+			return -1;
+		};
+	};
+
+	// Calls f(c) for the first coordinate c of every row (along the last dimension) of the box [low, high).
+	template<std::size_t D, typename Function>
+	void ForEachStencilRow(std::array<std::ptrdiff_t, D> const& low, std::array<std::ptrdiff_t, D> const& high, Function f){
+		for (std::size_t d = 0; d < D; ++d){
+			if (low[d] >= high[d]){
+				return;
+			};
+		};
+		std::array<std::ptrdiff_t, D> c(low);
+		for (;;){
+			f(c);
+			std::size_t d{ D - 1 };
+			for (;;){
+				if (d == 0){
+					return;
+				};
+				--d;
+				if (++c[d] < high[d]){
+					break;
+				};
+				c[d] = low[d];
+			};
+		};
+	};
+
+	// The neighbours of a point inside a tile buffer, for stencils given by a functor.
+	// p(o_0, ..., o_{D-1}) is the element at offset o from the point.
+	template<typename T, std::size_t D>
+	class StencilPoint{
+	private:
+		T const* Center;
+		std::array<std::ptrdiff_t, D> const& Strides;
+	public:
+		StencilPoint(T const* center, std::array<std::ptrdiff_t, D> const& strides)
+			: Center(center), Strides(strides){
+		};
+
+		template<typename... Offsets>
+		T operator()(Offsets... offsets) const {
+			static_assert(sizeof...(Offsets) == D, "One offset per dimension");
+			std::array<std::ptrdiff_t, D> o{ { static_cast<std::ptrdiff_t>(offsets)... } };
+			std::ptrdiff_t position{ 0 };
+			for (std::size_t d = 0; d < D; ++d){
+				position += o[d] * Strides[d];
+			};
+			return Center[position];
+		};
+	};
+
+	// w[0] s[0][x] + ... + w[Points - 1] s[Points - 1][x], unrolled.
+	template<typename T, std::size_t Points>
+	struct StencilSum{
+		static T Of(T const* w, T const* const* s, std::size_t x){
+			return StencilSum<T, Points - 1>::Of(w, s, x) + w[Points - 1] * s[Points - 1][x];
+		};
+	};
+	template<typename T>
+	struct StencilSum<T, 1>{
+		static T Of(T const* w, T const* const* s, std::size_t x){
+			return w[0] * s[0][x];
+		};
+	};
+
+	// Rows of weighted sums, with the offsets of the points in the buffer of a tile.
+	template<typename T>
+	struct WeightedStencilRows{
+		std::vector<std::ptrdiff_t> Offsets;
+		std::vector<T> const& Weights;
+
+		// dst[x] (+)= sum of w[p] s[p][x], p < Points, the sum in a register.
+		template<std::size_t Points, bool First>
+		static void Pass(T const* w, T const* const* s, T* dst, std::size_t count){
+			for (std::size_t x = 0; x < count; ++x){
+				T const sum{ StencilSum<T, Points>::Of(w, s, x) };
+				dst[x] = First ? sum : dst[x] + sum;
+			};
+		};
+		template<bool First>
+		static void Pass(std::size_t points, T const* w, T const* const* s, T* dst, std::size_t count){
+			switch (points){
+			case 1: Pass<1, First>(w, s, dst, count); break;
+			case 2: Pass<2, First>(w, s, dst, count); break;
+			case 3: Pass<3, First>(w, s, dst, count); break;
+			case 4: Pass<4, First>(w, s, dst, count); break;
+			case 5: Pass<5, First>(w, s, dst, count); break;
+			case 6: Pass<6, First>(w, s, dst, count); break;
+			case 7: Pass<7, First>(w, s, dst, count); break;
+			default: Pass<8, First>(w, s, dst, count); break;
+			};
+		};
+
+		// dst[x] = sum of w_k src[x + o_k], x < count, up to eight points per pass over the row.
+		// The sums of a pass stay in registers, however many points the stencil has.
+		void operator()(T const* src, T* dst, std::size_t count) const {
+			std::size_t const points{ Offsets.size() };
+			if (points == 0){
+				std::fill(dst, dst + count, T{ 0 });
+				return;
+			};
+			for (std::size_t k = 0; k < points; k += 8){
+				std::size_t const m{ std::min<std::size_t>(8, points - k) };
+				T const* s[8];
+				for (std::size_t p = 0; p < m; ++p){
+					s[p] = src + Offsets[k + p];
+				};
+				if (k == 0){
+					Pass<true>(m, Weights.data() + k, s, dst, count);
+				}
+				else{
+					Pass<false>(m, Weights.data() + k, s, dst, count);
+				};
+			};
+		};
+	};
+
+	// Rows of a stencil functor.
+	template<typename T, std::size_t D, typename Function>
+	struct FunctionStencilRows{
+		std::array<std::ptrdiff_t, D> Strides;
+		Function const& F;
+
+		void operator()(T const* src, T* dst, std::size_t count) const {
+			for (std::size_t x = 0; x < count; ++x){
+				dst[x] = F(StencilPoint<T, D>(src + x, Strides));
+			};
+		};
+	};
+
+	// Applies steps steps of a stencil with the given radius per dimension to in, writing out (not in).
+	// rowsOf(strides of a tile buffer) gives the kernel computing rows of a step in that buffer.
+	template<typename T, std::size_t D, typename RowsOf>
+	void StencilSweep(DenseMatrixContainer<T, D> const& in, DenseMatrixContainer<T, D>& out,
+		std::array<std::size_t, D> const& radius, Boundary policy, std::size_t steps, RowsOf const& rowsOf){
+		assert(in.getSizesAlongEachDimension() == out.getSizesAlongEachDimension() && in.data() != out.data());
+		std::array<std::ptrdiff_t, D> n, inStrides, outStrides, halo, tile;
+		for (std::size_t d = 0; d < D; ++d){
+			n[d] = static_cast<std::ptrdiff_t>(in.SizeAlongDimension(d));
+			inStrides[d] = static_cast<std::ptrdiff_t>(in.getStrides()[d]);
+			outStrides[d] = static_cast<std::ptrdiff_t>(out.getStrides()[d]);
+			halo[d] = static_cast<std::ptrdiff_t>(radius[d] * steps);
+			if (n[d] == 0){
+				return;
+			};
+		};
+		// Rows along the last dimension of up to StencilRowLength elements, split evenly,
+		// the rest of the tile as square as the budget allows.
+		std::ptrdiff_t const rowTiles{ (n[D - 1] + StencilRowLength - 1) / StencilRowLength };
+		tile[D - 1] = (n[D - 1] + rowTiles - 1) / rowTiles;
+		if (D > 1){
+			double const side{ std::pow(double(StencilTileElements) / double(tile[D - 1]), 1.0 / double(D - 1)) };
+			for (std::size_t d = 0; d + 1 < D; ++d){
+				tile[d] = std::min<std::ptrdiff_t>(n[d], std::max<std::ptrdiff_t>(4, static_cast<std::ptrdiff_t>(side)));
+			};
+		};
+		// Boundaries of the tiles along each dimension. For a single step, slabs as thick as the halo at both ends,
+		// so that the other tiles have their halo inside the matrix and are read in place.
+		std::array<std::vector<std::ptrdiff_t>, D> cuts;
+		std::size_t total{ 1 };
+		std::size_t bufferSize{ 1 };
+		for (std::size_t d = 0; d < D; ++d){
+			bool const slabs{ steps == 1 && halo[d] > 0 && n[d] > 2 * halo[d] };
+			std::ptrdiff_t const begin{ slabs ? halo[d] : 0 };
+			std::ptrdiff_t const end{ slabs ? n[d] - halo[d] : n[d] };
+			std::ptrdiff_t const count{ (end - begin + tile[d] - 1) / tile[d] };
+			cuts[d].push_back(0);
+			for (std::ptrdiff_t k = 0; k < count; ++k){
+				cuts[d].push_back(begin + (k + 1) * (end - begin) / count);
+			};
+			if (slabs){
+				cuts[d].insert(cuts[d].begin() + 1, begin);
+				cuts[d].push_back(n[d]);
+			};
+			total *= cuts[d].size() - 1;
+			bufferSize *= static_cast<std::size_t>(std::max(tile[d], halo[d]) + 2 * halo[d]);
+		};
+		T const* source{ in.data() };
+		T* target{ out.data() };
+		bool const contiguousIn{ inStrides[D - 1] == 1 };
+		bool const contiguousOut{ outStrides[D - 1] == 1 };
+
+		auto tilesBody = [&](std::size_t first, std::size_t last){
+			auto scratch = BufferPool<T>::Global().Acquire(2 * bufferSize + static_cast<std::size_t>(tile[D - 1]));
+			T* line{ scratch.data() + 2 * bufferSize };
+			// Kernel reading the matrix in place, for the tiles whose halo lies inside it.
+			auto direct = rowsOf(inStrides);
+
+			// Writes the row of the tile starting at the point g of the matrix, computed by kernel from src.
+			auto store = [&](std::array<std::ptrdiff_t, D> const& g, T const* src, std::size_t length, decltype(direct) const& kernel){
+				T* destination{ target };
+				for (std::size_t d = 0; d < D; ++d){
+					destination += g[d] * outStrides[d];
+				};
+				if (contiguousOut){
+					kernel(src, destination, length);
+					return;
+				};
+				kernel(src, line, length);
+				for (std::size_t x = 0; x < length; ++x){
+					destination[static_cast<std::ptrdiff_t>(x) * outStrides[D - 1]] = line[x];
+				};
+			};
+
+			for (std::size_t t = first; t < last; ++t){
+				// Tile [low, high) of the matrix, its buffer holding [origin, origin + extent).
+				std::array<std::ptrdiff_t, D> low, high, origin, extent, strides;
+				std::size_t index{ t };
+				bool inside{ steps == 1 && contiguousIn };
+				for (std::size_t d = D; d-- > 0;){
+					std::size_t const k{ index % (cuts[d].size() - 1) };
+					index /= cuts[d].size() - 1;
+					low[d] = cuts[d][k];
+					high[d] = cuts[d][k + 1];
+					origin[d] = low[d] - halo[d];
+					extent[d] = high[d] - low[d] + 2 * halo[d];
+					inside = inside && origin[d] >= 0 && origin[d] + extent[d] <= n[d];
+				};
+				if (inside){
+					ForEachStencilRow(low, high, [&](std::array<std::ptrdiff_t, D> const& g){
+						T const* src{ source };
+						for (std::size_t d = 0; d < D; ++d){
+							src += g[d] * inStrides[d];
+						};
+						store(g, src, static_cast<std::size_t>(high[D - 1] - low[D - 1]), direct);
+					});
+					continue;
+				};
+				strides[D - 1] = 1;
+				for (std::size_t d = D - 1; d > 0; --d){
+					strides[d - 1] = strides[d] * extent[d];
+				};
+				T* a{ scratch.data() };
+				T* b{ scratch.data() + bufferSize };
+				std::array<std::ptrdiff_t, D> zero{}, mapped;
+
+				// Maps the coordinates c of the buffer to those of the matrix. False if the point reads a zero.
+				auto map = [&](std::array<std::ptrdiff_t, D> const& c, std::size_t dimensions){
+					for (std::size_t d = 0; d < dimensions; ++d){
+						mapped[d] = BoundaryCoordinate(policy, origin[d] + c[d], n[d]);
+						if (mapped[d] < 0){
+							return false;
+						};
+					};
+					return true;
+				};
+
+				// The tile with its halo, from the matrix.
+				ForEachStencilRow(zero, extent, [&](std::array<std::ptrdiff_t, D> const& c){
+					T* row{ a };
+					for (std::size_t d = 0; d + 1 < D; ++d){
+						row += c[d] * strides[d];
+					};
+					std::ptrdiff_t const length{ extent[D - 1] };
+					if (!map(c, D - 1)){
+						std::fill(row, row + length, T{ 0 });
+						return;
+					};
+					T const* base{ source };
+					for (std::size_t d = 0; d + 1 < D; ++d){
+						base += mapped[d] * inStrides[d];
+					};
+					std::ptrdiff_t const g0{ origin[D - 1] };
+					std::ptrdiff_t const insideBegin{ std::max<std::ptrdiff_t>(0, -g0) };
+					std::ptrdiff_t const insideEnd{ std::min(length, n[D - 1] - g0) };
+					for (std::ptrdiff_t x = 0; x < length; ++x){
+						if (x == insideBegin && insideBegin < insideEnd){
+							if (contiguousIn){
+								std::copy(base + g0 + x, base + g0 + insideEnd, row + x);
+								x = insideEnd;
+							};
+							for (; x < insideEnd; ++x){
+								row[x] = base[(g0 + x) * inStrides[D - 1]];
+							};
+							if (x == length){
+								break;
+							};
+						};
+						std::ptrdiff_t const g{ BoundaryCoordinate(policy, g0 + x, n[D - 1]) };
+						row[x] = g < 0 ? T{ 0 } : base[g * inStrides[D - 1]];
+					};
+				});
+
+				auto rows = rowsOf(strides);
+				for (std::size_t step = 1; step < steps; ++step){
+					// Points of the matrix computed at this step: the buffer less step x radius on each side.
+					std::array<std::ptrdiff_t, D> from, to;
+					for (std::size_t d = 0; d < D; ++d){
+						std::ptrdiff_t const shrink{ static_cast<std::ptrdiff_t>(step * radius[d]) };
+						from[d] = std::max(shrink, -origin[d]);
+						to[d] = std::min(extent[d] - shrink, n[d] - origin[d]);
+					};
+					ForEachStencilRow(from, to, [&](std::array<std::ptrdiff_t, D> const& c){
+						std::ptrdiff_t position{ 0 };
+						for (std::size_t d = 0; d < D; ++d){
+							position += c[d] * strides[d];
+						};
+						rows(a + position, b + position, static_cast<std::size_t>(to[D - 1] - from[D - 1]));
+					});
+					// Points outside the matrix at this step, read from the points just computed.
+					for (std::size_t d = 0; d < D; ++d){
+						std::ptrdiff_t const shrink{ static_cast<std::ptrdiff_t>(step * radius[d]) };
+						from[d] = shrink;
+						to[d] = extent[d] - shrink;
+					};
+					ForEachStencilRow(from, to, [&](std::array<std::ptrdiff_t, D> c){
+						bool outside{ false };
+						for (std::size_t d = 0; d + 1 < D; ++d){
+							outside = outside || origin[d] + c[d] < 0 || origin[d] + c[d] >= n[d];
+						};
+						std::ptrdiff_t const g0{ origin[D - 1] };
+						for (std::ptrdiff_t x = from[D - 1]; x < to[D - 1]; ++x){
+							if (!outside && g0 + x >= 0 && g0 + x < n[D - 1]){
+								continue;
+							};
+							c[D - 1] = x;
+							std::ptrdiff_t position{ 0 };
+							for (std::size_t d = 0; d < D; ++d){
+								position += c[d] * strides[d];
+							};
+							if (!map(c, D)){
+								b[position] = T{ 0 };
+								continue;
+							};
+							std::ptrdiff_t read{ 0 };
+							for (std::size_t d = 0; d < D; ++d){
+								read += (mapped[d] - origin[d]) * strides[d];
+							};
+							b[position] = b[read];
+						};
+					});
+					std::swap(a, b);
+				};
+
+				// The last step, on the core of the tile, straight to the matrix.
+				ForEachStencilRow(low, high, [&](std::array<std::ptrdiff_t, D> const& g){
+					std::ptrdiff_t position{ 0 };
+					for (std::size_t d = 0; d < D; ++d){
+						position += (g[d] - origin[d]) * strides[d];
+					};
+					store(g, a + position, static_cast<std::size_t>(high[D - 1] - low[D - 1]), rows);
+				});
+			};
+		};
+
+		ThreadPool& pool{ ThreadPool::Global() };
+		if (in.size() * steps >= ParallelElementThreshold && pool.size() > 1){
+			pool.ParallelFor(0, total, 1, tilesBody);
+		}
+		else{
+			tilesBody(0, total);
+		};
+	};
+
+	// steps steps of a stencil, taken stepsPerSweep at a time on each tile (temporal blocking).
+	// Periodic boundaries read points of other tiles, so they take one step per sweep.
+	template<typename T, std::size_t D, typename RowsOf>
+	void StencilSteps(Matrix<T, D> const& in, Matrix<T, D>& out, std::array<std::size_t, D> const& radius,
+		Boundary policy, std::size_t steps, std::size_t stepsPerSweep, RowsOf const& rowsOf){
+		if (out.getSizesAlongEachDimension() != in.getSizesAlongEachDimension()){
+			out.rep().resize(in.getSizesAlongEachDimension());
+		};
+		if (steps == 0){
+			out.rep() = in.rep();
+			return;
+		};
+		if (policy == Boundary::Periodic || stepsPerSweep == 0){
+			stepsPerSweep = 1;
+		};
+		std::size_t const sweeps{ (steps + stepsPerSweep - 1) / stepsPerSweep };
+		if (sweeps == 1){
+			StencilSweep(in.rep(), out.rep(), radius, policy, steps, rowsOf);
+			return;
+		};
+		// Alternating between out and a temporary, so that the last sweep lands in out.
+		DenseMatrixContainer<T, D> other(in.rep());
+		DenseMatrixContainer<T, D>* from{ sweeps % 2 == 0 ? &out.rep() : &other };
+		DenseMatrixContainer<T, D>* to{ sweeps % 2 == 0 ? &other : &out.rep() };
+		StencilSweep(in.rep(), *to, radius, policy, std::min(steps, stepsPerSweep), rowsOf);
+		for (std::size_t done = stepsPerSweep; done < steps; done += stepsPerSweep){
+			std::swap(from, to);
+			StencilSweep(*from, *to, radius, policy, std::min(steps - done, stepsPerSweep), rowsOf);
+		};
+	};
+
+	//
+	//                      The Stencil Class.
+	// A linear stencil: points given by their offsets along each dimension, with their weights.
+	// E.g. the 7-point Laplacian in 3-D:
+	//   Stencil<double, 3> L({ { { 0, 0, 0 }, -6.0 }, { { 1, 0, 0 }, 1.0 }, { { -1, 0, 0 }, 1.0 }, ... });
+	//   L.apply(K, K2);
+	template<typename T = double, std::size_t Dimension = 2>
+	class Stencil{
+	public:
+		typedef std::array<std::ptrdiff_t, Dimension> Offset;
+	private:
+		std::vector<Offset> Offsets;
+		std::vector<T> Weights;
+		Boundary Policy;
+		std::array<std::size_t, Dimension> Radius;
+	public:
+		explicit Stencil(Boundary policy = Boundary::Zero)
+			: Policy(policy), Radius(){
+		};
+
+		Stencil(std::initializer_list<std::pair<Offset, T> > points, Boundary policy = Boundary::Zero)
+			: Stencil(policy){
+			for (auto const& point : points){
+				add(point.first, point.second);
+			};
+		};
+
+		// Adds a point. Points with the same offset add up.
+		Stencil& add(Offset const& offset, T weight){
+			for (std::size_t d = 0; d < Dimension; ++d){
+				Radius[d] = std::max(Radius[d], static_cast<std::size_t>(offset[d] < 0 ? -offset[d] : offset[d]));
+			};
+			for (std::size_t k = 0; k < Offsets.size(); ++k){
+				if (Offsets[k] == offset){
+					Weights[k] += weight;
+					return *this;
+				};
+			};
+			Offsets.push_back(offset);
+			Weights.push_back(weight);
+			return *this;
+		};
+
+		std::size_t size() const {
+			return Offsets.size();
+		};
+		Boundary boundary() const {
+			return Policy;
+		};
+		std::array<std::size_t, Dimension> const& radius() const {
+			return Radius;
+		};
+
+		// out = steps applications of the stencil to in, stepsPerSweep of them on each tile before writing it back.
+		// out is resized only if needed and must not be in.
+		Matrix<T, Dimension>& apply(Matrix<T, Dimension> const& in, Matrix<T, Dimension>& out,
+			std::size_t steps = 1, std::size_t stepsPerSweep = 1) const {
+			auto rowsOf = [this](std::array<std::ptrdiff_t, Dimension> const& strides){
+				WeightedStencilRows<T> rows{ std::vector<std::ptrdiff_t>(Offsets.size()), Weights };
+				for (std::size_t k = 0; k < Offsets.size(); ++k){
+					for (std::size_t d = 0; d < Dimension; ++d){
+						rows.Offsets[k] += Offsets[k][d] * strides[d];
+					};
+				};
+				return rows;
+			};
+			StencilSteps(in, out, Radius, Policy, steps, stepsPerSweep, rowsOf);
+			return out;
+		};
+		Matrix<T, Dimension> apply(Matrix<T, Dimension> const& in, std::size_t steps = 1, std::size_t stepsPerSweep = 1) const {
+			Matrix<T, Dimension> out(in.rep());
+			apply(in, out, steps, stepsPerSweep);
+			return out;
+		};
+	};// END Stencil class
+
+	// out = steps applications of the stencil f(p), p the StencilPoint of each point reaching at most radius[d]
+	// along dimension d, stepsPerSweep of them on each tile. E.g. in 2-D, with radius { 1, 1 }:
+	//   ApplyStencil(in, out, { 1, 1 }, Boundary::Clamp, [](StencilPoint<double, 2> const& p){ return std::max(p(0, 1), p(1, 0)); });
+	template<typename T, std::size_t Dimension, typename Function>
+	Matrix<T, Dimension>& ApplyStencil(Matrix<T, Dimension> const& in, Matrix<T, Dimension>& out,
+		std::array<std::size_t, Dimension> const& radius, Boundary policy, Function const& f,
+		std::size_t steps = 1, std::size_t stepsPerSweep = 1){
+		auto rowsOf = [&f](std::array<std::ptrdiff_t, Dimension> const& strides){
+			return FunctionStencilRows<T, Dimension, Function>{ strides, f };
+		};
+		StencilSteps(in, out, radius, policy, steps, stepsPerSweep, rowsOf);
+		return out;
+	};
+	//
+}// END namespace FususMatrix
+
+#endif
@@ -0,0 +1,295 @@
+#ifndef _FususStructuredMatrix_
+#define _FususStructuredMatrix_
+
+#include <cassert>
+#include <vector>
+
+#include "BufferPool.h"
+#include "Matrix.h"
+#include "StructuredMatrixContainers.h"
+#include "ThreadPool.h"
+
+namespace FususMatrix{
+
+	// Square matrices whose structure is known from their type, so that span() goes straight to the right solver
+	// instead of scanning the n x n elements for it, and the products touch only the stored elements.
+	// They can be operands of any expression (reading zeros outside the structure); assigning to them
+	// replaces the container.
+
+	// Applies kernel(column of b, column of x) to each column of the dense n x k b, the result going to the same
+	// column of x, which is resized only if needed. A single column is used in place, others through a scratch buffer.
+	template<typename T, typename Kernel>
+	void ForEachColumn(Matrix<T, 2> const& b, Matrix<T, 2>& x, Kernel kernel){
+		std::size_t const n{ b.rows() };
+		std::size_t const k{ b.columns() };
+		if (x.rows() != n || x.columns() != k){
+			x.rep().resize({ n, k });
+		};
+		if (k == 1){
+			kernel(b.rep().data(), x.rep().data());
+			return;
+		};
+		// x is detached once, before the workers write its columns through a plain pointer.
+		T* elements{ x.rep().data() };
+		std::size_t const rowStride{ x.rep().getStrides()[0] };
+		std::size_t const columnStride{ x.rep().getStrides()[1] };
+		auto columns = [&b, &kernel, elements, rowStride, columnStride, n](std::size_t first, std::size_t last){
+			auto scratch = BufferPool<T>::Global().Acquire(2 * n);
+			T* in{ scratch.data() };
+			T* out{ scratch.data() + n };
+			for (std::size_t j = first; j < last; ++j){
+				for (std::size_t i = 0; i < n; ++i){
+					in[i] = b.rep().at(i, j);
+				};
+				kernel(in, out);
+				T* column{ elements + j * columnStride };
+				for (std::size_t i = 0; i < n; ++i){
+					column[i * rowStride] = out[i];
+				};
+			};
+		};
+		ThreadPool& pool{ ThreadPool::Global() };
+		if (n * k >= ParallelElementThreshold && pool.size() > 1){
+			pool.ParallelFor(0, k, 1, columns);
+		}
+		else{
+			columns(0, k);
+		};
+	};
+
+	//
+	//                      The TriangularMatrix Class.
+	template<typename T = double>
+	class TriangularMatrix : public Matrix<T, 2, PackedTriangularContainer<T> >{
+	public:
+		typedef PackedTriangularContainer<T> Rep;
+
+		// Zero n x n triangular matrix.
+		TriangularMatrix(std::size_t n, Triangle part) : Matrix<T, 2, Rep>(Rep(n, part)){
+		};
+
+		// The triangle of a dense square matrix.
+		TriangularMatrix(Matrix<T, 2> const& a, Triangle part) : Matrix<T, 2, Rep>(Rep(a.rep(), part)){
+		};
+
+		TriangularMatrix(TriangularMatrix const& other) = default;
+		TriangularMatrix(TriangularMatrix&& other) = default;
+
+		// Assignments replace the container.
+		TriangularMatrix& operator=(TriangularMatrix const& other){
+			this->rep() = other.rep();
+			return *this;
+		};
+		TriangularMatrix& operator=(TriangularMatrix&& other){
+			this->rep() = std::move(other.rep());
+			return *this;
+		};
+
+		// Known from the storage, O(1).
+		bool IsLowerTriangular() const {
+			return this->rep().part() == Triangle::Lower;
+		};
+		bool IsUpperTriangular() const {
+			return this->rep().part() == Triangle::Upper;
+		};
+
+		// Product with a dense Matrix written into y (TRMV for each column).
+		Matrix<T, 2>& Multiply(Matrix<T, 2> const& x, Matrix<T, 2>& y) const {
+			assert(this->columns() == x.rows());
+			Rep const& a{ this->rep() };
+			ForEachColumn(x, y, [&a](T const* in, T* out){ a.Multiply(in, out); });
+			return y;
+		};
+		Matrix<T, 2> Multiply(Matrix<T, 2> const& x) const {
+			Matrix<T, 2> y(this->rows(), x.columns());
+			return Multiply(x, y);
+		};
+
+		// Solution of 'this' * x = b by substitution, O(n^2 / 2) per column of b.
+		Matrix<T, 2>& span(Matrix<T, 2> const& b, Matrix<T, 2>& x) const {
+			assert(this->rows() == b.rows());
+			Rep const& a{ this->rep() };
+			ForEachColumn(b, x, [&a](T const* in, T* out){
+				std::copy(in, in + a.rows(), out);
+				a.Solve(out);
+			});
+			return x;
+		};
+		Matrix<T, 2> span(Matrix<T, 2> const& b) const {
+			Matrix<T, 2> x(b.rows(), b.columns());
+			return span(b, x);
+		};
+	};// END TriangularMatrix class
+
+	//
+	//                      The SymmetricMatrix Class.
+	template<typename T = double>
+	class SymmetricMatrix : public Matrix<T, 2, PackedSymmetricContainer<T> >{
+	public:
+		typedef PackedSymmetricContainer<T> Rep;
+
+		// Zero n x n symmetric matrix.
+		explicit SymmetricMatrix(std::size_t n) : Matrix<T, 2, Rep>(Rep(n)){
+		};
+
+		// The lower triangle of a dense symmetric matrix.
+		explicit SymmetricMatrix(Matrix<T, 2> const& a) : Matrix<T, 2, Rep>(Rep(a.rep())){
+		};
+
+		SymmetricMatrix(SymmetricMatrix const& other) = default;
+		SymmetricMatrix(SymmetricMatrix&& other) = default;
+
+		SymmetricMatrix& operator=(SymmetricMatrix const& other){
+			this->rep() = other.rep();
+			return *this;
+		};
+		SymmetricMatrix& operator=(SymmetricMatrix&& other){
+			this->rep() = std::move(other.rep());
+			return *this;
+		};
+
+		// Product with a dense Matrix written into y: SYMV for a vector, SYMM (columns in parallel) otherwise.
+		Matrix<T, 2>& Multiply(Matrix<T, 2> const& x, Matrix<T, 2>& y) const {
+			assert(this->columns() == x.rows());
+			Rep const& a{ this->rep() };
+			ForEachColumn(x, y, [&a](T const* in, T* out){ a.Multiply(in, out); });
+			return y;
+		};
+		Matrix<T, 2> Multiply(Matrix<T, 2> const& x) const {
+			Matrix<T, 2> y(this->rows(), x.columns());
+			return Multiply(x, y);
+		};
+
+		// Cholesky factor of 'this', packed, for solving repeatedly with the same matrix.
+		// Returns false if 'this' isn't positive definite.
+		bool Cholesky(Rep& factor) const {
+			factor = this->rep();
+			return factor.Cholesky();
+		};
+
+		// Bunch-Kaufman factorization of 'this', packed, for solving repeatedly with an indefinite matrix.
+		// Returns false if 'this' is singular.
+		bool LDLT(Rep& factor, std::vector<std::size_t>& pivots) const {
+			factor = this->rep();
+			return factor.LDLT(pivots);
+		};
+
+		// Solution of 'this' * x = b, O(n^3 / 6 + n^2 k). By Cholesky factorization, or if 'this' isn't positive
+		// definite, by Bunch-Kaufman factorization.
+		Matrix<T, 2>& span(Matrix<T, 2> const& b, Matrix<T, 2>& x) const {
+			assert(this->rows() == b.rows());
+			Rep factor(this->rep());
+			if (factor.Cholesky()){
+				ForEachColumn(b, x, [&factor](T const* in, T* out){
+					std::copy(in, in + factor.rows(), out);
+					factor.SolveCholesky(out);
+				});
+				return x;
+			};
+			factor = this->rep();
+			std::vector<std::size_t> pivots;
+			bool const regular{ factor.LDLT(pivots) };
+			assert(regular);
+			(void)regular;
+			ForEachColumn(b, x, [&factor, &pivots](T const* in, T* out){
+				std::copy(in, in + factor.rows(), out);
+				factor.SolveLDLT(pivots, out);
+			});
+			return x;
+		};
+		Matrix<T, 2> span(Matrix<T, 2> const& b) const {
+			Matrix<T, 2> x(b.rows(), b.columns());
+			return span(b, x);
+		};
+	};// END SymmetricMatrix class
+
+	//
+	//                      The BandedMatrix Class.
+	template<typename T = double>
+	class BandedMatrix : public Matrix<T, 2, BandedContainer<T> >{
+	public:
+		typedef BandedContainer<T> Rep;
+
+		// Zero n x n matrix with subDiagonals below and superDiagonals above the diagonal.
+		BandedMatrix(std::size_t n, std::size_t subDiagonals, std::size_t superDiagonals)
+			: Matrix<T, 2, Rep>(Rep(n, subDiagonals, superDiagonals)){
+		};
+
+		// The band of a dense square matrix.
+		BandedMatrix(Matrix<T, 2> const& a, std::size_t subDiagonals, std::size_t superDiagonals)
+			: Matrix<T, 2, Rep>(Rep(a.rep(), subDiagonals, superDiagonals)){
+		};
+
+		BandedMatrix(BandedMatrix const& other) = default;
+		BandedMatrix(BandedMatrix&& other) = default;
+
+		BandedMatrix& operator=(BandedMatrix const& other){
+			this->rep() = other.rep();
+			return *this;
+		};
+		BandedMatrix& operator=(BandedMatrix&& other){
+			this->rep() = std::move(other.rep());
+			return *this;
+		};
+
+		std::size_t SubDiagonals() const {
+			return this->rep().SubDiagonals();
+		};
+		std::size_t SuperDiagonals() const {
+			return this->rep().SuperDiagonals();
+		};
+		bool IsLowerTriangular() const {
+			return SuperDiagonals() == 0;
+		};
+		bool IsUpperTriangular() const {
+			return SubDiagonals() == 0;
+		};
+
+		// Product with a dense Matrix written into y (GBMV for each column), O(n (kl + ku)) per column.
+		Matrix<T, 2>& Multiply(Matrix<T, 2> const& x, Matrix<T, 2>& y) const {
+			assert(this->columns() == x.rows());
+			Rep const& a{ this->rep() };
+			ForEachColumn(x, y, [&a](T const* in, T* out){ a.Multiply(in, out); });
+			return y;
+		};
+		Matrix<T, 2> Multiply(Matrix<T, 2> const& x) const {
+			Matrix<T, 2> y(this->rows(), x.columns());
+			return Multiply(x, y);
+		};
+
+		// LU factorization with partial pivoting, for solving repeatedly with the same matrix.
+		// Returns false if 'this' is singular.
+		bool LU(Rep& factor, std::vector<std::size_t>& pivots) const {
+			factor = this->rep();
+			return factor.LU(pivots);
+		};
+
+		// Cholesky factorization of a symmetric positive definite band. Returns false if it isn't positive definite.
+		bool Cholesky(Rep& factor) const {
+			factor = this->rep();
+			return factor.Cholesky();
+		};
+
+		// Solution of 'this' * x = b by banded LU, O(n kl (kl + ku)) plus O(n (2 kl + ku)) per column of b.
+		Matrix<T, 2>& span(Matrix<T, 2> const& b, Matrix<T, 2>& x) const {
+			assert(this->rows() == b.rows());
+			Rep factor(this->rep());
+			std::vector<std::size_t> pivots;
+			bool const regular{ factor.LU(pivots) };
+			assert(regular);
+			(void)regular;
+			ForEachColumn(b, x, [&factor, &pivots](T const* in, T* out){
+				std::copy(in, in + factor.rows(), out);
+				factor.SolveLU(pivots, out);
+			});
+			return x;
+		};
+		Matrix<T, 2> span(Matrix<T, 2> const& b) const {
+			Matrix<T, 2> x(b.rows(), b.columns());
+			return span(b, x);
+		};
+	};// END BandedMatrix class
+	//
+}// END namespace FususMatrix
+
+#endif
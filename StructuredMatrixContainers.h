@@ -0,0 +1,661 @@
+#ifndef _FususStructuredMatrixContainers_
+#define _FususStructuredMatrixContainers_
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "DenseMatrixContainer.h"
+#include "Layout.h"
+#include "MatrixVectorProducts.h"
+
+namespace FususMatrix{
+
+	// Containers for square matrices with known structure, storing only the elements that can be non-zero,
+	// in the layouts of LAPACK, with the kernels that use the structure:
+	//   PackedTriangularContainer: n(n+1)/2 elements, TRMV and triangular solve.
+	//   PackedSymmetricContainer:  n(n+1)/2 elements (lower triangle), SYMV / SYMM, Cholesky and Bunch-Kaufman LDL^T.
+	//   BandedContainer:           n(2kl+ku+1) elements, GBMV, LU with partial pivoting and, if symmetric, Cholesky.
+	// Elements outside the structure read as zero and can't be written.
+	// The kernels work on columns, which are contiguous in these layouts.
+
+	// Position of (i, j) in the column-major packed storage of a triangle of an n x n matrix (i >= j for Lower, i <= j for Upper).
+	inline std::size_t PackedPosition(Triangle part, std::size_t n, std::size_t i, std::size_t j){
+		return part == Triangle::Lower ? i + j * (2 * n - j - 1) / 2 : i + j * (j + 1) / 2;
+	};
+
+	//
+	//                      The PackedTriangularContainer Class.
+	template<typename T = double>
+	class PackedTriangularContainer{
+	private:
+		Triangle Part;
+		std::size_t N;
+		std::vector<std::size_t> Sizes; // { N, N }
+		std::vector<T> Data;
+
+		bool Stored(std::size_t i, std::size_t j) const {
+			return Part == Triangle::Lower ? i >= j : i <= j;
+		};
+	public:
+		// Zero n x n triangular matrix.
+		PackedTriangularContainer(std::size_t n, Triangle part)
+			: Part(part), N(n), Sizes{ n, n }, Data(n * (n + 1) / 2, T{ 0 }){
+		};
+
+		// The triangle of a dense square matrix.
+		PackedTriangularContainer(DenseMatrixContainer<T, 2> const& a, Triangle part)
+			: PackedTriangularContainer(a.rows(), part){
+			assert(a.rows() == a.columns());
+			for (std::size_t j = 0; j < N; ++j){
+				std::size_t const first{ Part == Triangle::Lower ? j : 0 };
+				std::size_t const last{ Part == Triangle::Lower ? N : j + 1 };
+				for (std::size_t i = first; i < last; ++i){
+					Data[PackedPosition(Part, N, i, j)] = a.at(i, j);
+				};
+			};
+		};
+
+		Triangle part() const {
+			return Part;
+		};
+		std::size_t rows() const {
+			return N;
+		};
+		std::size_t columns() const {
+			return N;
+		};
+		std::size_t dimension() const {
+			return 2;
+		};
+		// Number of elements of the matrix, stored or not.
+		std::size_t size() const {
+			return N * N;
+		};
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			return Sizes;
+		};
+		std::vector<T> const& Values() const {
+			return Data;
+		};
+
+		Layout layout() const {
+			return Layout::Strided;
+		};
+		T at(std::size_t i, std::size_t j) const {
+			return Stored(i, j) ? Data[PackedPosition(Part, N, i, j)] : T{ 0 };
+		};
+		// Element in the logical row-major order.
+		T operator[](std::size_t index) const {
+			return at(index / N, index % N);
+		};
+		T const& operator()(std::size_t i, std::size_t j) const {
+			static const T Zero{ 0 };
+			return Stored(i, j) ? Data[PackedPosition(Part, N, i, j)] : Zero;
+		};
+		// Only the elements of the triangle can be written.
+		T& operator()(std::size_t i, std::size_t j){
+			assert(Stored(i, j));
+			return Data[PackedPosition(Part, N, i, j)];
+		};
+
+		// y = A x (TRMV). y must not be x.
+		void Multiply(T const* x, T* y) const {
+			std::fill(y, y + N, T{ 0 });
+			for (std::size_t j = 0; j < N; ++j){
+				T const xj{ x[j] };
+				std::size_t const first{ Part == Triangle::Lower ? j : 0 };
+				std::size_t const last{ Part == Triangle::Lower ? N : j + 1 };
+				T const* column{ Data.data() + PackedPosition(Part, N, first, j) - first };
+				for (std::size_t i = first; i < last; ++i){
+					y[i] += column[i] * xj;
+				};
+			};
+		};
+
+		// Solution of A x = b by substitution, in place in x which holds b on entry. O(n^2 / 2).
+		void Solve(T* x) const {
+			if (Part == Triangle::Lower){
+				for (std::size_t j = 0; j < N; ++j){
+					T const* column{ Data.data() + PackedPosition(Part, N, j, j) - j };
+					x[j] /= column[j];
+					T const xj{ x[j] };
+					for (std::size_t i = j + 1; i < N; ++i){
+						x[i] -= column[i] * xj;
+					};
+				};
+			}
+			else{
+				for (std::size_t j = N; j-- > 0;){
+					T const* column{ Data.data() + PackedPosition(Part, N, 0, j) };
+					x[j] /= column[j];
+					T const xj{ x[j] };
+					for (std::size_t i = 0; i < j; ++i){
+						x[i] -= column[i] * xj;
+					};
+				};
+			};
+		};
+	};// END PackedTriangularContainer class
+
+	//
+	//                      The PackedSymmetricContainer Class.
+	// Stores the lower triangle; (i, j) and (j, i) are the same element.
+	template<typename T = double>
+	class PackedSymmetricContainer{
+	private:
+		std::size_t N;
+		std::vector<std::size_t> Sizes; // { N, N }
+		std::vector<T> Data;
+
+		std::size_t Position(std::size_t i, std::size_t j) const {
+			return i >= j ? PackedPosition(Triangle::Lower, N, i, j) : PackedPosition(Triangle::Lower, N, j, i);
+		};
+	public:
+		explicit PackedSymmetricContainer(std::size_t n)
+			: N(n), Sizes{ n, n }, Data(n * (n + 1) / 2, T{ 0 }){
+		};
+
+		// The lower triangle of a dense square matrix, assumed symmetric.
+		explicit PackedSymmetricContainer(DenseMatrixContainer<T, 2> const& a)
+			: PackedSymmetricContainer(a.rows()){
+			assert(a.rows() == a.columns());
+			for (std::size_t j = 0; j < N; ++j){
+				for (std::size_t i = j; i < N; ++i){
+					Data[Position(i, j)] = a.at(i, j);
+				};
+			};
+		};
+
+		std::size_t rows() const {
+			return N;
+		};
+		std::size_t columns() const {
+			return N;
+		};
+		std::size_t dimension() const {
+			return 2;
+		};
+		std::size_t size() const {
+			return N * N;
+		};
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			return Sizes;
+		};
+		std::vector<T> const& Values() const {
+			return Data;
+		};
+
+		Layout layout() const {
+			return Layout::Strided;
+		};
+		T at(std::size_t i, std::size_t j) const {
+			return Data[Position(i, j)];
+		};
+		T operator[](std::size_t index) const {
+			return at(index / N, index % N);
+		};
+		T const& operator()(std::size_t i, std::size_t j) const {
+			return Data[Position(i, j)];
+		};
+		// Writing (i, j) also writes (j, i).
+		T& operator()(std::size_t i, std::size_t j){
+			return Data[Position(i, j)];
+		};
+
+		// y = A x (SYMV), reading each stored element once. y must not be x.
+		void Multiply(T const* x, T* y) const {
+			std::fill(y, y + N, T{ 0 });
+			for (std::size_t j = 0; j < N; ++j){
+				T const* column{ Data.data() + PackedPosition(Triangle::Lower, N, j, j) - j };
+				T const xj{ x[j] };
+				T sum{ column[j] * xj };
+				for (std::size_t i = j + 1; i < N; ++i){
+					y[i] += column[i] * xj;
+					sum += column[i] * x[i];
+				};
+				y[j] += sum;
+			};
+		};
+
+		// Cholesky factorization A = L transpose(L), L written over the stored triangle (packed, like LAPACK's pptrf).
+		// Returns false if A isn't positive definite, leaving the container partly factorized.
+		bool Cholesky(){
+			for (std::size_t j = 0; j < N; ++j){
+				T* column{ Data.data() + PackedPosition(Triangle::Lower, N, j, j) - j };
+				if (!(column[j] > T{ 0 })){
+					return false;
+				};
+				column[j] = std::sqrt(column[j]);
+				for (std::size_t i = j + 1; i < N; ++i){
+					column[i] /= column[j];
+				};
+				// Update of the trailing triangle with the new column.
+				for (std::size_t k = j + 1; k < N; ++k){
+					T* target{ Data.data() + PackedPosition(Triangle::Lower, N, k, k) - k };
+					T const ljk{ column[k] };
+					for (std::size_t i = k; i < N; ++i){
+						target[i] -= column[i] * ljk;
+					};
+				};
+			};
+			return true;
+		};
+
+		// Solution of L transpose(L) x = b in place, for a container holding a Cholesky factor.
+		void SolveCholesky(T* x) const {
+			for (std::size_t j = 0; j < N; ++j){
+				T const* column{ Data.data() + PackedPosition(Triangle::Lower, N, j, j) - j };
+				x[j] /= column[j];
+				for (std::size_t i = j + 1; i < N; ++i){
+					x[i] -= column[i] * x[j];
+				};
+			};
+			for (std::size_t j = N; j-- > 0;){
+				T const* column{ Data.data() + PackedPosition(Triangle::Lower, N, j, j) - j };
+				T sum{ x[j] };
+				for (std::size_t i = j + 1; i < N; ++i){
+					sum -= column[i] * x[i];
+				};
+				x[j] = sum / column[j];
+			};
+		};
+
+		// Factorization P A transpose(P) = L D transpose(L) with Bunch-Kaufman pivoting, in place (LAPACK's sptrf),
+		// for indefinite matrices, O(n^3 / 6). D has 1 x 1 and 2 x 2 diagonal blocks. pivots[k] = p for a 1 x 1 block
+		// at k, rows and columns k and p exchanged; pivots[k] = pivots[k + 1] = N + p for a 2 x 2 block at k, k + 1,
+		// with k + 1 and p exchanged. Returns false if A is singular, leaving the container partly factorized.
+		bool LDLT(std::vector<std::size_t>& pivots){
+			T const alpha{ (T{ 1 } + std::sqrt(T{ 17 })) / T{ 8 } };
+			pivots.assign(N, 0);
+			auto column = [this](std::size_t j){ // column(j)[i] is A(i, j), i >= j.
+				return Data.data() + PackedPosition(Triangle::Lower, N, j, j) - j;
+			};
+			std::size_t k{ 0 };
+			while (k < N){
+				T* ck{ column(k) };
+				T const absakk{ std::abs(ck[k]) };
+				std::size_t imax{ k };
+				T colmax{ 0 };
+				for (std::size_t i = k + 1; i < N; ++i){
+					if (std::abs(ck[i]) > colmax){
+						colmax = std::abs(ck[i]);
+						imax = i;
+					};
+				};
+				if (!(std::max(absakk, colmax) > T{ 0 })){
+					return false;
+				};
+				std::size_t kp{ k };
+				std::size_t kstep{ 1 };
+				if (absakk < alpha * colmax){
+					// Largest off-diagonal element of row and column imax.
+					T rowmax{ 0 };
+					for (std::size_t j = k; j < imax; ++j){
+						rowmax = std::max(rowmax, std::abs(column(j)[imax]));
+					};
+					T const* cimax{ column(imax) };
+					for (std::size_t i = imax + 1; i < N; ++i){
+						rowmax = std::max(rowmax, std::abs(cimax[i]));
+					};
+					if (absakk >= alpha * colmax * (colmax / rowmax)){
+						kp = k;
+					}
+					else if (std::abs(cimax[imax]) >= alpha * rowmax){
+						kp = imax;
+					}
+					else{
+						kp = imax;
+						kstep = 2;
+					};
+				};
+				// Exchange of rows and columns kk and kp of the trailing submatrix.
+				std::size_t const kk{ k + kstep - 1 };
+				if (kp != kk){
+					T* ckk{ column(kk) };
+					T* ckp{ column(kp) };
+					for (std::size_t i = kp + 1; i < N; ++i){
+						std::swap(ckk[i], ckp[i]);
+					};
+					for (std::size_t j = kk + 1; j < kp; ++j){
+						std::swap(ckk[j], column(j)[kp]);
+					};
+					std::swap(ckk[kk], ckp[kp]);
+					if (kstep == 2){
+						std::swap(ck[k + 1], ck[kp]);
+					};
+				};
+				if (kstep == 1){
+					// A(k + 1 : N, k + 1 : N) -= A(k + 1 : N, k) A(k + 1 : N, k)^T / A(k, k), then L(k + 1 : N, k).
+					T const d11{ T{ 1 } / ck[k] };
+					for (std::size_t j = k + 1; j < N; ++j){
+						T* target{ column(j) };
+						T const ajk{ d11 * ck[j] };
+						for (std::size_t i = j; i < N; ++i){
+							target[i] -= ck[i] * ajk;
+						};
+					};
+					for (std::size_t i = k + 1; i < N; ++i){
+						ck[i] *= d11;
+					};
+					pivots[k] = kp;
+				}
+				else{
+					// The same with the 2 x 2 block D(k : k + 1, k : k + 1), through its inverse.
+					T* ck1{ column(k + 1) };
+					if (k + 2 < N){
+						T d21{ ck[k + 1] };
+						T const d11{ ck1[k + 1] / d21 };
+						T const d22{ ck[k] / d21 };
+						T const t{ T{ 1 } / (d11 * d22 - T{ 1 }) };
+						d21 = t / d21;
+						for (std::size_t j = k + 2; j < N; ++j){
+							T const wk{ d21 * (d11 * ck[j] - ck1[j]) };
+							T const wk1{ d21 * (d22 * ck1[j] - ck[j]) };
+							T* target{ column(j) };
+							for (std::size_t i = j; i < N; ++i){
+								target[i] -= ck[i] * wk + ck1[i] * wk1;
+							};
+							ck[j] = wk;
+							ck1[j] = wk1;
+						};
+					};
+					pivots[k] = N + kp;
+					pivots[k + 1] = N + kp;
+				};
+				k += kstep;
+			};
+			return true;
+		};
+
+		// Solution of A x = b in place in x, for a container holding the LDLT factorization (LAPACK's sptrs).
+		void SolveLDLT(std::vector<std::size_t> const& pivots, T* x) const {
+			auto column = [this](std::size_t j){
+				return Data.data() + PackedPosition(Triangle::Lower, N, j, j) - j;
+			};
+			// L D y = P b.
+			std::size_t k{ 0 };
+			while (k < N){
+				T const* ck{ column(k) };
+				if (pivots[k] < N){
+					if (pivots[k] != k){
+						std::swap(x[k], x[pivots[k]]);
+					};
+					for (std::size_t i = k + 1; i < N; ++i){
+						x[i] -= ck[i] * x[k];
+					};
+					x[k] /= ck[k];
+					++k;
+				}
+				else{
+					std::size_t const kp{ pivots[k] - N };
+					if (kp != k + 1){
+						std::swap(x[k + 1], x[kp]);
+					};
+					T const* ck1{ column(k + 1) };
+					for (std::size_t i = k + 2; i < N; ++i){
+						x[i] -= ck[i] * x[k] + ck1[i] * x[k + 1];
+					};
+					T const d21{ ck[k + 1] };
+					T const d11{ ck[k] / d21 };
+					T const d22{ ck1[k + 1] / d21 };
+					T const denominator{ d11 * d22 - T{ 1 } };
+					T const b1{ x[k] / d21 };
+					T const b2{ x[k + 1] / d21 };
+					x[k] = (d22 * b1 - b2) / denominator;
+					x[k + 1] = (d11 * b2 - b1) / denominator;
+					k += 2;
+				};
+			};
+			// transpose(L) P x = y.
+			k = N;
+			while (k > 0){
+				--k;
+				T const* ck{ column(k) };
+				T sum{ x[k] };
+				for (std::size_t i = k + 1; i < N; ++i){
+					sum -= ck[i] * x[i];
+				};
+				x[k] = sum;
+				if (pivots[k] < N){
+					if (pivots[k] != k){
+						std::swap(x[k], x[pivots[k]]);
+					};
+				}
+				else{
+					T const* ck0{ column(k - 1) };
+					T sum0{ x[k - 1] };
+					for (std::size_t i = k + 1; i < N; ++i){
+						sum0 -= ck0[i] * x[i];
+					};
+					x[k - 1] = sum0;
+					std::size_t const kp{ pivots[k] - N };
+					if (kp != k){
+						std::swap(x[k], x[kp]);
+					};
+					--k;
+				};
+			};
+		};
+	};// END PackedSymmetricContainer class
+
+	//
+	//                      The BandedContainer Class.
+	// An n x n matrix with kl sub-diagonals and ku super-diagonals, in the band storage of LAPACK's gbtrf:
+	// column j is stored contiguously, A(i, j) at Data[kl + ku + i - j + j * ld], ld = 2 kl + ku + 1.
+	// The first kl rows of the band are left for the fill-in of the LU factorization.
+	template<typename T = double>
+	class BandedContainer{
+	private:
+		std::size_t N;
+		std::size_t KL;
+		std::size_t KU;
+		std::size_t LD;
+		std::vector<std::size_t> Sizes; // { N, N }
+		std::vector<T> Data;
+
+		bool Stored(std::size_t i, std::size_t j) const {
+			return i <= j + KL && j <= i + KU;
+		};
+		std::size_t Position(std::size_t i, std::size_t j) const {
+			return KL + KU + i - j + j * LD;
+		};
+	public:
+		BandedContainer(std::size_t n, std::size_t kl, std::size_t ku)
+			: N(n), KL(kl), KU(ku), LD(2 * kl + ku + 1), Sizes{ n, n }, Data(n * (2 * kl + ku + 1), T{ 0 }){
+		};
+
+		// The band of a dense square matrix.
+		BandedContainer(DenseMatrixContainer<T, 2> const& a, std::size_t kl, std::size_t ku)
+			: BandedContainer(a.rows(), kl, ku){
+			assert(a.rows() == a.columns());
+			for (std::size_t j = 0; j < N; ++j){
+				for (std::size_t i = j > KU ? j - KU : 0; i < N && i <= j + KL; ++i){
+					Data[Position(i, j)] = a.at(i, j);
+				};
+			};
+		};
+
+		std::size_t rows() const {
+			return N;
+		};
+		std::size_t columns() const {
+			return N;
+		};
+		std::size_t dimension() const {
+			return 2;
+		};
+		std::size_t size() const {
+			return N * N;
+		};
+		std::vector<std::size_t> const& getSizesAlongEachDimension() const {
+			return Sizes;
+		};
+		std::size_t SubDiagonals() const {
+			return KL;
+		};
+		std::size_t SuperDiagonals() const {
+			return KU;
+		};
+
+		Layout layout() const {
+			return Layout::Strided;
+		};
+		T at(std::size_t i, std::size_t j) const {
+			return Stored(i, j) ? Data[Position(i, j)] : T{ 0 };
+		};
+		T operator[](std::size_t index) const {
+			return at(index / N, index % N);
+		};
+		T const& operator()(std::size_t i, std::size_t j) const {
+			static const T Zero{ 0 };
+			return Stored(i, j) ? Data[Position(i, j)] : Zero;
+		};
+		// Only the elements of the band can be written.
+		T& operator()(std::size_t i, std::size_t j){
+			assert(Stored(i, j));
+			return Data[Position(i, j)];
+		};
+
+		// y = A x (GBMV), O(n (kl + ku)). y must not be x.
+		void Multiply(T const* x, T* y) const {
+			std::fill(y, y + N, T{ 0 });
+			for (std::size_t j = 0; j < N; ++j){
+				T const xj{ x[j] };
+				T const* column{ Data.data() + KL + KU + j * LD - j }; // column[i] is A(i, j).
+				std::size_t const last{ std::min(N, j + KL + 1) };
+				for (std::size_t i = j > KU ? j - KU : 0; i < last; ++i){
+					y[i] += column[i] * xj;
+				};
+			};
+		};
+
+		// LU factorization with partial pivoting, in place (LAPACK's gbtf2), O(n kl (kl + ku)).
+		// The rows exchanged at step j are j and pivots[j]. U takes kl + ku super-diagonals, the multipliers
+		// of L go below the diagonal. Returns false if A is singular.
+		bool LU(std::vector<std::size_t>& pivots){
+			pivots.resize(N);
+			std::size_t const kv{ KU + KL }; // Super-diagonals of U.
+			bool regular{ true };
+			for (std::size_t j = 0; j < N; ++j){
+				// The fill-in band of column j + kv starts at zero.
+				if (j + kv < N){
+					T* column{ Data.data() + (j + kv) * LD };
+					std::fill(column, column + KL, T{ 0 });
+				};
+				std::size_t const km{ std::min(KL, N - 1 - j) }; // Elements below the diagonal.
+				T* diagonal{ Data.data() + kv + j * LD }; // A(j, j); diagonal[r] is A(j + r, j).
+				std::size_t p{ 0 };
+				for (std::size_t r = 1; r <= km; ++r){
+					if (std::abs(diagonal[r]) > std::abs(diagonal[p])){
+						p = r;
+					};
+				};
+				pivots[j] = j + p;
+				if (diagonal[p] == T{ 0 }){
+					regular = false;
+					continue;
+				};
+				std::size_t const ju{ std::min(j + kv, N - 1) }; // Last column reached by row j of U.
+				if (p != 0){
+					// Exchange of rows j and j + p in columns j ... ju. A(i, c) is at Data[kv + i - c + c * LD].
+					for (std::size_t c = j; c <= ju; ++c){
+						std::swap(Data[kv + j - c + c * LD], Data[kv + j + p - c + c * LD]);
+					};
+				};
+				T const pivot{ diagonal[0] };
+				for (std::size_t r = 1; r <= km; ++r){
+					diagonal[r] /= pivot;
+				};
+				// Rank-one update of the trailing block.
+				for (std::size_t c = j + 1; c <= ju; ++c){
+					T* column{ Data.data() + kv + j - c + c * LD }; // column[r] is A(j + r, c).
+					T const ujc{ column[0] };
+					if (ujc != T{ 0 }){
+						for (std::size_t r = 1; r <= km; ++r){
+							column[r] -= diagonal[r] * ujc;
+						};
+					};
+				};
+			};
+			return regular;
+		};
+
+		// Solution of A x = b in place in x, for a container holding the LU factorization (LAPACK's gbtrs).
+		void SolveLU(std::vector<std::size_t> const& pivots, T* x) const {
+			std::size_t const kv{ KU + KL };
+			// L y = P b.
+			for (std::size_t j = 0; j + 1 < N; ++j){
+				std::size_t const km{ std::min(KL, N - 1 - j) };
+				if (pivots[j] != j){
+					std::swap(x[j], x[pivots[j]]);
+				};
+				T const* multipliers{ Data.data() + kv + j * LD };
+				T const xj{ x[j] };
+				for (std::size_t r = 1; r <= km; ++r){
+					x[j + r] -= multipliers[r] * xj;
+				};
+			};
+			// U x = y, column by column.
+			for (std::size_t j = N; j-- > 0;){
+				T const* column{ Data.data() + kv + j * LD - j }; // column[i] is U(i, j).
+				x[j] /= column[j];
+				T const xj{ x[j] };
+				for (std::size_t i = j > kv ? j - kv : 0; i < j; ++i){
+					x[i] -= column[i] * xj;
+				};
+			};
+		};
+
+		// Cholesky factorization A = L transpose(L) of a symmetric positive definite band (kl == ku), in place
+		// in the lower band (LAPACK's pbtrf), O(n kl^2). Returns false if A isn't positive definite.
+		bool Cholesky(){
+			assert(KL == KU);
+			for (std::size_t j = 0; j < N; ++j){
+				T* column{ Data.data() + KL + KU + j * LD }; // column[r] is A(j + r, j).
+				if (!(column[0] > T{ 0 })){
+					return false;
+				};
+				column[0] = std::sqrt(column[0]);
+				std::size_t const km{ std::min(KL, N - 1 - j) };
+				for (std::size_t r = 1; r <= km; ++r){
+					column[r] /= column[0];
+				};
+				for (std::size_t c = 1; c <= km; ++c){
+					T* target{ Data.data() + KL + KU + (j + c) * LD }; // target[r] is A(j + c + r, j + c).
+					T const lcj{ column[c] };
+					for (std::size_t r = c; r <= km; ++r){
+						target[r - c] -= column[r] * lcj;
+					};
+				};
+			};
+			return true;
+		};
+
+		// Solution of L transpose(L) x = b in place, for a container holding a band Cholesky factor.
+		void SolveCholesky(T* x) const {
+			for (std::size_t j = 0; j < N; ++j){
+				T const* column{ Data.data() + KL + KU + j * LD };
+				std::size_t const km{ std::min(KL, N - 1 - j) };
+				x[j] /= column[0];
+				for (std::size_t r = 1; r <= km; ++r){
+					x[j + r] -= column[r] * x[j];
+				};
+			};
+			for (std::size_t j = N; j-- > 0;){
+				T const* column{ Data.data() + KL + KU + j * LD };
+				std::size_t const km{ std::min(KL, N - 1 - j) };
+				T sum{ x[j] };
+				for (std::size_t r = 1; r <= km; ++r){
+					sum -= column[r] * x[j + r];
+				};
+				x[j] = sum / column[0];
+			};
+		};
+	};// END BandedContainer class
+	//
+}// END namespace FususMatrix
+
+#endif
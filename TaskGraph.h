@@ -0,0 +1,278 @@
+#ifndef _FususTaskGraph_
+#define _FususTaskGraph_
+
+#include <chrono>
+#include <exception>
+#include <future>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include "Matrix.h"
+#include "ThreadPool.h"
+
+namespace FususMatrix{
+
+	// One operation of a TaskGraph, with its dependencies and the record of its execution.
+	struct TaskNode{
+		std::size_t Id;
+		std::string Name;
+		std::function<void()> Work;
+		std::vector<std::shared_ptr<TaskNode> > Successors;
+		std::vector<std::size_t> Predecessors; // Ids, for the dump.
+		std::size_t Pending; // Predecessors not yet finished.
+		bool Finished;
+		std::exception_ptr Error; // Thrown by this task or inherited from a predecessor.
+		std::promise<void> Done;
+		std::shared_future<void> Future;
+		std::chrono::steady_clock::time_point Start;
+		std::chrono::steady_clock::time_point End;
+		std::size_t Worker;
+
+		TaskNode(std::size_t id, std::string name, std::function<void()> work)
+			: Id(id), Name(std::move(name)), Work(std::move(work)), Pending(0), Finished(false),
+			  Future(Done.get_future().share()), Worker(0){
+		};
+	};
+
+	// Handle to an operation submitted to a TaskGraph.
+	class TaskHandle{
+	private:
+		std::shared_ptr<TaskNode> Node;
+		ThreadPool* Pool; // That runs the operation.
+	public:
+		TaskHandle()
+			: Pool(nullptr){
+		};
+		TaskHandle(std::shared_ptr<TaskNode> node, ThreadPool& pool)
+			: Node(std::move(node)), Pool(&pool){
+		};
+
+		// Blocks until the operation finished. Rethrows what the operation (or one it depended on) threw.
+		// Called from a worker of the pool (e.g. inside another operation), it runs queued tasks meanwhile.
+		void wait() const {
+			if (Pool->IsWorkerThread()){
+				while (!ready()){
+					if (!Pool->RunPendingTask()){
+						std::this_thread::yield();
+					};
+				};
+			};
+			Node->Future.get();
+		};
+
+		// True once the operation finished.
+		bool ready() const {
+			return Node->Future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		};
+
+		std::shared_future<void> future() const {
+			return Node->Future;
+		};
+	};
+
+	//
+	//                      The TaskGraph Class.
+	// Runs matrix operations asynchronously on a ThreadPool.
+	// Each operation declares the objects it reads and writes, and the graph orders it after
+	// the earlier operations it conflicts with (read after write, write after read, write after write).
+	// Independent operations run concurrently. The operands must outlive the graph, or the operations using them.
+	class TaskGraph{
+	private:
+		// Operations that last wrote, and read since then, each object.
+		struct AccessRecord{
+			std::shared_ptr<TaskNode> Writer;
+			std::vector<std::shared_ptr<TaskNode> > Readers;
+		};
+
+		ThreadPool& Pool;
+		std::mutex Mutex; // Protects everything below.
+		std::condition_variable AllDone;
+		std::vector<std::shared_ptr<TaskNode> > Nodes;
+		std::map<const void*, AccessRecord> Accesses;
+		std::size_t Unfinished;
+		std::chrono::steady_clock::time_point Created;
+
+		// Adds a dependency of node on predecessor, if the latter didn't finish yet. Mutex must be held.
+		void AddDependency(std::shared_ptr<TaskNode> const& predecessor, std::shared_ptr<TaskNode> const& node){
+			if (!predecessor || predecessor == node){
+				return;
+			};
+			for (auto id : node->Predecessors){
+				if (id == predecessor->Id){
+					return;
+				};
+			};
+			node->Predecessors.push_back(predecessor->Id);
+			if (!predecessor->Finished){
+				predecessor->Successors.push_back(node);
+				++node->Pending;
+			}
+			else if (predecessor->Error && !node->Error){
+				node->Error = predecessor->Error;
+			};
+		};
+
+		// Runs a node on the calling worker, then releases its successors.
+		void Run(std::shared_ptr<TaskNode> node){
+			node->Worker = ThreadPool::CurrentWorker();
+			node->Start = std::chrono::steady_clock::now();
+			if (!node->Error){
+				try{
+					node->Work();
+				}
+				catch (...){
+					node->Error = std::current_exception();
+				};
+			};
+			node->End = std::chrono::steady_clock::now();
+			node->Work = nullptr;
+			if (node->Error){
+				node->Done.set_exception(node->Error);
+			}
+			else{
+				node->Done.set_value();
+			};
+			std::vector<std::shared_ptr<TaskNode> > ready;
+			{
+				std::lock_guard<std::mutex> lock(Mutex);
+				node->Finished = true;
+				for (auto& successor : node->Successors){
+					if (node->Error && !successor->Error){
+						successor->Error = node->Error;
+					};
+					if (--successor->Pending == 0){
+						ready.push_back(successor);
+					};
+				};
+				node->Successors.clear();
+				--Unfinished;
+				AllDone.notify_all();
+			};
+			// The graph can only be destroyed once Unfinished is zero, so it is still alive while there are successors to start.
+			for (auto& successor : ready){
+				Schedule(successor);
+			};
+		};
+
+		void Schedule(std::shared_ptr<TaskNode> node){
+			Pool.Submit([this, node]{ Run(node); });
+		};
+
+	public:
+		explicit TaskGraph(ThreadPool& pool = ThreadPool::Global())
+			: Pool(pool), Unfinished(0), Created(std::chrono::steady_clock::now()){
+		};
+
+		TaskGraph(const TaskGraph&) = delete;
+		TaskGraph& operator=(const TaskGraph&) = delete;
+
+		~TaskGraph(){
+			std::unique_lock<std::mutex> lock(Mutex);
+			AllDone.wait(lock, [this]{ return Unfinished == 0; });
+		};
+
+		// Submits an operation reading the objects in reads and writing the objects in writes.
+		// The objects are identified by address, e.g. { &A, &B } for Matrices A and B.
+		TaskHandle submit(std::string name, std::vector<const void*> const& reads, std::vector<const void*> const& writes, std::function<void()> work){
+			std::shared_ptr<TaskNode> node{ std::make_shared<TaskNode>(0, std::move(name), std::move(work)) };
+			{
+				std::lock_guard<std::mutex> lock(Mutex);
+				node->Id = Nodes.size();
+				for (auto object : reads){
+					AddDependency(Accesses[object].Writer, node);
+				};
+				for (auto object : writes){
+					AccessRecord& record{ Accesses[object] };
+					AddDependency(record.Writer, node);
+					for (auto& reader : record.Readers){
+						AddDependency(reader, node);
+					};
+				};
+				for (auto object : reads){
+					Accesses[object].Readers.push_back(node);
+				};
+				for (auto object : writes){
+					AccessRecord& record{ Accesses[object] };
+					record.Writer = node;
+					record.Readers.clear();
+				};
+				Nodes.push_back(node);
+				++Unfinished;
+				if (node->Pending != 0){
+					return TaskHandle(node, Pool);
+				};
+			};
+			Schedule(node);
+			return TaskHandle(node, Pool);
+		};
+
+		// Asynchronous C = A * B.
+		template<typename T>
+		TaskHandle Multiply(Matrix<T, 2> const& A, Matrix<T, 2> const& B, Matrix<T, 2>& C){
+			return submit("Multiply", { &A, &B }, { &C }, [&A, &B, &C]{ A.Multiply(B, C); });
+		};
+
+		// Asynchronous strong transposition of A.
+		template<typename T>
+		TaskHandle strongTranspose(Matrix<T, 2>& A){
+			return submit("strongTranspose", {}, { &A }, [&A]{ A.strongTranspose(); });
+		};
+
+		// Asynchronous X = A.span(B).
+		template<typename T>
+		TaskHandle span(Matrix<T, 2>& A, Matrix<T, 2> const& B, Matrix<T, 2>& X){
+			return submit("span", { &A, &B }, { &X }, [&A, &B, &X]{ A.span(B, X); });
+		};
+
+		// Blocks until every submitted operation finished.
+		// Called from a worker of the pool (e.g. inside another operation), it runs queued tasks meanwhile.
+		void wait(){
+			if (Pool.IsWorkerThread()){
+				for (;;){
+					{
+						std::lock_guard<std::mutex> lock(Mutex);
+						if (Unfinished == 0){
+							return;
+						};
+					};
+					if (!Pool.RunPendingTask()){
+						std::this_thread::yield();
+					};
+				};
+			};
+			std::unique_lock<std::mutex> lock(Mutex);
+			AllDone.wait(lock, [this]{ return Unfinished == 0; });
+		};
+
+		// Writes the graph in Graphviz dot format. Each finished node is labelled with
+		// its start time since the graph was created, its duration and the worker that ran it.
+		void dump(std::ostream& os){
+			std::lock_guard<std::mutex> lock(Mutex);
+			os << "digraph TaskGraph {\n";
+			for (auto& node : Nodes){
+				os << "  n" << node->Id << " [label=\"" << node->Id << ": " << node->Name;
+				if (node->Finished){
+					double start{ std::chrono::duration<double, std::milli>(node->Start - Created).count() };
+					double duration{ std::chrono::duration<double, std::milli>(node->End - node->Start).count() };
+					os << "\\nstart " << start << " ms\\ntime " << duration << " ms\\nworker " << node->Worker;
+					if (node->Error){
+						os << "\\nfailed";
+					};
+				}
+				else{
+					os << "\\npending";
+				};
+				os << "\"];\n";
+				for (auto predecessor : node->Predecessors){
+					os << "  n" << predecessor << " -> n" << node->Id << ";\n";
+				};
+			};
+			os << "}" << std::endl;
+		};
+	};// END TaskGraph class
+	//
+}// END namespace FususMatrix
+
+#endif
@@ -0,0 +1,420 @@
+#ifndef _FususThreadPool_
+#define _FususThreadPool_
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace FususMatrix{
+
+	// Below this number of elements the element-wise loops (evaluation, first touch) stay on the calling thread.
+	const std::size_t ParallelElementThreshold{ 1 << 17 };
+
+	// Counts down the parts of a parallel operation still running.
+	// The count only changes and is only read under the mutex, so a waiter that sees zero
+	// may destroy the latch right away.
+	class Latch{
+	private:
+		std::size_t Count;
+		std::mutex Mutex;
+		std::condition_variable Zero;
+		std::exception_ptr Error; // First exception thrown by a part.
+	public:
+		explicit Latch(std::size_t count)
+			: Count(count){
+		};
+
+		void CountDown(){
+			std::lock_guard<std::mutex> lock(Mutex);
+			if (--Count == 0){
+				Zero.notify_all();
+			};
+		};
+
+		bool Done(){
+			std::lock_guard<std::mutex> lock(Mutex);
+			return Count == 0;
+		};
+
+		// Blocks the calling thread, for threads that are not workers.
+		void Wait(){
+			std::unique_lock<std::mutex> lock(Mutex);
+			Zero.wait(lock, [this]{ return Count == 0; });
+		};
+
+		void SetError(std::exception_ptr error){
+			std::lock_guard<std::mutex> lock(Mutex);
+			if (!Error){
+				Error = error;
+			};
+		};
+
+		void RethrowIfError(){
+			if (Error){
+				std::rethrow_exception(Error);
+			};
+		};
+	};
+
+	//
+	//                      The ThreadPool Class.
+	// One work-stealing scheduler for the whole library, ThreadPool::Global().
+	// Each worker has its own deque of tasks: it takes the newest task of its own deque and,
+	// when that is empty, steals the oldest task of another worker. Tasks submitted by other threads
+	// go to a shared injection queue.
+	// Parallel loops never create threads. A thread waiting for the parts of a loop runs queued tasks
+	// meanwhile, so nested parallel loops (e.g. a parallel GEMM inside a parallel loop) neither deadlock
+	// nor oversubscribe the machine.
+	// Each worker also has a queue of pinned tasks that can't be stolen, used by ParallelForStatic
+	// so that block k of a buffer is always handled by worker k (NUMA first-touch placement).
+	class ThreadPool{
+	private:
+		typedef std::function<void()> Task;
+
+		struct WorkerQueue{
+			std::mutex Mutex;
+			std::deque<Task> Tasks; // Can be stolen.
+			std::deque<Task> Pinned; // Only run by the owner.
+			std::atomic<std::size_t> PinnedCount;
+			WorkerQueue() : PinnedCount(0){
+			};
+		};
+
+		// Pool and worker index of the calling thread.
+		struct WorkerIdentity{
+			ThreadPool* Pool;
+			std::size_t Index;
+		};
+
+		std::vector<std::unique_ptr<WorkerQueue> > Queues;
+		std::deque<Task> Injected; // Tasks submitted from outside the pool.
+		std::mutex InjectedMutex;
+		std::atomic<std::size_t> Queued; // Stealable and injected tasks not yet taken.
+		std::mutex SleepMutex;
+		std::condition_variable Wake;
+		std::atomic<bool> Stopping;
+		std::vector<std::thread> Workers;
+
+		static WorkerIdentity& Identity(){
+			static thread_local WorkerIdentity identity{ nullptr, std::numeric_limits<std::size_t>::max() };
+			return identity;
+		};
+
+		// Index of the calling thread if it is a worker of this pool, max() otherwise.
+		std::size_t Self() const {
+			return Identity().Pool == this ? Identity().Index : std::numeric_limits<std::size_t>::max();
+		};
+
+		void NotifyWorkers(bool all){
+			std::lock_guard<std::mutex> lock(SleepMutex);
+			if (all){
+				Wake.notify_all();
+			}
+			else{
+				Wake.notify_one();
+			};
+		};
+
+		// Runs one task, if there is any the calling thread may take.
+		bool TryRunOne(std::size_t self){
+			Task task;
+			if (self < Queues.size()){
+				WorkerQueue& own{ *Queues[self] };
+				std::lock_guard<std::mutex> lock(own.Mutex);
+				if (!own.Pinned.empty()){
+					task = std::move(own.Pinned.front());
+					own.Pinned.pop_front();
+					--own.PinnedCount;
+				}
+				else if (!own.Tasks.empty()){
+					task = std::move(own.Tasks.back());
+					own.Tasks.pop_back();
+					--Queued;
+				};
+			};
+			if (!task){
+				std::lock_guard<std::mutex> lock(InjectedMutex);
+				if (!Injected.empty()){
+					task = std::move(Injected.front());
+					Injected.pop_front();
+					--Queued;
+				};
+			};
+			for (std::size_t k = 1; !task && k <= Queues.size(); ++k){
+				WorkerQueue& victim{ *Queues[((self < Queues.size() ? self : 0) + k) % Queues.size()] };
+				std::lock_guard<std::mutex> lock(victim.Mutex);
+				if (!victim.Tasks.empty()){
+					task = std::move(victim.Tasks.front());
+					victim.Tasks.pop_front();
+					--Queued;
+				};
+			};
+			if (!task){
+				return false;
+			};
+			task();
+			return true;
+		};
+
+		void WorkerLoop(std::size_t index){
+			Identity() = WorkerIdentity{ this, index };
+			for (;;){
+				if (TryRunOne(index)){
+					continue;
+				};
+				std::unique_lock<std::mutex> lock(SleepMutex);
+				Wake.wait(lock, [this, index]{ return Stopping.load() || Queued.load() > 0 || Queues[index]->PinnedCount.load() > 0; });
+				if (Stopping.load() && Queued.load() == 0 && Queues[index]->PinnedCount.load() == 0){
+					return;
+				};
+			};
+		};
+
+		// Queues a task, on the deque of the calling worker if there is one.
+		void Push(Task task){
+			std::size_t self{ Self() };
+			if (self < Queues.size()){
+				std::lock_guard<std::mutex> lock(Queues[self]->Mutex);
+				Queues[self]->Tasks.push_back(std::move(task));
+			}
+			else{
+				std::lock_guard<std::mutex> lock(InjectedMutex);
+				Injected.push_back(std::move(task));
+			};
+			++Queued;
+			NotifyWorkers(false);
+		};
+
+		// Waits for a latch. Workers keep running tasks meanwhile, other threads block.
+		void Wait(Latch& latch){
+			std::size_t self{ Self() };
+			if (self < Queues.size()){
+				while (!latch.Done()){
+					if (!TryRunOne(self)){
+						std::this_thread::yield();
+					};
+				};
+			}
+			else{
+				latch.Wait();
+			};
+			latch.RethrowIfError();
+		};
+
+		static void PinToCpu(std::thread& thread, int cpu){
+#if defined(__linux__)
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+			(void)thread;
+			(void)cpu;
+#endif
+		};
+
+		// Settings used when the global pool gets created.
+		struct GlobalSettings{
+			std::size_t Workers;
+			std::vector<int> Cpus;
+			bool Created;
+		};
+		static GlobalSettings& Settings(){
+			static GlobalSettings settings{ 0, std::vector<int>(), false };
+			return settings;
+		};
+
+	public:
+		// Constructor from the number of workers and, optionally, the CPUs to pin them to
+		// (worker i runs on cpus[i % cpus.size()], no pinning if empty).
+		// Zero workers means FUSUS_NUM_THREADS if set, otherwise one per hardware thread.
+		explicit ThreadPool(std::size_t workers = 0, std::vector<int> const& cpus = std::vector<int>())
+			: Queued(0), Stopping(false){
+			if (workers == 0){
+				const char* variable{ std::getenv("FUSUS_NUM_THREADS") };
+				workers = variable ? static_cast<std::size_t>(std::strtoul(variable, nullptr, 10)) : 0;
+			};
+			if (workers == 0){
+				workers = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+			};
+			for (std::size_t i = 0; i < workers; ++i){
+				Queues.emplace_back(new WorkerQueue());
+			};
+			for (std::size_t i = 0; i < workers; ++i){
+				Workers.emplace_back([this, i]{ WorkerLoop(i); });
+				if (!cpus.empty()){
+					PinToCpu(Workers.back(), cpus[i % cpus.size()]);
+				};
+			};
+		};
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// The queued tasks are finished before the workers are joined.
+		~ThreadPool(){
+			Stopping = true;
+			NotifyWorkers(true);
+			for (auto& worker : Workers){
+				worker.join();
+			};
+		};
+
+		// Number of workers.
+		std::size_t size() const {
+			return Workers.size();
+		};
+
+		// Queues a task. Tasks must not throw, wrap them if they can.
+		void Submit(std::function<void()> task){
+			Push(std::move(task));
+		};
+
+		// Runs one queued task on the calling thread, if there is one. Lets a worker that waits for something help meanwhile.
+		bool RunPendingTask(){
+			return TryRunOne(Self());
+		};
+
+		// True if the calling thread is a worker of this pool.
+		bool IsWorkerThread() const {
+			return Self() < Queues.size();
+		};
+
+		// Index of the calling worker, or std::numeric_limits<std::size_t>::max() if not called from a worker.
+		static std::size_t CurrentWorker(){
+			return Identity().Index;
+		};
+
+		// Runs body(first, last) over sub-ranges of [begin, end) of at least grain indices, in parallel.
+		// The calling thread runs one of the parts and helps with queued tasks until all finish.
+		template<typename Body>
+		void ParallelFor(std::size_t begin, std::size_t end, std::size_t grain, Body const& body){
+			std::size_t n{ end > begin ? end - begin : 0 };
+			grain = grain > 0 ? grain : 1;
+			std::size_t parts{ (n + grain - 1) / grain };
+			std::size_t maximum{ 4 * (size() + 1) };
+			parts = parts < maximum ? parts : maximum;
+			if (parts <= 1){
+				if (n > 0){
+					body(begin, end);
+				};
+				return;
+			};
+			Latch latch(parts - 1);
+			for (std::size_t k = 1; k < parts; ++k){
+				std::size_t first{ begin + k * n / parts };
+				std::size_t last{ begin + (k + 1) * n / parts };
+				Push([&body, &latch, first, last]{
+					try{
+						body(first, last);
+					}
+					catch (...){
+						latch.SetError(std::current_exception());
+					};
+					latch.CountDown();
+				});
+			};
+			try{
+				body(begin, begin + n / parts);
+			}
+			catch (...){
+				latch.SetError(std::current_exception());
+			};
+			Wait(latch);
+		};
+
+		// Runs f and g, possibly in parallel.
+		template<typename F, typename G>
+		void Invoke(F const& f, G const& g){
+			Latch latch(1);
+			Push([&g, &latch]{
+				try{
+					g();
+				}
+				catch (...){
+					latch.SetError(std::current_exception());
+				};
+				latch.CountDown();
+			});
+			try{
+				f();
+			}
+			catch (...){
+				latch.SetError(std::current_exception());
+			};
+			Wait(latch);
+		};
+
+		// Runs body(first, last) on size() equal blocks of [begin, end), block k on worker k.
+		// Calling it twice on the same range gives each worker the same block, which is what NUMA first-touch needs.
+		// Called from inside a worker it behaves like ParallelFor, not to wait for workers that are busy.
+		template<typename Body>
+		void ParallelForStatic(std::size_t begin, std::size_t end, Body const& body){
+			std::size_t n{ end > begin ? end - begin : 0 };
+			if (IsWorkerThread()){
+				ParallelFor(begin, end, n / size() + 1, body);
+				return;
+			};
+			if (n == 0){
+				return;
+			};
+			std::size_t parts{ size() };
+			Latch latch(parts);
+			for (std::size_t k = 0; k < parts; ++k){
+				std::size_t first{ begin + k * n / parts };
+				std::size_t last{ begin + (k + 1) * n / parts };
+				{
+					std::lock_guard<std::mutex> lock(Queues[k]->Mutex);
+					Queues[k]->Pinned.push_back([&body, &latch, first, last]{
+						try{
+							if (first < last){
+								body(first, last);
+							};
+						}
+						catch (...){
+							latch.SetError(std::current_exception());
+						};
+						latch.CountDown();
+					});
+					++Queues[k]->PinnedCount;
+				};
+			};
+			NotifyWorkers(true);
+			Wait(latch);
+		};
+
+		// Sets the number of workers and the CPUs of the global pool.
+		// Only has effect if called before the first use of Global().
+		static void ConfigureGlobal(std::size_t workers, std::vector<int> const& cpus = std::vector<int>()){
+			assert(!Settings().Created);
+			Settings().Workers = workers;
+			Settings().Cpus = cpus;
+		};
+
+		// The pool shared by the whole library.
+		static ThreadPool& Global(){
+			// Function-local statics are initialized once, so that Global() can be called from any thread.
+			static ThreadPool pool(Settings().Workers, Settings().Cpus);
+			static bool const created{ Settings().Created = true };
+			(void)created;
+			return pool;
+		};
+	};// END ThreadPool class
+	//
+}// END namespace FususMatrix
+
+#endif